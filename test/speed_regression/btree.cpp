@@ -33,16 +33,19 @@ using namespace tpie;
 using namespace tpie::test;
 
 void usage() {
-	std::cout << "Parameters: [repetitions] [size]" << std::endl;
+	std::cout << "Parameters: [repetitions] [size] [cache MB]" << std::endl;
 }
 
-void test(size_t times, size_t size) {
+void test(size_t times, size_t size, size_t cacheMB) {
 	// display code
 	std::vector<const char *> names;
-	names.resize(3);
+	names.resize(6);
 	names[0] = "Insertion";
 	names[1] = "Searching";
-	names[2] = "Deletion";
+	names[2] = "Batched";
+	names[3] = "Lower bound";
+	names[4] = "Upper bound";
+	names[5] = "Deletion";
 	tpie::test::stat s(names);
 
 	// test code
@@ -56,7 +59,11 @@ void test(size_t times, size_t size) {
 		btree<btree_internal_store<int> > tree(store);*/
 		temp_file tmp;
 
-		btree<int, btree_external> tree(tmp.path());
+		typedef btree<int, btree_external> tree_t;
+		memory_size_type cacheMemory = cacheMB
+			? cacheMB * 1024 * 1024
+			: tree_t::store_type::default_cache_memory();
+		tree_t tree(tmp.path(), cacheMemory);
 
 		// pre-protocol
 		std::vector<int> x(count);
@@ -80,6 +87,32 @@ void test(size_t times, size_t size) {
 		getTestRealtime(end);
 		s(testRealtimeDiff(start,end));
 
+		// sorted batch of searches, as done by find_many
+		{
+			tree_t::lookup_cursor cursor(tree);
+			getTestRealtime(start);
+			for(size_t i = 0; i < count; ++i) {
+				cursor.find((int)i);
+			}
+			getTestRealtime(end);
+			s(testRealtimeDiff(start,end));
+		}
+
+		// bounds
+		getTestRealtime(start);
+		for(size_t i = 0; i < count; ++i) {
+			tree.lower_bound((int)(i ^ 1));
+		}
+		getTestRealtime(end);
+		s(testRealtimeDiff(start,end));
+
+		getTestRealtime(start);
+		for(size_t i = 0; i < count; ++i) {
+			tree.upper_bound((int)(i ^ 1));
+		}
+		getTestRealtime(end);
+		s(testRealtimeDiff(start,end));
+
 		// deletion
 		std::random_shuffle(x.begin(), x.end());
 
@@ -95,6 +128,7 @@ void test(size_t times, size_t size) {
 int main(int argc, char **argv) {
 	size_t times = 1;
 	size_t size = 5;
+	size_t cacheMB = 0;
 
 	if(argc > 1) {
 		if (std::string(argv[1]) == "0") {
@@ -120,12 +154,17 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	if(argc > 3) {
+		std::stringstream(argv[3]) >> cacheMB;
+	}
+
 	tpie::tpie_init();
 	tpie::get_memory_manager().set_limit(1000 * 1024 * 1024);
 
 	log_info() << "Repetitions: " << times << std::endl;
 	log_info() << "Test size: " << size << " KB" << std::endl;
-	::test(times, size);
+	log_info() << "Cache size: " << cacheMB << " MB" << std::endl;
+	::test(times, size, cacheMB);
 
 	tpie::tpie_finish();
 
@@ -18,8 +18,14 @@
 // along with TPIE.  If not, see <http://www.gnu.org/licenses/>
 
 #include <iostream>
+#include <iomanip>
 #include <tpie/file_stream.h>
 #include <tpie/compressed/stream.h>
+#include <tpie/compressed/thread.h>
+#include <tpie/tempname.h>
+#include "testtime.h"
+
+using namespace tpie::test;
 
 struct file_stream {
 	typedef tpie::file_stream<size_t> Stream;
@@ -47,7 +53,8 @@ size_t f(size_t prev, size_t n) {
 }
 
 void usage() {
-	std::cout << "Parameters: <file_stream|uncompressed|compressed> <read|write> <filename> <items>" << std::endl;
+	std::cout << "Parameters: <file_stream|uncompressed|compressed> <read|write> <filename> <items>\n"
+			  << "        or: scale <streams> <items per stream> <max workers>" << std::endl;
 }
 
 template <typename Stream>
@@ -89,13 +96,68 @@ void go(std::string cls, std::string command, std::string fileName, std::string
 	else usage();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// Write and then read a number of compressed streams in an interleaved
+/// fashion, as a wide merge would, using 1, 2, 4, ... compressor workers.
+///////////////////////////////////////////////////////////////////////////////
+void scale(size_t streams, size_t items, size_t maxWorkers) {
+	const int width = 16;
+	std::cout << std::setw(width) << "Workers"
+			  << std::setw(width) << "Write (ms)"
+			  << std::setw(width) << "Read (ms)"
+			  << std::setw(width) << "MB/s" << std::endl;
+	for (size_t workers = 1; workers <= maxWorkers; workers *= 2) {
+		tpie::set_compressor_thread_count(workers);
+		test_realtime_t start;
+		test_realtime_t mid;
+		test_realtime_t end;
+		{
+			tpie::array<tpie::temp_file> files(streams);
+			tpie::array<tpie::file_stream<size_t> > s(streams);
+			for (size_t j = 0; j < streams; ++j)
+				s[j].open(files[j], tpie::access_read_write, 0,
+						  tpie::access_sequential, tpie::compression_all);
+			getTestRealtime(start);
+			size_t prev = 0;
+			for (size_t i = 0; i < items; ++i) {
+				for (size_t j = 0; j < streams; ++j) s[j].write(prev);
+				prev = f(prev, i);
+			}
+			for (size_t j = 0; j < streams; ++j) s[j].seek(0);
+			getTestRealtime(mid);
+			prev = 0;
+			for (size_t i = 0; i < items; ++i) {
+				for (size_t j = 0; j < streams; ++j) {
+					if (s[j].read() != prev) std::cerr << "bad value at " << i << std::endl;
+				}
+				prev = f(prev, i);
+			}
+			getTestRealtime(end);
+		}
+		const double ms = static_cast<double>(testRealtimeDiff(start, end));
+		const double mb = 2.0 * streams * items * sizeof(size_t) / (1024.0 * 1024.0);
+		std::cout << std::setw(width) << workers
+				  << std::setw(width) << testRealtimeDiff(start, mid)
+				  << std::setw(width) << testRealtimeDiff(mid, end)
+				  << std::setw(width) << (ms > 0 ? mb * 1000.0 / ms : 0.0) << std::endl;
+	}
+}
+
 int main(int argc, char ** argv) {
 	if (argc != 5) {
 		usage();
 		return 1;
 	}
 	tpie::tpie_init();
-	go(argv[1], argv[2], argv[3], argv[4]);
+	if (std::string(argv[1]) == "scale") {
+		size_t streams, items, maxWorkers;
+		std::stringstream(argv[2]) >> streams;
+		std::stringstream(argv[3]) >> items;
+		std::stringstream(argv[4]) >> maxWorkers;
+		scale(streams, items, maxWorkers);
+	} else {
+		go(argv[1], argv[2], argv[3], argv[4]);
+	}
 	tpie::tpie_finish();
 	return 0;
 }
@@ -64,7 +64,7 @@ struct testinfo {
 			"Writing",
 			"Compressing",
 			"Uncompressing",
-			"Snappy-blocks",
+			"Compressed-blocks",
 			"None-blocks",
 			NULL};
 		for (size_t i = 0; labels[i]; ++i) {
@@ -0,0 +1,177 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+// 
+// This file is part of TPIE.
+// 
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+// 
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+// Scaling benchmarks for the job framework. Each workload is run once
+// serially on the calling thread and once through the job pool, and the
+// speedup is reported along with the number of worker threads.
+// Usage: test_job_scaling [depth] [work per leaf]
+//
+//   tree:   binary fork-join tree; every job enqueues its two subtrees as
+//           children, like the recursion in parallel_sort.
+//   flat:   the main thread enqueues every leaf as a root job and joins
+//           them all.
+//   nested: every job enqueues its subtrees as root jobs and joins them,
+//           so the workers spend their time in job::join().
+
+#include <tpie/tpie.h>
+#include <tpie/unittest.h>
+#include <tpie/job.h>
+#include <boost/lexical_cast.hpp>
+#include <cstdint>
+#include <vector>
+using namespace tpie;
+
+static std::uint64_t leaf_work(size_t work, std::uint64_t seed) {
+	std::uint64_t x = seed;
+	for (size_t i = 0; i < work; ++i)
+		x = x * 6364136223846793005ull + 1442695040888963407ull;
+	return x;
+}
+
+static std::uint64_t serial_tree(size_t depth, size_t work, std::uint64_t seed) {
+	if (depth == 0) return leaf_work(work, seed);
+	return serial_tree(depth-1, work, 2*seed) ^ serial_tree(depth-1, work, 2*seed+1);
+}
+
+struct tree_job : public job {
+	size_t depth;
+	size_t work;
+	std::uint64_t seed;
+	std::uint64_t result;
+	tree_job * left;
+	tree_job * right;
+
+	tree_job(size_t depth, size_t work, std::uint64_t seed)
+		: depth(depth), work(work), seed(seed), result(0), left(0), right(0) {}
+
+	~tree_job() {
+		delete left;
+		delete right;
+	}
+
+	void operator()() override {
+		if (depth == 0) {
+			result = leaf_work(work, seed);
+			return;
+		}
+		left = new tree_job(depth-1, work, 2*seed);
+		right = new tree_job(depth-1, work, 2*seed+1);
+		left->enqueue(this);
+		right->enqueue(this);
+	}
+
+	std::uint64_t total() const {
+		if (depth == 0) return result;
+		return left->total() ^ right->total();
+	}
+};
+
+struct leaf_job : public job {
+	size_t work;
+	std::uint64_t seed;
+	std::uint64_t result;
+
+	leaf_job() : work(0), seed(0), result(0) {}
+
+	void operator()() override {
+		result = leaf_work(work, seed);
+	}
+};
+
+struct nested_job : public job {
+	size_t depth;
+	size_t work;
+	std::uint64_t seed;
+	std::uint64_t result;
+
+	nested_job(size_t depth, size_t work, std::uint64_t seed)
+		: depth(depth), work(work), seed(seed), result(0) {}
+
+	void operator()() override {
+		if (depth == 0) {
+			result = leaf_work(work, seed);
+			return;
+		}
+		nested_job l(depth-1, work, 2*seed);
+		nested_job r(depth-1, work, 2*seed+1);
+		l.enqueue();
+		r.enqueue();
+		l.join();
+		r.join();
+		result = l.result ^ r.result;
+	}
+};
+
+static void report(const char * name, double serial, double parallel, bool ok) {
+	std::cout << name << ": serial " << serial << " ms, jobs " << parallel
+			  << " ms, speedup " << (parallel > 0 ? serial / parallel : 0.0)
+			  << (ok ? "" : " (WRONG RESULT)") << std::endl;
+}
+
+int main(int argc, char ** argv) {
+	tpie::tpie_init();
+	size_t depth = 16;
+	size_t work = 2000;
+	if (argc > 1) depth = boost::lexical_cast<size_t>(argv[1]);
+	if (argc > 2) work = boost::lexical_cast<size_t>(argv[2]);
+	std::cout << default_worker_count() << " workers, " << (size_t(1) << depth)
+			  << " leaves of " << work << " steps" << std::endl;
+
+	test_time start = test_now();
+	const std::uint64_t expected = serial_tree(depth, work, 1);
+	test_time end = test_now();
+	const double serial = test_millisecs(start, end);
+
+	{
+		start = test_now();
+		tree_job root(depth, work, 1);
+		root.enqueue();
+		root.join();
+		end = test_now();
+		report("tree", serial, test_millisecs(start, end), root.total() == expected);
+	}
+
+	{
+		const size_t leaves = size_t(1) << depth;
+		std::vector<leaf_job> jobs(leaves);
+		start = test_now();
+		for (size_t i = 0; i < leaves; ++i) {
+			jobs[i].work = work;
+			jobs[i].seed = leaves + i;
+			jobs[i].enqueue();
+		}
+		std::uint64_t result = 0;
+		for (size_t i = 0; i < leaves; ++i) jobs[i].join();
+		for (size_t i = 0; i < leaves; ++i) result ^= jobs[i].result;
+		end = test_now();
+		report("flat", serial, test_millisecs(start, end), result == expected);
+	}
+
+	{
+		start = test_now();
+		nested_job root(depth, work, 1);
+		root.enqueue();
+		root.join();
+		end = test_now();
+		report("nested", serial, test_millisecs(start, end), root.result == expected);
+	}
+
+	tpie::tpie_finish();
+	return 0;
+}
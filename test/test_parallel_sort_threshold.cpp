@@ -101,10 +101,40 @@ size_t find_threshold(size_t center, size_t radius, std::vector<test_t> & data)
 	return best;
 }
 
+// fill a vector with only a few distinct values.
+void fill_few_distinct(std::vector<test_t> & data) {
+	std::mt19937 rng; // default seed
+	for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<test_t>(rng() % 16);
+}
+
+// time the quick sort with its default threshold against the sample sort on
+// 1, 2, 4, ... up to `threads' threads.
+void compare_sample_sort(size_t threads, std::vector<test_t> & data) {
+	void (* fills[])(std::vector<test_t> &) = {fill_data, fill_few_distinct};
+	const char * names[] = {"random", "16 distinct"};
+	for (size_t f = 0; f < 2; ++f) {
+		fills[f](data);
+		tpie::test_time start=tpie::test_now();
+		tpie::parallel_sort_impl<std::vector<test_t>::iterator, std::less<test_t>, false> s(0);
+		s(data.begin(), data.end());
+		tpie::test_time end=tpie::test_now();
+		std::cout << names[f] << " quick sort " << tpie::test_secs(start, end) << std::endl;
+		for (size_t t = 1; t <= threads; t *= 2) {
+			fills[f](data);
+			start=tpie::test_now();
+			tpie::parallel_sample_sort_impl<std::vector<test_t>::iterator, std::less<test_t> > ss(t);
+			ss(data.begin(), data.end());
+			end=tpie::test_now();
+			std::cout << names[f] << " sample sort, " << t << " threads " << tpie::test_secs(start, end) << std::endl;
+		}
+	}
+}
+
 int main(int argc, char ** argv) {
 	// argument parsing
 	if (argc < 2) {
-		std::cout << "Usage: " << argv[0] << " mb" << std::endl;
+		std::cout << "Usage: " << argv[0] << " mb [threads]" << std::endl;
+		std::cout << "With threads, compare the sample sort to the quick sort instead." << std::endl;
 		return 1;
 	}
 	tpie::sysinfo si;
@@ -117,6 +147,14 @@ int main(int argc, char ** argv) {
 
 	// program
 	tpie::tpie_init();
+	if (argc > 2) {
+		size_t threads;
+		std::stringstream ts(argv[2]);
+		ts >> threads;
+		compare_sample_sort(threads, data);
+		tpie::tpie_finish();
+		return 0;
+	}
 	size_t center = thresholdMax/2;
 	size_t radius = thresholdMax/2;
 
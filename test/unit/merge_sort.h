@@ -76,7 +76,8 @@ static bool sort_test(memory_size_type m1,
 					  memory_size_type extraMemory = 0,
 					  bool evacuateBeforeMerge = false,
 					  bool evacuateBeforeReport = false,
-					  memory_size_type file_limit = 0)
+					  memory_size_type file_limit = 0,
+					  memory_size_type mergeThreads = 1)
 {
 	m1 *= 1024*1024;
 	m2 *= 1024*1024;
@@ -90,6 +91,7 @@ static bool sort_test(memory_size_type m1,
 	sorter s;
 	s.set_available_memory(m1, m2, m3);
 	s.set_available_files(file_limit);
+	if (mergeThreads > 1) s.set_parallel_merge(mergeThreads);
 
 	log_debug() << "Begin phase 1" << std::endl;
 	m.set_threshold(m1);
@@ -179,6 +181,10 @@ static bool evacuate_before_report_test() {
 	return sort_test(20,20,20,50, 0, false, true);
 }
 
+static bool parallel_merge_test() {
+	return sort_test(20,20,20,50, 0, false, false, 0, 4);
+}
+
 static bool file_limit_test(int limit) {
 	get_file_manager().set_limit(limit);
 	get_file_manager().set_enforcement(file_manager::ENFORCE_THROW);
@@ -202,6 +208,7 @@ static tests & add_all(tests & t) {
 #endif
 		.test(evacuate_before_merge_test, "evacuate_before_merge")
 		.test(evacuate_before_report_test, "evacuate_before_report")
+		.test(parallel_merge_test, "parallel_merge")
 		;
 }
 
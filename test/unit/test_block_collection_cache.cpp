@@ -25,6 +25,7 @@
 #include <tpie/tempname.h>
 #include <vector>
 #include <deque>
+#include <list>
 #include <algorithm>
 #include <tpie/file_accessor/file_accessor.h>
 
@@ -191,9 +192,127 @@ bool overwrite() {
 	return true;
 }
 
+// The two blocks read last must stay in the cache, however small it is.
+bool recent() {
+	temp_file file;
+	block_collection_cache collection(file.path(), BLOCK_SIZE, 0, true);
+	TEST_ENSURE_EQUALITY(block_collection_cache::min_capacity(), collection.capacity(), "Wrong minimum capacity");
+	std::vector<block_handle> blocks;
+
+	for(char i = 0; i < 20; ++i) {
+		block_handle handle = collection.get_free_block();
+		block * b = collection.read_block(handle);
+		std::fill(b->begin(), b->end(), i);
+		collection.write_block(handle);
+		blocks.push_back(handle);
+	}
+
+	for(memory_size_type i = 0; i < 200; ++i) {
+		memory_size_type x = random(i) % blocks.size();
+		memory_size_type y = random(i + 1000) % blocks.size();
+		if (x == y) continue;
+		block * a = collection.read_block(blocks[x]);
+		block * b = collection.read_block(blocks[y]);
+		TEST_ENSURE_EQUALITY((int) x, (int) (*a)[0], "first block was evicted by the second read");
+		TEST_ENSURE_EQUALITY((int) y, (int) (*b)[0], "second block has the wrong content");
+		collection.write_block(blocks[x]);
+		collection.write_block(blocks[y]);
+	}
+	return true;
+}
+
+bool capacity() {
+	for (memory_size_type n : {4, 5, 32, 1000}) {
+		memory_size_type memory = block_collection_cache::memory_usage(n, BLOCK_SIZE);
+		TEST_ENSURE_EQUALITY(n, block_collection_cache::capacity_for_memory(memory, BLOCK_SIZE), "capacity_for_memory does not invert memory_usage");
+		TEST_ENSURE(n == block_collection_cache::min_capacity()
+					|| block_collection_cache::capacity_for_memory(memory - 1, BLOCK_SIZE) < n,
+					"capacity_for_memory exceeds the budget");
+	}
+
+	temp_file file;
+	block_collection_cache collection(file.path(), BLOCK_SIZE, 10, true);
+	// The bookkeeping is allocated up front; blocks are added as they are used.
+	memory_size_type used = get_memory_manager().used();
+	std::vector<block_handle> blocks;
+	for(char i = 0; i < 30; ++i) {
+		block_handle handle = collection.get_free_block();
+		block * b = collection.read_block(handle);
+		std::fill(b->begin(), b->end(), i);
+		collection.write_block(handle);
+		blocks.push_back(handle);
+		TEST_ENSURE(get_memory_manager().used() - used <= 10 * (sizeof(block) + BLOCK_SIZE),
+					"cache holds more blocks than its capacity");
+	}
+
+	// Shrinking writes back every cached block.
+	collection.set_capacity(5);
+	TEST_ENSURE_EQUALITY(5, collection.capacity(), "capacity was not changed");
+	for(char i = 0; i < 30; ++i) {
+		block * b = collection.read_block(blocks[i]);
+		TEST_ENSURE_EQUALITY((int) i, (int) (*b)[BLOCK_SIZE - 1], "the content of the returned block is not correct");
+	}
+	return true;
+}
+
+bool pinned() {
+	temp_file file;
+	block_collection_cache collection(file.path(), BLOCK_SIZE, 0, true);
+	std::vector<block_handle> blocks;
+
+	for(char i = 0; i < 20; ++i) {
+		block_handle handle = collection.get_free_block();
+		block * b = collection.read_block(handle);
+		std::fill(b->begin(), b->end(), i);
+		collection.write_block(handle);
+		blocks.push_back(handle);
+	}
+
+	std::vector<block_handle> pins(blocks.begin(), blocks.begin() + 6);
+	collection.set_pinned(pins);
+	TEST_ENSURE_EQUALITY(6, collection.pinned_count(), "Wrong number of pinned blocks");
+
+	for (int round = 0; round < 2; ++round) {
+		std::vector<block *> pointers;
+		for (size_t i = 0; i < pins.size(); ++i)
+			pointers.push_back(collection.read_block(pins[i]));
+
+		for(memory_size_type i = 0; i < 200; ++i) {
+			memory_size_type x = pins.size() + random(i) % (blocks.size() - pins.size());
+			block * b = collection.read_block(blocks[x]);
+			TEST_ENSURE_EQUALITY((int) x, (int) (*b)[0], "unpinned block has the wrong content");
+		}
+
+		for (size_t i = 0; i < pins.size(); ++i) {
+			TEST_ENSURE(pointers[i] == collection.read_block(pins[i]), "pinned block was evicted");
+			TEST_ENSURE_EQUALITY((int) i, (int) (*pointers[i])[0], "pinned block has the wrong content");
+		}
+
+		// Pinned blocks survive a change of capacity.
+		collection.set_capacity(5);
+	}
+
+	// A freed pinned block may be handed out again.
+	collection.free_block(pins[0]);
+	for (int i = 0; i < 10; ++i) {
+		block_handle handle = collection.get_free_block();
+		block * b = collection.read_block(handle);
+		std::fill(b->begin(), b->end(), 100 + i);
+		collection.write_block(handle);
+	}
+	for (size_t i = 1; i < pins.size(); ++i) {
+		block * b = collection.read_block(pins[i]);
+		TEST_ENSURE_EQUALITY((int) i, (int) (*b)[0], "pinned block was overwritten");
+	}
+	return true;
+}
+
 int main(int argc, char **argv) {
 	return tpie::tests(argc, argv)
 		.test(basic, "basic")
 		.test(erase, "erase")
-		.test(overwrite, "overwrite");
+		.test(overwrite, "overwrite")
+		.test(recent, "recent")
+		.test(capacity, "capacity")
+		.test(pinned, "pinned");
 }
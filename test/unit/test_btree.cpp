@@ -21,7 +21,10 @@
 #include <tpie/tpie.h>
 #include <tpie/btree.h>
 #include <tpie/tempname.h>
+#include <tpie/pipelining.h>
+#include <tpie/pipelining/btree_lookup.h>
 #include <algorithm>
+#include <iterator>
 #include <set>
 #include <map>
 #include <numeric>
@@ -511,6 +514,153 @@ bool static_iterator_test(TA<TT...> ta, A && ... a) {
 	return iterator_test(TA<btree_augment<ss_augmenter>, TT...>{}, tree, tree2);
 }
 
+template<typename ... TT, typename ... A>
+bool pin_test(TA<TT...> ta, A && ... a) {
+	if (!build_test(ta, std::forward<A>(a)...)) {
+		return false;
+	}
+	default_comp c;
+	ss_augmenter au;
+	auto tree = get_btree(ta, c, au, std::forward<A>(a)...);
+	set<int> tree2;
+
+	for (size_t i=0; i < 50000; ++i) {
+		tree2.insert(i);
+	}
+
+	TEST_ENSURE(tree.pin_levels(100, 1024*1024*1024) >= 2, "Too few levels pinned");
+	TEST_ENSURE(compare(tree, tree2), "Compare failed with all levels pinned");
+	for (int i=0; i < 50000; i += 7) {
+		TEST_ENSURE(tree.find(i) != tree.end() && *tree.find(i) == i, "Find failed with all levels pinned");
+	}
+
+	TEST_ENSURE(tree.pin_levels(100, 0) <= 1, "Pinned levels exceed the memory");
+	TEST_ENSURE(compare(tree, tree2), "Compare failed after unpinning");
+	return true;
+}
+
+// Pinned nodes must stay correct while the tree around them changes.
+bool external_dynamic_pin_test() {
+	temp_file tmp;
+	btree<int, btree_external, btree_fanout<2, 4> > tree(tmp.path());
+	set<int> tree2;
+
+	std::vector<int> x;
+	for (int i=0; i < 1234; ++i) {
+		x.push_back(i);
+	}
+	std::random_shuffle(x.begin(), x.end());
+	for (size_t i=0; i < x.size() / 2; ++i) {
+		tree.insert(x[i]);
+		tree2.insert(x[i]);
+	}
+
+	TEST_ENSURE_EQUALITY(memory_size_type(3), tree.pin_levels(3, 1024*1024), "Wrong number of levels pinned");
+
+	for (size_t i=x.size() / 2; i < x.size(); ++i) {
+		tree.insert(x[i]);
+		tree2.insert(x[i]);
+	}
+	std::random_shuffle(x.begin(), x.end());
+	for (size_t i=0; i < x.size() / 2; ++i) {
+		tree.erase(x[i]);
+		tree2.erase(x[i]);
+	}
+
+	TEST_ENSURE_EQUALITY(tree2.size(), tree.size(), "The tree has the wrong size");
+	TEST_ENSURE(compare(tree, tree2), "Compare failed");
+	for (int i=0; i < 1234; ++i) {
+		TEST_ENSURE((tree.find(i) != tree.end()) == (tree2.count(i) != 0), "Find failed");
+	}
+	return true;
+}
+
+// Compare key_rank with std::lower_bound and std::upper_bound on sorted
+// keys with duplicates, both contiguous and interleaved with other data.
+template <typename K>
+bool key_search_test_type() {
+	struct padded {
+		K key;
+		int64_t pad[3];
+	};
+	for (size_t n = 0; n < 300; n += (n < 70 ? 1 : 23)) {
+		std::vector<K> keys;
+		std::vector<padded> strided(n);
+		for (size_t i=0; i < n; ++i) {
+			keys.push_back(K(i / 3));
+			strided[i].key = keys[i];
+		}
+		for (int q=-5; q < int(n / 3) + 5; ++q) {
+			K k = K(q);
+			size_t lo = std::lower_bound(keys.begin(), keys.end(), k) - keys.begin();
+			size_t hi = std::upper_bound(keys.begin(), keys.end(), k) - keys.begin();
+			TEST_ENSURE_EQUALITY(lo, (bbits::key_rank<false>(keys.data(), sizeof(K), n, k)), "Contiguous lower rank wrong");
+			TEST_ENSURE_EQUALITY(hi, (bbits::key_rank<true>(keys.data(), sizeof(K), n, k)), "Contiguous upper rank wrong");
+			if (n == 0) continue;
+			TEST_ENSURE_EQUALITY(lo, (bbits::key_rank<false>(&strided[0].key, sizeof(padded), n, k)), "Strided lower rank wrong");
+			TEST_ENSURE_EQUALITY(hi, (bbits::key_rank<true>(&strided[0].key, sizeof(padded), n, k)), "Strided upper rank wrong");
+		}
+	}
+	return true;
+}
+
+bool key_search_test() {
+	return key_search_test_type<int32_t>()
+		&& key_search_test_type<int64_t>()
+		&& key_search_test_type<uint16_t>()
+		&& key_search_test_type<float>()
+		&& key_search_test_type<double>();
+}
+
+// find_many and lower_bound_many must agree with find and lower_bound,
+// whether or not the keys are sorted.
+template <typename tree_t>
+bool lookup_many_check(const tree_t & tree, std::vector<int> keys) {
+	for (int round = 0; round < 2; ++round) {
+		std::vector<typename tree_t::iterator> found;
+		std::vector<typename tree_t::iterator> bounds;
+		tree.find_many(keys.begin(), keys.end(), std::back_inserter(found));
+		tree.lower_bound_many(keys.begin(), keys.end(), std::back_inserter(bounds));
+		TEST_ENSURE_EQUALITY(keys.size(), found.size(), "find_many output size");
+		TEST_ENSURE_EQUALITY(keys.size(), bounds.size(), "lower_bound_many output size");
+		for (size_t i=0; i < keys.size(); ++i) {
+			TEST_ENSURE(found[i] == tree.find(keys[i]), "find_many differs from find");
+			TEST_ENSURE(bounds[i] == tree.lower_bound(keys[i]), "lower_bound_many differs from lower_bound");
+		}
+		std::random_shuffle(keys.begin(), keys.end());
+	}
+	return true;
+}
+
+template<typename ... TT, typename ... A>
+bool dynamic_lookup_many_test(TA<TT...>, A && ... a) {
+	btree<int, TT...> tree(std::forward<A>(a)...);
+	std::vector<int> keys;
+	if (!lookup_many_check(tree, std::vector<int>(3, 1))) return false;
+	for (int i=0; i < 2000; ++i) {
+		tree.insert(2*i);
+		if (i % 3 == 0) tree.insert(2*i);
+	}
+	for (int i=-3; i < 4003; ++i) {
+		keys.push_back(i);
+		if (i % 5 == 0) keys.push_back(i);
+	}
+	return lookup_many_check(tree, keys);
+}
+
+template<typename ... TT, typename ... A>
+bool static_lookup_many_test(TA<TT...> ta, A && ... a) {
+	if (!build_test(ta, std::forward<A>(a)...)) {
+		return false;
+	}
+	default_comp c;
+	ss_augmenter au;
+	auto tree = get_btree(ta, c, au, std::forward<A>(a)...);
+	std::vector<int> keys;
+	for (int i=-3; i < 50003; i += 29) keys.push_back(i);
+	return lookup_many_check(tree, keys);
+}
+
 bool internal_basic_test() {
 	return basic_test(TA<btree_internal>());
 }
@@ -588,6 +738,52 @@ bool external_static_iterator_test() {
 	return static_iterator_test(TA<btree_external, btree_static>(), tmp.path());
 }
 
+// A tall tree with a cache of only a few blocks evicts on almost every access.
+bool external_small_cache_test() {
+	temp_file tmp;
+	return bound_test(TA<btree_external, btree_fanout<2, 4> >(), tmp.path(), memory_size_type(0));
+}
+
+bool external_pin_test() {
+	temp_file tmp;
+	return pin_test(TA<btree_external, btree_static>(), tmp.path());
+}
+
+bool internal_lookup_many_test() {
+	return dynamic_lookup_many_test(TA<btree_internal, btree_fanout<2, 4> >());
+}
+
+bool external_lookup_many_test() {
+	temp_file tmp;
+	return dynamic_lookup_many_test(TA<btree_external, btree_fanout<2, 4> >(), tmp.path());
+}
+
+bool external_static_lookup_many_test() {
+	temp_file tmp;
+	return static_lookup_many_test(TA<btree_external, btree_static>(), tmp.path());
+}
+
+bool pipelining_find_test() {
+	temp_file tmp;
+	btree<int, btree_external, btree_fanout<2, 4> > tree(tmp.path());
+	for (int i=0; i < 1000; i += 2) tree.insert(i);
+
+	std::vector<int> keys;
+	for (int i=0; i < 1000; ++i) keys.push_back(i);
+	std::vector<std::pair<int, decltype(tree)::iterator> > results;
+	pipelining::pipeline p = pipelining::input_vector(keys)
+		| pipelining::btree_find(tree)
+		| pipelining::output_vector(results);
+	p();
+
+	TEST_ENSURE_EQUALITY(keys.size(), results.size(), "Wrong number of results");
+	for (size_t i=0; i < results.size(); ++i) {
+		TEST_ENSURE_EQUALITY(keys[i], results[i].first, "Key not passed on");
+		TEST_ENSURE(results[i].second == tree.find(keys[i]), "Wrong lookup result");
+	}
+	return true;
+}
+
 bool serialized_build_test() {
     temp_file tmp;
     return build_test(TA<btree_external, btree_serialized, btree_static>(), tmp.path());
@@ -603,6 +799,16 @@ bool serialized_iterator_test() {
 	return static_iterator_test(TA<btree_external, btree_serialized, btree_static>(), tmp.path());
 }
 
+bool serialized_pin_test() {
+	temp_file tmp;
+	return pin_test(TA<btree_external, btree_serialized, btree_static>(), tmp.path());
+}
+
+bool serialized_lookup_many_test() {
+	temp_file tmp;
+	return static_lookup_many_test(TA<btree_external, btree_serialized, btree_static>(), tmp.path());
+}
+
 bool serialized_lz4_build_test() {
 	SKIP_IF_NO_LZ4;
 	temp_file tmp;
@@ -668,6 +874,8 @@ int main(int argc, char **argv) {
 		.test(internal_static_test, "internal_static")
 		.test(internal_unordered_test, "internal_unordered")
 		.test(internal_bound_test, "internal_bound")
+		.test(internal_lookup_many_test, "internal_lookup_many")
+		.test(key_search_test, "key_search")
 		.test(external_basic_test, "external_basic")
 		.test(external_iterator_test, "external_iterator")
 		.test(external_key_and_comparator_test, "external_key_and_compare")
@@ -677,9 +885,17 @@ int main(int argc, char **argv) {
 		.test(external_reopen_test, "external_reopen")
 		.test(external_static_reopen_test, "external_static_reopen")
 		.test(external_static_iterator_test, "external_static_iterator")
+		.test(external_small_cache_test, "external_small_cache")
+		.test(external_pin_test, "external_pin")
+		.test(external_dynamic_pin_test, "external_dynamic_pin")
+		.test(external_lookup_many_test, "external_lookup_many")
+		.test(external_static_lookup_many_test, "external_static_lookup_many")
+		.test(pipelining_find_test, "pipelining_find")
 		.test(serialized_build_test, "serialized_build")
 		.test(serialized_reopen_test, "serialized_reopen")
 		.test(serialized_iterator_test, "serialized_iterator")
+		.test(serialized_pin_test, "serialized_pin")
+		.test(serialized_lookup_many_test, "serialized_lookup_many")
         .test(serialized_lz4_build_test, "serialized_lz4_build")
 		.test(serialized_lz4_reopen_test, "serialized_lz4_reopen")
         .test(serialized_snappy_build_test, "serialized_snappy_build")
@@ -19,6 +19,7 @@
 
 #include "common.h"
 #include <tpie/compressed/stream.h>
+#include <tpie/compressed/thread.h>
 #include <tpie/file_stream.h>
 
 template <tpie::compression_flags flags>
@@ -998,6 +999,35 @@ bool stack_test() {
 	return true;
 }
 
+bool compressor_pool_test(size_t streams, size_t n) {
+	const tpie::memory_size_type oldThreads = tpie::get_compressor_thread_count();
+	tpie::set_compressor_thread_count(4);
+	bool result = true;
+	{
+		tpie::array<tpie::temp_file> files(streams);
+		tpie::array<tpie::file_stream<size_t> > fs(streams);
+		for (size_t j = 0; j < streams; ++j)
+			fs[j].open(files[j], tpie::compression_all);
+		for (size_t i = 0; i < n; ++i)
+			for (size_t j = 0; j < streams; ++j)
+				fs[j].write(i * streams + j);
+		for (size_t j = 0; j < streams; ++j) fs[j].seek(0);
+		for (size_t i = 0; i < n && result; ++i) {
+			for (size_t j = 0; j < streams; ++j) {
+				size_t x = fs[j].read();
+				if (x != i * streams + j) {
+					tpie::log_error() << "Stream " << j << ": got " << x
+									  << ", expected " << i * streams + j << std::endl;
+					result = false;
+					break;
+				}
+			}
+		}
+	}
+	tpie::set_compressor_thread_count(oldThreads);
+	return result;
+}
+
 template <tpie::compression_flags flags>
 tpie::tests & add_tests(tpie::tests & t, std::string suffix) {
 	typedef tests<flags> T;
@@ -1040,5 +1070,6 @@ int main(int argc, char ** argv) {
 		.test(write_peek_test, "write_peek", "n", static_cast<size_t>(1 << 23))
 		/* .test(read_only_test, "read_only") */
 		.test(write_only_test, "write_only")
-		.test(stack_test, "lockstep_reverse");
+		.test(stack_test, "lockstep_reverse")
+		.test(compressor_pool_test, "compressor_pool", "streams", static_cast<size_t>(8), "n", static_cast<size_t>(1 << 20));
 }
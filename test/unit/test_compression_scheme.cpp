@@ -0,0 +1,231 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet cino+=(0 :
+// Copyright 2013 The TPIE development team
+// 
+// This file is part of TPIE.
+// 
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+// 
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include "common.h"
+#include <cstring>
+#include <tpie/array.h>
+#include <tpie/file_stream.h>
+#include <tpie/compressed/scheme.h>
+
+namespace {
+
+const tpie::compression_scheme::type builtin_schemes[] = {
+	tpie::compression_scheme::none,
+	tpie::compression_scheme::snappy,
+	tpie::compression_scheme::lz4,
+	tpie::compression_scheme::zstd
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Trivial user-defined scheme that flips the bits of every byte.
+///////////////////////////////////////////////////////////////////////////////
+class flip_scheme : public tpie::compression_scheme {
+public:
+	virtual size_t max_compressed_length(size_t srcSize) const override {
+		return srcSize;
+	}
+
+	virtual void compress(char * dest, const char * src, size_t srcSize, size_t * destSize) const override {
+		for (size_t i = 0; i < srcSize; ++i) dest[i] = static_cast<char>(~src[i]);
+		*destSize = srcSize;
+	}
+
+	virtual size_t uncompressed_length(const char * /*src*/, size_t srcSize) const override {
+		return srcSize;
+	}
+
+	virtual void uncompress(char * dest, const char * src, size_t srcSize) const override {
+		for (size_t i = 0; i < srcSize; ++i) dest[i] = static_cast<char>(~src[i]);
+	}
+};
+
+flip_scheme the_flip_scheme;
+
+const tpie::compression_scheme::type flip_scheme_type = tpie::compression_scheme::user_defined;
+
+} // unnamed namespace
+
+bool roundtrip_test(size_t n) {
+	tpie::array<char> input(n);
+	for (size_t i = 0; i < n; ++i)
+		input[i] = static_cast<char>((i % 97 < 50) ? 'a' : (i * 7919) >> 3);
+	for (tpie::compression_scheme::type t : builtin_schemes) {
+		const tpie::compression_scheme & scheme = tpie::get_compression_scheme(t);
+		tpie::array<char> compressed(scheme.max_compressed_length(n));
+		size_t compressedSize;
+		scheme.compress(compressed.get(), input.get(), n, &compressedSize);
+		if (compressedSize > compressed.size()) {
+			tpie::log_error() << "Scheme " << t << ": compressed size too large" << std::endl;
+			return false;
+		}
+		if (scheme.uncompressed_length(compressed.get(), compressedSize) != n) {
+			tpie::log_error() << "Scheme " << t << ": wrong uncompressed length" << std::endl;
+			return false;
+		}
+		tpie::array<char> output(n);
+		scheme.uncompress(output.get(), compressed.get(), compressedSize);
+		if (memcmp(input.get(), output.get(), n) != 0) {
+			tpie::log_error() << "Scheme " << t << ": wrong output" << std::endl;
+			return false;
+		}
+		tpie::log_info() << "Scheme " << t << ": " << n << " -> " << compressedSize << " bytes" << std::endl;
+	}
+	return true;
+}
+
+bool mixed_test(size_t n) {
+	tpie::register_compression_scheme(flip_scheme_type, the_flip_scheme);
+	const size_t blockItems = 1024;
+	const double blockFactor = tpie::file_stream<uint64_t>::calculate_block_factor(blockItems * sizeof(uint64_t));
+	tpie::temp_file tf;
+	{
+		tpie::file_stream<uint64_t> fs(blockFactor);
+		fs.open(tf, tpie::open::compression_all);
+		for (size_t i = 0; i < n; ++i) {
+			if (i % blockItems == 0) {
+				const size_t schemes = sizeof(builtin_schemes) / sizeof(builtin_schemes[0]);
+				const size_t j = (i / blockItems) % (schemes + 1);
+				fs.set_preferred_compression(j == schemes ? flip_scheme_type : builtin_schemes[j]);
+			}
+			fs.write(i * 31 / 7);
+		}
+	}
+	tpie::file_stream<uint64_t> fs(blockFactor);
+	fs.open(tf, tpie::open::read_only);
+	if (fs.size() != n) {
+		tpie::log_error() << "Wrong size " << fs.size() << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t x = fs.read();
+		if (x != i * 31 / 7) {
+			tpie::log_error() << "Wrong item " << x << " at " << i << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool adaptive_test(size_t n) {
+	tpie::compression_scheme::type scheme = tpie::compression_scheme::none;
+	for (tpie::compression_scheme::type t : builtin_schemes) {
+		if (&tpie::get_compression_scheme(t) != &tpie::get_compression_scheme_none()) {
+			scheme = t;
+			break;
+		}
+	}
+	const size_t blockItems = 1024;
+	const double blockFactor = tpie::file_stream<uint64_t>::calculate_block_factor(blockItems * sizeof(uint64_t));
+	tpie::temp_file tf;
+	tpie::compression_statistics stats;
+	{
+		tpie::file_stream<uint64_t> fs(blockFactor);
+		fs.open(tf, tpie::open::compression_adaptive);
+		fs.set_preferred_compression(scheme);
+		// Incompressible first half, compressible second half.
+		uint64_t x = 42;
+		for (size_t i = 0; i < n / 2; ++i) {
+			x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+			fs.write(x);
+		}
+		for (size_t i = n / 2; i < n; ++i) fs.write(i / 100);
+		fs.seek(0);
+		stats = fs.get_compression_statistics();
+	}
+	const size_t blocks = (n + blockItems - 1) / blockItems;
+	tpie::log_info() << "Compressed blocks: " << stats.compressedBlocks
+					 << "\nUncompressed blocks: " << stats.uncompressedBlocks
+					 << "\nBytes saved: " << stats.bytes_saved()
+					 << "\nCompression time (us): " << stats.compressionMicroseconds << std::endl;
+	// The last block may still be held by the stream.
+	const size_t recorded = stats.compressedBlocks + stats.uncompressedBlocks;
+	if (recorded != blocks && recorded != blocks - 1) {
+		tpie::log_error() << "Expected " << blocks << " blocks in statistics, got " << recorded << std::endl;
+		return false;
+	}
+	if (stats.inputBytes != recorded * blockItems * sizeof(uint64_t)) {
+		tpie::log_error() << "Wrong number of input bytes in statistics" << std::endl;
+		return false;
+	}
+	if (scheme == tpie::compression_scheme::none) {
+		tpie::log_warning() << "No compression scheme built in" << std::endl;
+	} else {
+		// Most of the incompressible blocks are skipped, and most of the
+		// compressible blocks are compressed.
+		if (stats.uncompressedBlocks < blocks / 4 || stats.compressedBlocks < blocks / 4) {
+			tpie::log_error() << "Adaptive compression did not adapt" << std::endl;
+			return false;
+		}
+		if (stats.bytes_saved() == 0) {
+			tpie::log_error() << "No bytes saved" << std::endl;
+			return false;
+		}
+	}
+	tpie::file_stream<uint64_t> fs(blockFactor);
+	fs.open(tf, tpie::open::read_only);
+	uint64_t x = 42;
+	for (size_t i = 0; i < n; ++i) {
+		uint64_t expected;
+		if (i < n / 2) {
+			x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+			expected = x;
+		} else {
+			expected = i / 100;
+		}
+		if (fs.read() != expected) {
+			tpie::log_error() << "Wrong item at " << i << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool register_test() {
+	try {
+		tpie::register_compression_scheme(tpie::compression_scheme::lz4, the_flip_scheme);
+		tpie::log_error() << "Registering a built-in type did not throw" << std::endl;
+		return false;
+	} catch (const tpie::invalid_argument_exception &) {
+		// Expected.
+	}
+	const tpie::compression_scheme::type unknown =
+		static_cast<tpie::compression_scheme::type>(tpie::compression_scheme::user_defined + 1);
+	if (tpie::is_compression_scheme_known(unknown)) {
+		tpie::log_error() << "Unregistered type is known" << std::endl;
+		return false;
+	}
+	try {
+		tpie::get_compression_scheme(unknown);
+		tpie::log_error() << "Getting an unregistered type did not throw" << std::endl;
+		return false;
+	} catch (const tpie::stream_exception &) {
+		// Expected.
+	}
+	tpie::register_compression_scheme(unknown, the_flip_scheme);
+	return &tpie::get_compression_scheme(unknown) == &the_flip_scheme;
+}
+
+int main(int argc, char ** argv) {
+	return tpie::tests(argc, argv)
+	.test(roundtrip_test, "roundtrip", "n", static_cast<size_t>(1 << 20))
+	.test(mixed_test, "mixed", "n", static_cast<size_t>(1 << 16))
+	.test(register_test, "register")
+	.test(adaptive_test, "adaptive", "n", static_cast<size_t>(1 << 18))
+	;
+}
@@ -64,12 +64,58 @@ private:
 	const float m_block_factor;
 };
 
+// The extra buffers of read-ahead and write-behind must be accounted for.
+class buffered_stream_memory_test : public memory_test {
+public:
+	buffered_stream_memory_test(float block_factor = 1.0f) :
+		m_block_factor(block_factor) {
+		// Empty ctor
+	}
+
+	virtual void alloc() {
+		m_stream = tpie_new<uncompressed_stream<size_t> >(m_block_factor);
+		m_stream->set_read_ahead(READ_AHEAD);
+		m_stream->set_write_behind(true);
+	}
+
+	virtual void use() {
+		m_stream->open(tmp.path());
+		for (size_t i = 0; i < ITEMS; ++i) {
+			m_stream->write(i);
+		}
+		m_stream->seek(0);
+		for (size_t i = 0; i < ITEMS; ++i) {
+			if (m_stream->read() != i) throw exception("Read wrong item");
+		}
+	}
+
+	virtual void free() {
+		tpie_delete<uncompressed_stream<size_t> >(m_stream);
+		m_stream = 0;
+	}
+
+	virtual size_type claimed_size() {
+		return uncompressed_stream<size_t>::memory_usage(m_block_factor, true, READ_AHEAD, true);
+	}
+
+private:
+	static const memory_size_type READ_AHEAD = 3;
+	temp_file tmp;
+	uncompressed_stream<size_t> * m_stream;
+	const float m_block_factor;
+};
+
 bool memory(bool block_factor) {
 	return file_stream_memory_test(block_factor)();
 }
 
+bool buffered_memory(double block_factor) {
+	return buffered_stream_memory_test(static_cast<float>(block_factor))();
+}
+
 int main(int argc, char **argv) {
 	return tpie::tests(argc, argv)
-		.test(memory, "memory", "block-factor", 1.0);
+		.test(memory, "memory", "block-factor", 1.0)
+		.test(buffered_memory, "buffered_memory", "block-factor", 1.0);
 
 }
@@ -60,8 +60,49 @@ bool repeat_test() {
 	return true;
 }
 
+// Sums the leaves of a binary tree by enqueueing both subtrees and joining
+// them. Every pool worker ends up waiting in join(), so this only finishes
+// if waiting threads run the queued jobs themselves.
+class nested_job : public tpie::job {
+	size_t depth;
+public:
+	size_t leaves;
+
+	nested_job(size_t depth)
+		: depth(depth)
+		, leaves(0)
+	{
+	}
+
+	void operator()() {
+		if (depth == 0) {
+			leaves = 1;
+			return;
+		}
+		nested_job left(depth-1);
+		nested_job right(depth-1);
+		left.enqueue();
+		right.enqueue();
+		left.join();
+		right.join();
+		leaves = left.leaves + right.leaves;
+	}
+};
+
+bool nested_join_test(size_t depth) {
+	nested_job root(depth);
+	root.enqueue();
+	root.join();
+	if (root.leaves != (size_t(1) << depth)) {
+		tpie::log_error() << "Counted " << root.leaves << " leaves, expected " << (size_t(1) << depth) << std::endl;
+		return false;
+	}
+	return true;
+}
+
 int main(int argc, char **argv) {
 	return tpie::tests(argc, argv)
 		.test(repeat_test, "repeat")
+		.test(nested_join_test, "nested_join", "depth", static_cast<size_t>(12))
 		;
 }
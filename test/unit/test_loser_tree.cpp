@@ -0,0 +1,104 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+// 
+// This file is part of TPIE.
+// 
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+// 
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+#include "common.h"
+#include <tpie/loser_tree.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace tpie;
+
+// Merge k sorted runs of random lengths (some empty) and compare with
+// sorting all items directly.
+bool merge_test(size_t k, size_t maxRunLength) {
+	std::mt19937 rng(static_cast<unsigned>(k * 7919 + maxRunLength));
+	std::vector<std::vector<int> > runs(k);
+	std::vector<int> expected;
+	for (size_t i = 0; i < k; ++i) {
+		size_t n = rng() % (maxRunLength + 1);
+		for (size_t j = 0; j < n; ++j) runs[i].push_back(static_cast<int>(rng() % 1000));
+		std::sort(runs[i].begin(), runs[i].end());
+		expected.insert(expected.end(), runs[i].begin(), runs[i].end());
+	}
+	std::sort(expected.begin(), expected.end());
+
+	loser_tree<int> lt;
+	lt.resize(k);
+	std::vector<size_t> next(k, 0);
+	for (size_t i = 0; i < k; ++i)
+		if (!runs[i].empty()) lt.unsafe_set(i, runs[i][next[i]++]);
+	lt.make_safe();
+
+	std::vector<int> got;
+	while (!lt.empty()) {
+		size_t i = lt.top_index();
+		if (lt.top() != runs[i][next[i] - 1]) {
+			log_error() << "top() does not belong to top_index()" << std::endl;
+			return false;
+		}
+		got.push_back(lt.top());
+		if (next[i] < runs[i].size()) lt.replace_top(runs[i][next[i]++]);
+		else lt.pop();
+	}
+	if (got != expected) {
+		log_error() << "Wrong merge output for k = " << k << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool basic_test() {
+	const size_t fanouts[] = {0, 1, 2, 3, 5, 8, 13, 64, 250};
+	for (size_t k : fanouts) {
+		if (!merge_test(k, 0)) return false;
+		if (!merge_test(k, 1)) return false;
+		if (!merge_test(k, 200)) return false;
+	}
+	return true;
+}
+
+bool greater_test() {
+	loser_tree<int, std::greater<int> > lt;
+	lt.resize(3);
+	lt.unsafe_set(0, 5);
+	lt.unsafe_set(2, 9);
+	lt.make_safe();
+	if (lt.size() != 2 || lt.top() != 9 || lt.top_index() != 2) return false;
+	lt.replace_top(1);
+	if (lt.top() != 5 || lt.top_index() != 0) return false;
+	lt.pop();
+	if (lt.top() != 1) return false;
+	lt.pop();
+	return lt.empty();
+}
+
+class my_memory_test: public memory_test {
+public:
+	loser_tree<int> * a;
+	virtual void alloc() {a = tpie_new<loser_tree<int> >(); a->resize(123456);}
+	virtual void free() {tpie_delete(a);}
+	virtual size_type claimed_size() {return static_cast<size_type>(loser_tree<int>::memory_usage(123456));}
+};
+
+int main(int argc, char **argv) {
+	return tpie::tests(argc, argv)
+		.test(basic_test, "basic")
+		.test(greater_test, "greater")
+		.test(my_memory_test(), "memory");
+}
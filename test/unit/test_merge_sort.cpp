@@ -22,6 +22,8 @@
 #include <tpie/parallel_sort.h>
 #include <tpie/sysinfo.h>
 #include <random>
+#include <algorithm>
+#include <vector>
 
 using namespace tpie;
 
@@ -158,6 +160,29 @@ bool tall_tree_test(size_t fanout, size_t height) {
 	return true;
 }
 
+bool double_buffering_test() {
+	const memory_size_type items = 3*1024*1024;
+	std::vector<uint64_t> output[2];
+	for (int db = 0; db < 2; ++db) {
+		merge_sorter<uint64_t, false> s;
+		s.set_available_memory(8*1024*1024, 20*1024*1024, 20*1024*1024);
+		s.set_double_buffering(db == 1);
+		std::mt19937 rng(42);
+		relative_memory_usage m(0);
+		s.begin();
+		for (memory_size_type i = 0; i < items; ++i) s.push(rng());
+		if (!m.below(8*1024*1024)) return false;
+		s.end();
+		dummy_progress_indicator pi;
+		s.calc(pi);
+		while (s.can_pull()) output[db].push_back(s.pull());
+	}
+	TEST_ENSURE_EQUALITY(items, output[1].size(), "Wrong number of items");
+	TEST_ENSURE(std::is_sorted(output[1].begin(), output[1].end()), "Output not sorted");
+	TEST_ENSURE(output[0] == output[1], "Double buffered output differs");
+	return true;
+}
+
 int main(int argc, char ** argv) {
 	tests t(argc, argv);
 	return
@@ -166,5 +191,6 @@ int main(int argc, char ** argv) {
 		.test(sort_faulty_upper_bound_test, "sort_faulty_upper_bound")
 		.test(temp_file_usage_test, "temp_file_usage")
 		.test(tall_tree_test, "tall_tree", "fanout", static_cast<size_t>(6), "height", static_cast<size_t>(1))
+		.test(double_buffering_test, "double_buffering")
 		;
 }
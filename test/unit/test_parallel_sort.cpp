@@ -20,6 +20,7 @@
 #include "common.h"
 #include <tpie/parallel_sort.h>
 #include <random>
+#include <cstdint>
 #include <tpie/progress_indicator_arrow.h>
 #include <tpie/dummy_progress.h>
 #include <tpie/memory.h>
@@ -284,6 +285,115 @@ bool large_item_test_chooser(size_t mb, size_t itemSize) {
 	return large_item_test_helper<0, 8>::go(mb, itemSize);
 }
 
+bool sample_sort_test(size_t n) {
+	const adversarial_generator generators[] = {
+		make_random_data, make_equal_elements_data, make_bad_case_data};
+	const char * names[] = {"random", "equal elements", "bad case"};
+	for (size_t g = 0; g < 3; ++g) {
+		std::vector<int> input(n);
+		generators[g](input);
+		std::vector<int> expected = input;
+		std::sort(expected.begin(), expected.end());
+		for (size_t threads = 1; threads <= 8; threads *= 2) {
+			std::vector<int> v = input;
+			test_time start = test_now();
+			tpie::parallel_sort(v.begin(), v.end(), std::less<int>(), threads);
+			test_time end = test_now();
+			tpie::log_info() << names[g] << ", " << threads << " threads: "
+							 << test_millisecs(start, end) << " ms" << std::endl;
+			if (v != expected) {
+				tpie::log_error() << "Sample sort of " << names[g] << " data on "
+								  << threads << " threads is wrong" << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+struct keyed_item {
+	std::uint32_t key;
+	std::uint32_t value;
+};
+
+struct keyed_item_less {
+	bool operator()(const keyed_item & a, const keyed_item & b) const {
+		return a.key < b.key;
+	}
+};
+
+namespace tpie {
+template <>
+struct radix_key<keyed_item, keyed_item_less> {
+	static const bool enabled = true;
+	typedef std::uint32_t key_type;
+	static key_type key(const keyed_item & x) {return x.key;}
+};
+} // namespace tpie
+
+template <typename T>
+void random_fill(std::vector<T> & v, std::mt19937_64 & prng) {
+	for (size_t i = 0; i < v.size(); ++i) v[i] = static_cast<T>(prng());
+}
+
+void random_fill(std::vector<keyed_item> & v, std::mt19937_64 & prng) {
+	for (size_t i = 0; i < v.size(); ++i) {
+		// Few distinct keys, so stability cannot be assumed by the check.
+		v[i].key = static_cast<std::uint32_t>(prng() % 1000);
+		v[i].value = static_cast<std::uint32_t>(i);
+	}
+}
+
+template <typename T, typename comp_t>
+bool radix_case(size_t n, const char * name) {
+	std::mt19937_64 prng(42);
+	std::vector<T> v1(n);
+	random_fill(v1, prng);
+	std::vector<T> v2 = v1;
+
+	test_time start = test_now();
+	std::sort(v1.begin(), v1.end(), comp_t());
+	test_time mid = test_now();
+	// A small job threshold makes even moderate inputs spawn radix jobs.
+	parallel_radix_sort_impl<typename std::vector<T>::iterator, comp_t, 1024> s;
+	s(v2.begin(), v2.end());
+	test_time end = test_now();
+	tpie::log_info() << name << ": std::sort " << test_millisecs(start, mid)
+					 << " ms, radix sort " << test_millisecs(mid, end) << " ms" << std::endl;
+
+	comp_t comp;
+	for (size_t i = 0; i < n; ++i) {
+		if (comp(v1[i], v2[i]) || comp(v2[i], v1[i])) {
+			tpie::log_error() << name << ": radix sort disagrees with std::sort at " << i << std::endl;
+			return false;
+		}
+	}
+
+	std::vector<T> v3(v2.rbegin(), v2.rend());
+	if (!radix_sort_if_possible(v3.begin(), v3.end(), comp)) {
+		tpie::log_error() << name << ": radix sort not selected" << std::endl;
+		return false;
+	}
+	if (!std::is_sorted(v3.begin(), v3.end(), comp)) {
+		tpie::log_error() << name << ": reversed input not sorted" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool radix_test(size_t n) {
+	std::vector<double> d(n);
+	if (radix_sort_if_possible(d.begin(), d.end(), std::less<double>())) {
+		tpie::log_error() << "Radix sort selected for double" << std::endl;
+		return false;
+	}
+	return radix_case<std::uint64_t, std::less<std::uint64_t> >(n, "uint64 less")
+		&& radix_case<std::int64_t, std::less<std::int64_t> >(n, "int64 less")
+		&& radix_case<int, std::greater<int> >(n, "int greater")
+		&& radix_case<std::int16_t, std::less<std::int16_t> >(n, "int16 less")
+		&& radix_case<keyed_item, keyed_item_less>(n, "keyed item");
+}
+
 template <size_t stdsort_limit>
 struct sort_tester {
 	bool operator()(size_t n) {
@@ -304,6 +414,8 @@ int main(int argc, char **argv) {
 #endif
 		.test(adversarial<make_equal_elements_data>(), "equal_elements", "n", 1234567, "seconds", 1.0)
 		.test(bad_case, "bad_case", "n", 1024*1024, "seconds", 1.0)
+		.test(radix_test, "radix", "n", 1024*1024)
+		.test(sample_sort_test, "sample_sort", "n", 1234567)
 		.test(adversarial<make_random_data>(), "general2", "n", 1024*1024, "seconds", 1.0)
 		.test(stress_test, "stress_test")
 		.test(large_item_test_chooser, "large_item", "mb", static_cast<size_t>(2048), "item-size", static_cast<size_t>(32))
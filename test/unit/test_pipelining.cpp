@@ -33,6 +33,7 @@
 #include <tpie/pipelining/split.h>
 #include <tpie/resource_manager.h>
 #include <numeric>
+#include <thread>
 
 using namespace tpie;
 using namespace tpie::pipelining;
@@ -439,6 +440,17 @@ bool sort_test_large() {
 	return sort_test(300*1024);
 }
 
+bool parallel_merge_sort_test() {
+	const size_t elements = 4*1024*1024;
+	bool result = false;
+	pipeline p = sequence_generator(elements, true)
+		| parallel_merge_sort(4)
+		| sequence_verifier(elements, &result);
+	progress_indicator_null pi;
+	p(elements, pi, 20*1024*1024, TPIE_FSI);
+	return result;
+}
+
 // This tests that pipe_middle | pipe_middle -> pipe_middle,
 // and that pipe_middle | pipe_end -> pipe_end.
 // The other tests already test that pipe_begin | pipe_middle -> pipe_middle,
@@ -1374,6 +1386,241 @@ bool parallel_ordered_test(size_t modulo) {
 	return result;
 }
 
+bool parallel_input_test(stream_size_type items) {
+	const open::type schemes[] = {open::defaults, open::compression_all};
+	for (open::type scheme : schemes) {
+		tpie::temp_file input_file;
+		{
+			file_stream<test_t> in;
+			in.open(input_file.path(), scheme);
+			for (stream_size_type i = 0; i < items; ++i) in.write(i);
+		}
+		{
+			std::vector<test_t> out;
+			pipeline p = parallel_input(input_file.path(), maintain_order, 3)
+				| output_vector(out);
+			p();
+			if (out.size() != items) return false;
+			for (stream_size_type i = 0; i < items; ++i)
+				if (out[i] != i) return false;
+		}
+		{
+			std::vector<test_t> out;
+			pipeline p = parallel_input(input_file.path(), arbitrary_order)
+				| parallel(multiply(2), arbitrary_order)
+				| output_vector(out);
+			p();
+			if (out.size() != items) return false;
+			std::sort(out.begin(), out.end());
+			for (stream_size_type i = 0; i < items; ++i)
+				if (out[i] != 2*i) return false;
+		}
+	}
+	return true;
+}
+
+class batch_recorder_type : public node {
+public:
+	typedef test_t item_type;
+
+	batch_recorder_type(std::vector<test_t> & items, size_t & batches)
+		: items(items)
+		, batches(batches)
+	{
+	}
+
+	void push(const test_t & item) {
+		items.push_back(item);
+	}
+
+	void push_batch(array_view<const test_t> batch) {
+		++batches;
+		items.insert(items.end(), batch.begin(), batch.end());
+	}
+
+private:
+	std::vector<test_t> & items;
+	size_t & batches;
+};
+
+typedef pipe_end<termfactory<batch_recorder_type, std::vector<test_t> &, size_t &> > batch_recorder;
+
+bool push_batch_test(stream_size_type n) {
+	tpie::temp_file input_file;
+	{
+		file_stream<test_t> in;
+		in.open(input_file.path());
+		for (stream_size_type i = 0; i < n; ++i) in.write(n - i);
+	}
+	auto check = [n](const std::vector<test_t> & items, size_t batches, bool sorted) {
+		if (items.size() != n) return false;
+		for (stream_size_type i = 0; i < n; ++i)
+			if (items[i] != (sorted ? i + 1 : n - i)) return false;
+		// Every item arrived in a batch, and not one batch per item.
+		return batches > 0 && batches * 1000 < n;
+	};
+
+	{
+		// input() hands whole batches to a node that takes them.
+		std::vector<test_t> items;
+		size_t batches = 0;
+		file_stream<test_t> in;
+		in.open(input_file.path());
+		pipeline p = input(in) | batch_recorder(items, batches);
+		p();
+		if (!check(items, batches, false)) return false;
+	}
+	{
+		// Batches cross a virtual chunk boundary in one virtual call each,
+		// and output() writes them to a stream.
+		tpie::temp_file output_file;
+		std::vector<test_t> items;
+		size_t batches = 0;
+		{
+			file_stream<test_t> in;
+			in.open(input_file.path());
+			file_stream<test_t> out;
+			out.open(output_file.path());
+			pipeline p = virtual_chunk_begin<test_t>(input(in))
+				| virtual_chunk<test_t, test_t>()
+				| virtual_chunk_end<test_t>(fork(output(out)) | batch_recorder(items, batches));
+			p();
+		}
+		if (!check(items, batches, false)) return false;
+		file_stream<test_t> out;
+		out.open(output_file.path());
+		if (out.size() != n) return false;
+		for (stream_size_type i = 0; i < n; ++i)
+			if (out.read() != n - i) return false;
+	}
+	{
+		// The sort takes batches in and pushes batches out.
+		std::vector<test_t> items;
+		size_t batches = 0;
+		file_stream<test_t> in;
+		in.open(input_file.path());
+		pipeline p = input(in) | sort() | batch_recorder(items, batches);
+		p();
+		if (!check(items, batches, true)) return false;
+	}
+	{
+		// A node without push_batch in between gets single items.
+		std::vector<test_t> items;
+		size_t batches = 0;
+		file_stream<test_t> in;
+		in.open(input_file.path());
+		pipeline p = input(in) | multiply(1) | batch_recorder(items, batches);
+		p();
+		if (items.size() != n || batches != 0) return false;
+	}
+	return true;
+}
+
+template <typename dest_t>
+class thread_recorder_type : public node {
+public:
+	typedef typename push_type<dest_t>::type item_type;
+
+	thread_recorder_type(dest_t dest, std::thread::id & id)
+		: dest(std::move(dest))
+		, id(id)
+	{
+		add_push_destination(this->dest);
+	}
+
+	void push(const item_type & item) {
+		id = std::this_thread::get_id();
+		dest.push(item);
+	}
+
+private:
+	dest_t dest;
+	std::thread::id & id;
+};
+
+typedef pipe_middle<factory<thread_recorder_type, std::thread::id &> > thread_recorder;
+
+bool concurrent_phases_test(stream_size_type n) {
+	std::vector<test_t> items;
+	for (stream_size_type i = 0; i < n; ++i) items.push_back(n - i);
+
+	for (bool concurrent : {false, true}) {
+		std::vector<test_t> ascending;
+		std::vector<test_t> descending;
+		std::thread::id ascendingThread;
+		std::thread::id descendingThread;
+		pipeline p = input_vector(items)
+			| fork(sort() | thread_recorder(ascendingThread) | output_vector(ascending))
+			| sort(std::greater<test_t>()) | thread_recorder(descendingThread) | output_vector(descending);
+		p.set_concurrent_phases(concurrent);
+		progress_indicator_null pi;
+		p(n, pi, get_memory_manager().available(), TPIE_FSI);
+
+		if (ascending.size() != n || descending.size() != n) return false;
+		for (stream_size_type i = 0; i < n; ++i) {
+			if (ascending[i] != i + 1 || descending[i] != n - i) {
+				log_error() << "Wrong output with concurrent=" << concurrent << std::endl;
+				return false;
+			}
+		}
+		// The two sort outputs only run on different threads when asked to.
+		if ((ascendingThread != descendingThread) != concurrent) {
+			log_error() << "Sort outputs ran on " << (concurrent ? "the same thread" : "different threads") << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool profile_test(stream_size_type n) {
+	std::vector<test_t> items;
+	for (stream_size_type i = 0; i < n; ++i) items.push_back(n - i);
+	std::vector<test_t> out;
+	pipeline p = input_vector(items) | sort().name("Sort") | output_vector(out);
+	p.set_profiling();
+	p();
+
+	const pipeline_profile & profile = p.get_profile();
+	if (out.size() != n || profile.phases.size() < 2) {
+		log_error() << "Expected at least two phases, got " << profile.phases.size() << std::endl;
+		return false;
+	}
+	stream_size_type maxItems = 0;
+	memory_size_type memoryAssigned = 0;
+	for (const phase_profile & phase : profile.phases) {
+		if (phase.nodes.empty() || phase.wallTime > profile.wallTime) return false;
+		memoryAssigned += phase.memoryAssigned;
+		for (const node_profile & node : phase.nodes) {
+			if (node.name.empty() || node.wallTime > phase.wallTime) return false;
+			maxItems = std::max<stream_size_type>(maxItems, node.items);
+		}
+	}
+	if (maxItems != n) {
+		log_error() << "Expected a node to step " << n << " items, got " << maxItems << std::endl;
+		return false;
+	}
+	if (memoryAssigned == 0 || profile.memory == 0) {
+		log_error() << "No memory recorded" << std::endl;
+		return false;
+	}
+
+	std::stringstream ss;
+	p.print_profile(ss, false);
+	const std::string json = ss.str();
+	log_debug() << json << std::endl;
+	if (json.find("\"phases\": [") == std::string::npos
+		|| json.find("\"name\": \"Sort | ") == std::string::npos
+		|| std::count(json.begin(), json.end(), '{') != std::count(json.begin(), json.end(), '}')) {
+		log_error() << "Unexpected JSON: " << json << std::endl;
+		return false;
+	}
+
+	// Profiling stays off unless asked for.
+	pipeline q = input_vector(items) | output_vector(out);
+	q();
+	return q.get_profile().phases.empty();
+}
+
 template <typename dest_t>
 class Monotonic : public node {
 	dest_t dest;
@@ -2523,6 +2770,7 @@ int main(int argc, char ** argv) {
 	.test(internal_passive_reverse_test, "internal_passive_reverse", "n", static_cast<size_t>(50000))
 	.test(sort_test_trivial, "sorttrivial")
 	.test(sort_test_small, "sort")
+	.test(parallel_merge_sort_test, "parallel_merge_sort")
 	.test(sort_test_large, "sortbig")
 	.test(operator_test, "operators")
 	.test(uniq_test, "uniq")
@@ -2547,6 +2795,10 @@ int main(int argc, char ** argv) {
 	.test(parallel_multiple_test, "parallel_multiple")
 	.test(parallel_own_buffer_test, "parallel_own_buffer")
 	.test(parallel_push_in_end_test, "parallel_push_in_end")
+	.test(parallel_input_test, "parallel_input", "n", static_cast<stream_size_type>(1000000))
+	.test(push_batch_test, "push_batch", "n", static_cast<stream_size_type>(1000000))
+	.test(concurrent_phases_test, "concurrent_phases", "n", static_cast<stream_size_type>(1000000))
+	.test(profile_test, "profile", "n", static_cast<stream_size_type>(1000000))
 	.test(join_test, "join")
 	.test(split_test, "split")
 	.test(subpipeline_test, "subpipeline")
@@ -56,9 +56,163 @@ bool try_open_rw_test() {
 	return true;
 }
 
+// Write blocks of known contents, then read them back sequentially, with a
+// seek, and after overwriting a block that may already be read ahead.
+bool backend_test(file_accessor_backend backend) {
+	const memory_size_type blockSize = 4096;
+	const memory_size_type blocks = 16;
+	file_accessor_backend old = get_file_accessor_backend();
+	set_file_accessor_backend(backend);
+	memory_size_type oldReadAhead = get_io_uring_read_ahead();
+	set_io_uring_read_ahead(3);
+
+	bool ok = true;
+	{
+		temp_file tmp;
+		tpie::default_raw_file_accessor fa;
+		std::vector<memory_size_type> block(blockSize / sizeof(memory_size_type));
+
+		fa.open_rw_new(tmp.path());
+#ifdef TPIE_HAS_IO_URING
+		if (fa.uses_ring() != (backend == backend_io_uring
+							   && file_accessor_backend_available(backend_io_uring))) {
+			log_error() << "Accessor did not pick the selected backend" << std::endl;
+			ok = false;
+		}
+#endif // TPIE_HAS_IO_URING
+		for (memory_size_type i = 0; i < blocks; ++i) {
+			std::fill(block.begin(), block.end(), i);
+			fa.write_i(block.data(), blockSize);
+		}
+
+		fa.seek_i(0);
+		for (memory_size_type i = 0; ok && i < blocks; ++i) {
+			fa.read_i(block.data(), blockSize);
+			if (block.front() != i || block.back() != i) {
+				log_error() << "Sequential read of block " << i << " got " << block.front() << std::endl;
+				ok = false;
+			}
+			if (i == blocks / 2) {
+				// Overwrite the next block while it is being read ahead.
+				std::fill(block.begin(), block.end(), 1000);
+				fa.seek_i((i + 1) * blockSize);
+				fa.write_i(block.data(), blockSize);
+				fa.seek_i((i + 1) * blockSize);
+				fa.read_i(block.data(), blockSize);
+				if (block.front() != 1000) {
+					log_error() << "Read after overwrite got " << block.front() << std::endl;
+					ok = false;
+				}
+				++i;
+			}
+		}
+
+		fa.seek_i(3 * blockSize);
+		fa.read_i(block.data(), blockSize);
+		if (block.front() != 3) {
+			log_error() << "Read after seek got " << block.front() << std::endl;
+			ok = false;
+		}
+
+		try {
+			fa.seek_i(blocks * blockSize);
+			fa.read_i(block.data(), blockSize);
+			log_error() << "Reading past the end did not throw" << std::endl;
+			ok = false;
+		} catch (io_exception &) {
+		}
+		fa.close_i();
+	}
+
+	set_io_uring_read_ahead(oldReadAhead);
+	set_file_accessor_backend(old);
+	return ok;
+}
+
+bool backend_posix_test() {
+	return backend_test(backend_posix);
+}
+
+bool backend_io_uring_test() {
+	if (!file_accessor_backend_available(backend_io_uring)) {
+		log_warning() << "ut-raw_file_accessor: io_uring is not available; "
+					  << "only the posix fallback was tested" << std::endl;
+	}
+	return backend_test(backend_io_uring);
+}
+
+// Mix aligned transfers, which may use direct I/O, with unaligned ones on
+// the same file and check that every read sees the latest write.
+bool direct_io_test() {
+	const memory_size_type alignment = file_accessor::direct_io_alignment;
+	const memory_size_type blocks = 8;
+	const memory_size_type bytes = blocks * alignment;
+	file_accessor_backend old = get_file_accessor_backend();
+	set_file_accessor_backend(backend_posix);
+
+	bool ok = true;
+	char * buffer = tpie_new_aligned_array<char>(bytes + alignment, alignment);
+	{
+		temp_file tmp;
+		tpie::default_raw_file_accessor fa;
+		fa.set_direct_io(true);
+		fa.open_rw_new(tmp.path());
+		log_debug() << "Direct I/O " << (fa.direct_io() ? "enabled" : "not available") << std::endl;
+
+		for (memory_size_type i = 0; i < bytes + alignment; ++i) buffer[i] = static_cast<char>(i % 251);
+		// Aligned blocks followed by an unaligned tail.
+		fa.write_i(buffer, bytes + 100);
+
+		// Unaligned overwrite inside the second block.
+		const char patch[] = "direct";
+		fa.seek_i(alignment + 10);
+		fa.write_i(patch, sizeof(patch));
+		std::copy(patch, patch + sizeof(patch), buffer + alignment + 10);
+
+		std::vector<char> expected(buffer, buffer + bytes + 100);
+		std::fill(buffer, buffer + bytes + alignment, 0);
+
+		fa.seek_i(0);
+		fa.read_i(buffer, bytes + 100);
+		if (!std::equal(expected.begin(), expected.end(), buffer)) {
+			log_error() << "Aligned read returned wrong data" << std::endl;
+			ok = false;
+		}
+
+		// Read into an unaligned buffer at an unaligned offset.
+		std::fill(buffer, buffer + bytes + alignment, 0);
+		fa.seek_i(1);
+		fa.read_i(buffer + 1, bytes);
+		if (!std::equal(expected.begin() + 1, expected.begin() + 1 + bytes, buffer + 1)) {
+			log_error() << "Unaligned read returned wrong data" << std::endl;
+			ok = false;
+		}
+
+		if (fa.file_size_i() != bytes + 100) {
+			log_error() << "Wrong file size " << fa.file_size_i() << std::endl;
+			ok = false;
+		}
+
+		try {
+			fa.seek_i(bytes);
+			fa.read_i(buffer, alignment);
+			log_error() << "Reading past the end did not throw" << std::endl;
+			ok = false;
+		} catch (io_exception &) {
+		}
+		fa.close_i();
+	}
+	tpie_delete_aligned_array(buffer, bytes + alignment);
+	set_file_accessor_backend(old);
+	return ok;
+}
+
 int main(int argc, char ** argv) {
 	return tpie::tests(argc, argv)
 		.test(open_rw_new_test, "open_rw_new")
 		.test(try_open_rw_test, "try_open_rw")
+		.test(backend_posix_test, "backend_posix")
+		.test(backend_io_uring_test, "backend_io_uring")
+		.test(direct_io_test, "direct_io")
 		;
 }
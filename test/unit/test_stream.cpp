@@ -116,6 +116,60 @@ struct file_stream {
 	void open(tpie::temp_file & tf, tpie::access_type a, tpie::memory_size_type uds) { file().open(tf, a, uds); }
 };
 
+// An uncompressed stream that reads ahead and writes behind.
+template <typename T>
+struct buffered_file_stream {
+	tpie::uncompressed_stream<T> m_fs;
+	typedef tpie::uncompressed_stream<T> stream_type;
+
+	buffered_file_stream() {
+		m_fs.set_read_ahead(2);
+		m_fs.set_write_behind(true);
+	}
+
+	tpie::uncompressed_stream<T> & file() {
+		return m_fs;
+	}
+
+	tpie::uncompressed_stream<T> & stream() {
+		return m_fs;
+	}
+
+	inline void close_stream() {
+		m_fs.seek(0);
+	}
+
+	void open(std::string fileName) { file().open(fileName); }
+	void open(tpie::temp_file & tf) { file().open(tf); }
+	void open(tpie::temp_file & tf, tpie::access_type a) { file().open(tf, a); }
+	void open(tpie::temp_file & tf, tpie::access_type a, tpie::memory_size_type uds) { file().open(tf, a, uds); }
+};
+
+// An uncompressed stream accessed with direct I/O, requested on the stream
+// when opened by path and on the temporary file otherwise.
+template <typename T>
+struct direct_file_stream {
+	tpie::uncompressed_stream<T> m_fs;
+	typedef tpie::uncompressed_stream<T> stream_type;
+
+	tpie::uncompressed_stream<T> & file() {
+		return m_fs;
+	}
+
+	tpie::uncompressed_stream<T> & stream() {
+		return m_fs;
+	}
+
+	inline void close_stream() {
+		m_fs.seek(0);
+	}
+
+	void open(std::string fileName) { file().set_direct_io(true); file().open(fileName); }
+	void open(tpie::temp_file & tf) { tf.set_direct_io(true); file().open(tf); }
+	void open(tpie::temp_file & tf, tpie::access_type a) { tf.set_direct_io(true); file().open(tf, a); }
+	void open(tpie::temp_file & tf, tpie::access_type a, tpie::memory_size_type uds) { tf.set_direct_io(true); file().open(tf, a, uds); }
+};
+
 template <typename T>
 struct compressed_stream {
 	tpie::file_stream<T> m_fs;
@@ -794,26 +848,39 @@ int main(int argc, char **argv) {
 		.test(stream_tester<file_stream>::array_test, "array")
 		.test(stream_tester<file_colon_colon_stream>::array_test, "array_file")
 		.test(stream_tester<compressed_stream>::array_test, "array_compressed")
+		.test(stream_tester<buffered_file_stream>::array_test, "array_buffered")
+		.test(stream_tester<direct_file_stream>::array_test, "array_direct")
 		.test(swap_test, "basic")
 		.test(stream_tester<file_stream>::odd_block_test, "odd")
 		.test(stream_tester<file_colon_colon_stream>::odd_block_test, "odd_file")
 		.test(stream_tester<compressed_stream>::odd_block_test, "odd_compressed")
+		.test(stream_tester<buffered_file_stream>::odd_block_test, "odd_buffered")
+		.test(stream_tester<direct_file_stream>::odd_block_test, "odd_direct")
 		.test(stream_tester<file_stream>::truncate_test, "truncate")
 		.test(stream_tester<file_colon_colon_stream>::truncate_test, "truncate_file")
 		.test(stream_tester<compressed_stream>::truncate_test, "truncate_compressed")
+		.test(stream_tester<buffered_file_stream>::truncate_test, "truncate_buffered")
+		.test(stream_tester<direct_file_stream>::truncate_test, "truncate_direct")
 		.test(reopen, "reopen")
 		.test(stream_tester<file_stream>::extend_test, "extend")
 		.test(stream_tester<file_colon_colon_stream>::extend_test, "extend_file")
 		.test(stream_tester<compressed_stream>::extend_test, "extend_compressed")
+		.test(stream_tester<buffered_file_stream>::extend_test, "extend_buffered")
+		.test(stream_tester<direct_file_stream>::extend_test, "extend_direct")
 		.test(stream_tester<file_stream>::backwards_test, "backwards")
 		.test(stream_tester<file_colon_colon_stream>::backwards_test, "backwards_file")
 		.test(stream_tester<compressed_stream>::backwards_test, "backwards_compressed")
+		.test(stream_tester<buffered_file_stream>::backwards_test, "backwards_buffered")
+		.test(stream_tester<direct_file_stream>::backwards_test, "backwards_direct")
 		.test(stream_tester<file_stream>::user_data_test, "user_data")
 		.test(stream_tester<file_colon_colon_stream>::user_data_test, "user_data_file")
 		.test(stream_tester<compressed_stream>::user_data_test, "user_data_compressed")
+		.test(stream_tester<buffered_file_stream>::user_data_test, "user_data_buffered")
+		.test(stream_tester<direct_file_stream>::user_data_test, "user_data_direct")
 		.test(stream_tester<file_stream>::stress_test, "stress", "actions", static_cast<tpie::stream_size_type>(1024*1024*10), "maxsize", static_cast<size_t>(1024*1024*128))
 		.test(stream_tester<file_colon_colon_stream>::stress_test, "stress_file", "actions", static_cast<tpie::stream_size_type>(1024*1024*10), "maxsize", static_cast<size_t>(1024*1024*128))
 		.test(stream_tester<compressed_stream>::stress_test, "stress_compressed", "actions", static_cast<tpie::stream_size_type>(1024*1024*10), "maxsize", static_cast<size_t>(1024*1024*128))
+		.test(stream_tester<buffered_file_stream>::stress_test, "stress_buffered", "actions", static_cast<tpie::stream_size_type>(1024*1024*10), "maxsize", static_cast<size_t>(1024*1024*128))
 		.test(stream_tester<file_stream>::user_data_test, "user_data")
 		.test(stream_tester<file_colon_colon_stream>::user_data_test, "user_data_file")
 		.test(peek_skip_test_1, "peek_skip_1")
@@ -70,6 +70,10 @@ void block_collection::read_block(block_handle handle, block & b) {
 	m_accessor.read_i(static_cast<void*>(b.get()), handle.size);
 }
 
+void block_collection::prefetch_block(block_handle handle) {
+	m_accessor.prefetch_i(handle.position, handle.size);
+}
+
 void block_collection::write_block(block_handle handle, const block & b) {
 	tp_assert(m_writeable, "write_block(): the block collection is read only.");
 	tp_assert(handle.size >= b.size(), "the given block is not large enough.");
@@ -75,6 +75,13 @@ public:
 	 * \param b the block type in which the content is stored
 	 */
 	void write_block(block_handle handle, const block & b);
+
+	/**
+	 * \brief Hint that the given block will be read soon, so that reading
+	 * it from disk can start in the background
+	 * \param handle the handle of the block
+	 */
+	void prefetch_block(block_handle handle);
 private:
 	bits::freespace_collection m_collection;
 	tpie::file_accessor::raw_file_accessor m_accessor;
@@ -18,111 +18,264 @@
 // along with TPIE.  If not, see <http://www.gnu.org/licenses/>
 
 #include <tpie/blocks/block_collection_cache.h>
+#include <algorithm>
+#include <cstring>
 
 namespace tpie {
 
 namespace blocks {
 
+namespace {
+
+memory_size_type index_size(memory_size_type maxSize) {
+	memory_size_type size = 1;
+	while (size < 2 * maxSize) size *= 2;
+	return size;
+}
+
+} // unnamed namespace
+
 block_collection_cache::block_collection_cache(std::string fileName, memory_size_type blockSize, memory_size_type maxSize, bool writeable)
 	: m_collection(fileName, blockSize, writeable)
 	, m_curSize(0)
-	, m_maxSize(maxSize)
+	, m_maxSize(std::max(maxSize, min_capacity()))
+	, m_pinnedCount(0)
 	, m_blockSize(blockSize)
-{}
+{
+	allocate();
+}
 
 block_collection_cache::~block_collection_cache() {
 	// write the content of the cache to disk
-	block_map_t::iterator end = m_blockMap.end();
+	clear();
+}
 
-	for(block_map_t::iterator i = m_blockMap.begin(); i != end; ++i) {
-		if(i->second.dirty) {
-			m_collection.write_block(i->first, *i->second.pointer);
-		}
-		tpie_delete(i->second.pointer);
-	}
+memory_size_type block_collection_cache::capacity_for_memory(memory_size_type memory, memory_size_type blockSize) {
+	// Start from an upper bound that ignores the hash table.
+	memory_size_type perBlock = sizeof(block) + blockSize + sizeof(entry) + sizeof(memory_size_type);
+	memory_size_type maxSize = memory / perBlock;
+	while (maxSize > min_capacity() && memory_usage(maxSize, blockSize) > memory) --maxSize;
+	return std::max(maxSize, min_capacity());
 }
 
-block_handle block_collection_cache::get_free_block() {
-	block_handle h = m_collection.get_free_block();
-	block * cache_b = tpie_new<block>(m_blockSize);
-	prepare_cache();
-	add_to_cache(h, cache_b, true);
-	return h;
+memory_size_type block_collection_cache::memory_usage(memory_size_type maxSize, memory_size_type blockSize) {
+	maxSize = std::max(maxSize, min_capacity());
+	return sizeof(block_collection_cache)
+		+ maxSize * (sizeof(block) + blockSize + sizeof(entry) + sizeof(memory_size_type))
+		+ index_size(maxSize) * sizeof(memory_size_type);
 }
 
-void block_collection_cache::free_block(block_handle handle) {
-	tp_assert(handle.size == m_blockSize, "the size of the handle is not correct")
-	tp_assert(m_curSize > 0, "the current size of the cache is 0");
+memory_size_type block_collection_cache::pinned_memory_usage(memory_size_type count, memory_size_type blockSize) {
+	return count * (sizeof(block) + blockSize + sizeof(entry) + 2 * sizeof(memory_size_type));
+}
 
-	block_map_t::iterator i = m_blockMap.find(handle);
+void block_collection_cache::set_capacity(memory_size_type maxSize) {
+	std::vector<block_handle> pinned;
+	for (memory_size_type i = m_maxSize; i < m_entries.size(); ++i)
+		if (m_entries[i].pointer != 0 && find(m_entries[i].handle) == i)
+			pinned.push_back(m_entries[i].handle);
+	clear();
+	m_maxSize = std::max(maxSize, min_capacity());
+	m_pinnedCount = pinned.size();
+	allocate();
+	load_pinned(pinned);
+}
 
-	if(i != m_blockMap.end()) {
-		m_blockList.erase(i->second.iterator);
-		tpie_delete(i->second.pointer);
-		--m_curSize;
-		m_blockMap.erase(i);
+void block_collection_cache::set_pinned(const std::vector<block_handle> & handles) {
+	clear();
+	m_pinnedCount = handles.size();
+	allocate();
+	load_pinned(handles);
+}
+
+void block_collection_cache::load_pinned(const std::vector<block_handle> & handles) {
+	for (memory_size_type i = 0; i < handles.size(); ++i) {
+		const memory_size_type slot = m_maxSize + i;
+		entry & e = m_entries[slot];
+		e.pointer = tpie_new<block>();
+		m_collection.read_block(handles[i], *e.pointer);
+		e.handle = handles[i];
+		insert_index(slot);
 	}
+}
 
-	m_collection.free_block(handle);
+void block_collection_cache::allocate() {
+	m_entries.resize(0);
+	m_entries.resize(m_maxSize + m_pinnedCount);
+	const memory_size_type indexSize = index_size(m_maxSize + m_pinnedCount);
+	m_index.resize(0);
+	m_index.resize(indexSize, 0);
+	m_indexShift = 64;
+	for (memory_size_type i = indexSize; i > 1; i /= 2) --m_indexShift;
+	m_freeSlots.resize(m_maxSize);
+	for (memory_size_type i = 0; i < m_maxSize; ++i)
+		m_freeSlots[i] = m_maxSize - 1 - i;
+	m_freeCount = m_maxSize;
+	std::fill(m_recent, m_recent + recentCount, m_maxSize);
+	m_recentNext = 0;
+	m_hand = 0;
+	m_curSize = 0;
 }
 
-void block_collection_cache::prepare_cache() {
-	if(m_curSize < m_maxSize)
-		return;
+void block_collection_cache::clear() {
+	for (memory_size_type i = 0; i < m_entries.size(); ++i) {
+		entry & e = m_entries[i];
+		if (e.pointer == 0) continue;
+		if (e.dirty) m_collection.write_block(e.handle, *e.pointer);
+		tpie_delete(e.pointer);
+		e.pointer = 0;
+	}
+	m_curSize = 0;
+}
 
-	// write the last accessed block to disk
-	block_handle handle = m_blockList.front();
-	m_blockList.pop_front();
+memory_size_type block_collection_cache::hash(stream_size_type position) const {
+	// Fibonacci hashing: the top bits of the product are well mixed.
+	uint64_t h = static_cast<uint64_t>(position) * 0x9E3779B97F4A7C15ull;
+	return m_indexShift == 64 ? 0 : static_cast<memory_size_type>(h >> m_indexShift);
+}
 
-	block_map_t::iterator i = m_blockMap.find(handle);
-	if(i->second.dirty)
-		m_collection.write_block(i->first, *(i->second.pointer));
-	tpie_delete(i->second.pointer);
-	--m_curSize;
-	m_blockMap.erase(i);
+memory_size_type block_collection_cache::find(block_handle handle) const {
+	const memory_size_type mask = m_index.size() - 1;
+	for (memory_size_type i = hash(handle.position); m_index[i] != 0; i = (i + 1) & mask) {
+		memory_size_type slot = m_index[i] - 1;
+		if (m_entries[slot].handle.position == handle.position) return slot;
+	}
+	return notFound;
 }
 
-void block_collection_cache::add_to_cache(block_handle handle, block * b, bool dirty) {
-	tp_assert(m_curSize < m_maxSize, "must not be full");
+void block_collection_cache::insert_index(memory_size_type slot) {
+	const memory_size_type mask = m_index.size() - 1;
+	memory_size_type i = hash(m_entries[slot].handle.position);
+	while (m_index[i] != 0) i = (i + 1) & mask;
+	m_index[i] = slot + 1;
+}
 
-	m_blockList.push_back(handle);
-	block_list_t::iterator list_pos = m_blockList.end();
-	--list_pos;
+void block_collection_cache::erase_index(memory_size_type slot) {
+	const memory_size_type mask = m_index.size() - 1;
+	memory_size_type i = hash(m_entries[slot].handle.position);
+	while (m_index[i] != slot + 1) i = (i + 1) & mask;
 
-	m_blockMap[handle] = block_information_t(b, list_pos, dirty);
+	// Shift later members of the probe sequence back into the hole, so
+	// that lookups never need tombstones.
+	memory_size_type j = i;
+	while (true) {
+		j = (j + 1) & mask;
+		if (m_index[j] == 0) break;
+		memory_size_type k = hash(m_entries[m_index[j] - 1].handle.position);
+		// Leave the bucket alone if its home k lies cyclically in (i, j].
+		bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+		if (stays) continue;
+		m_index[i] = m_index[j];
+		i = j;
+	}
+	m_index[i] = 0;
+}
+
+memory_size_type block_collection_cache::take_slot() {
+	if (m_freeCount > 0) return m_freeSlots[--m_freeCount];
+
+	while (true) {
+		memory_size_type slot = m_hand;
+		m_hand = (m_hand + 1) % m_maxSize;
+		entry & e = m_entries[slot];
+		if (std::find(m_recent, m_recent + recentCount, slot) != m_recent + recentCount)
+			continue;
+		if (e.referenced) {
+			e.referenced = false;
+			continue;
+		}
+		// write the evicted block to disk
+		if (e.dirty) m_collection.write_block(e.handle, *e.pointer);
+		e.dirty = false;
+		erase_index(slot);
+		--m_curSize;
+		return slot;
+	}
+}
+
+void block_collection_cache::used(memory_size_type slot) {
+	m_entries[slot].referenced = true;
+	if (std::find(m_recent, m_recent + recentCount, slot) != m_recent + recentCount)
+		return;
+	m_recent[m_recentNext] = slot;
+	m_recentNext = (m_recentNext + 1) % recentCount;
+}
+
+block_handle block_collection_cache::get_free_block() {
+	block_handle h = m_collection.get_free_block();
+	memory_size_type slot = take_slot();
+	entry & e = m_entries[slot];
+	if (e.pointer == 0) e.pointer = tpie_new<block>(m_blockSize);
+	else std::memset(e.pointer->get(), 0, e.pointer->size());
+	e.handle = h;
+	e.dirty = true;
+	insert_index(slot);
 	++m_curSize;
+	used(slot);
+	return h;
 }
 
-void block_collection_cache::used(block_information_t& item) {
-	// Move the item's list node to the end.
-	m_blockList.splice(m_blockList.end(), m_blockList, item.iterator);
+void block_collection_cache::free_block(block_handle handle) {
+	tp_assert(handle.size == m_blockSize, "the size of the handle is not correct")
+
+	memory_size_type slot = find(handle);
+
+	if (slot != notFound) {
+		// Keep the block buffer for reuse by the slot.
+		entry & e = m_entries[slot];
+		erase_index(slot);
+		e.dirty = false;
+		e.referenced = false;
+		std::replace(m_recent, m_recent + recentCount, slot, m_maxSize);
+		if (slot < m_maxSize) {
+			m_freeSlots[m_freeCount++] = slot;
+			--m_curSize;
+		}
+	}
+
+	m_collection.free_block(handle);
 }
 
 block * block_collection_cache::read_block(block_handle handle) {
-	block_map_t::iterator i = m_blockMap.find(handle);
+	memory_size_type slot = find(handle);
 
-	if(i != m_blockMap.end()) { // the block is already in the cache
-		used(i->second);
-		return i->second.pointer;
+	if (slot != notFound) { // the block is already in the cache
+		used(slot);
+		return m_entries[slot].pointer;
 	}
 
 	// the block isn't in the cache
-	prepare_cache(); // make space in the cache for the new block
+	slot = take_slot(); // make space in the cache for the new block
+
+	entry & e = m_entries[slot];
+	if (e.pointer == 0) e.pointer = tpie_new<block>();
+	try {
+		m_collection.read_block(handle, *e.pointer);
+	} catch (...) {
+		m_freeSlots[m_freeCount++] = slot;
+		throw;
+	}
+	e.handle = handle;
+	e.dirty = false;
+	e.referenced = false;
+	insert_index(slot);
+	++m_curSize;
+	used(slot);
 
-	block * cache_b = tpie_new<block>();
-	m_collection.read_block(handle, *cache_b);
-	add_to_cache(handle, cache_b, false);
+	return e.pointer;
+}
 
-	return cache_b;
+void block_collection_cache::prefetch_block(block_handle handle) {
+	if (find(handle) == notFound) m_collection.prefetch_block(handle);
 }
 
 void block_collection_cache::write_block(block_handle handle) {
-	block_map_t::iterator i = m_blockMap.find(handle);
+	memory_size_type slot = find(handle);
 
-	tp_assert(i != m_blockMap.end(), "the given handle does not exist in the cache.");
+	tp_assert(slot != notFound, "the given handle does not exist in the cache.");
 
-	used(i->second);
-	i->second.dirty = true;
+	used(slot);
+	m_entries[slot].dirty = true;
 }
 
 } // namespace blocks
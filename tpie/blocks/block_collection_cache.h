@@ -26,11 +26,12 @@
 
 #include <tpie/tpie.h>
 #include <tpie/tpie_assert.h>
+#include <tpie/array.h>
 #include <tpie/file_accessor/file_accessor.h>
 #include <tpie/blocks/block.h>
 #include <tpie/blocks/block_collection.h>
-#include <list>
-#include <map>
+#include <limits>
+#include <vector>
 
 namespace tpie {
 
@@ -38,45 +39,96 @@ namespace blocks {
 
 /**
  * \brief A class to manage writing and reading of block to disk. 
- * Blocks are stored in an internal cache with a static size.
+ * Blocks are stored in an internal cache holding a fixed number of blocks.
+ *
+ * Cached blocks are found through an open-addressed hash table on the block
+ * position, and evicted with the CLOCK algorithm: every access sets a
+ * reference bit, and the clock hand evicts the first block whose bit is
+ * already clear, clearing bits as it passes. A hit therefore neither
+ * allocates nor reorders anything. The blocks returned by the last few
+ * calls to read_block are never evicted, so callers may hold on to the
+ * pointers of two blocks while working on them.
  */
 class block_collection_cache {
 private:
-	struct position_comparator {
-		bool operator()(const block_handle & a, const block_handle & b) const {
-			return a.position < b.position;
-		}
-	};
-
-	typedef std::list<block_handle> block_list_t;
-
-	struct block_information_t {
-		block_information_t() {}
-
-		block_information_t(block * pointer, block_list_t::iterator iterator, bool dirty)
-			: pointer(pointer)
-			, iterator(iterator)
-			, dirty(dirty)
-		{}
+	struct entry {
+		entry() : pointer(0), dirty(false), referenced(false) {}
 
+		block_handle handle;
 		block * pointer;
-		block_list_t::iterator iterator;
 		bool dirty;
+		bool referenced;
 	};
 
-	typedef std::map<block_handle, block_information_t, position_comparator> block_map_t;
+	/** Number of most recently read blocks that are never evicted. */
+	static const memory_size_type recentCount = 3;
+
+	/** Returned by find() for blocks that are not cached. */
+	static const memory_size_type notFound = std::numeric_limits<memory_size_type>::max();
+
 public:
 	/**
 	 * \brief Create a block collection
 	 * \param fileName the file in which blocks are saved
 	 * \param blockSize the size of blocks constructed
 	 * \param writeable indicates whether the collection is writeable
-	 * \param maxSize the size of the cache given in number of blocks
+	 * \param maxSize the size of the cache given in number of blocks. At
+	 * least min_capacity() blocks are always cached.
 	 */
 	block_collection_cache(std::string fileName, memory_size_type blockSize, memory_size_type maxSize, bool writeable);
 
 	~block_collection_cache();
 
+	block_collection_cache(const block_collection_cache &) = delete;
+	block_collection_cache & operator=(const block_collection_cache &) = delete;
+
+	/**
+	 * \brief The smallest number of blocks the cache will hold.
+	 */
+	static constexpr memory_size_type min_capacity() {return recentCount + 1;}
+
+	/**
+	 * \brief The number of blocks a cache may hold within the given amount
+	 * of memory, but at least min_capacity().
+	 */
+	static memory_size_type capacity_for_memory(memory_size_type memory, memory_size_type blockSize);
+
+	/**
+	 * \brief The memory used by a full cache of the given number of blocks,
+	 * including its bookkeeping.
+	 */
+	static memory_size_type memory_usage(memory_size_type maxSize, memory_size_type blockSize);
+
+	/**
+	 * \brief The memory used by the given number of pinned blocks.
+	 */
+	static memory_size_type pinned_memory_usage(memory_size_type count, memory_size_type blockSize);
+
+	/**
+	 * \brief The number of blocks the cache holds when full, not counting
+	 * pinned blocks.
+	 */
+	memory_size_type capacity() const {return m_maxSize;}
+
+	/**
+	 * \brief Change the number of blocks the cache may hold. All cached
+	 * blocks are written back and dropped, so pointers previously returned
+	 * by read_block are invalidated. Pinned blocks stay pinned.
+	 */
+	void set_capacity(memory_size_type maxSize);
+
+	/**
+	 * \brief Keep the given blocks in memory, in addition to the capacity
+	 * of the cache, until set_pinned is called again or they are freed.
+	 * Replaces any previously pinned blocks. All cached blocks are written
+	 * back and dropped before the given blocks are read.
+	 */
+	void set_pinned(const std::vector<block_handle> & handles);
+
+	/**
+	 * \brief The number of blocks passed to the last call to set_pinned.
+	 */
+	memory_size_type pinned_count() const {return m_pinnedCount;}
 
 	/**
 	 * \brief Allocates a new block
@@ -90,16 +142,6 @@ public:
 	 */
 	void free_block(block_handle handle);
 
-private:
-	// make space for a new block in the cache
-	void prepare_cache();
-
-	void add_to_cache(block_handle handle, block * b, bool dirty);
-
-	// Register that item is now the most recently used one.
-	void used(block_information_t& item);
-
-public:
 	/**
 	 * \brief Reads the content of a block from disk
 	 * \param handle the handle of the block to read
@@ -114,12 +156,52 @@ public:
 	 */
 	void write_block(block_handle handle);
 
+	/**
+	 * \brief Hint that the given block will be read soon. Does nothing if
+	 * the block is cached.
+	 * \param handle the handle of the block
+	 */
+	void prefetch_block(block_handle handle);
+
 private:
+	// Allocate the slots and the hash table for the current capacity.
+	void allocate();
+
+	// Write back and delete all cached blocks.
+	void clear();
+
+	memory_size_type hash(stream_size_type position) const;
+
+	// Read the given blocks into the pinned slots.
+	void load_pinned(const std::vector<block_handle> & handles);
+
+	// Return the slot caching the given block, or notFound.
+	memory_size_type find(block_handle handle) const;
+
+	void insert_index(memory_size_type slot);
+	void erase_index(memory_size_type slot);
+
+	// Return an empty slot, evicting a block if the cache is full.
+	memory_size_type take_slot();
+
+	// Register that the block in the given slot was just used.
+	void used(memory_size_type slot);
+
 	block_collection m_collection;
-	block_list_t m_blockList;
-	block_map_t m_blockMap;
+	array<entry> m_entries;
+	// Slot number plus one of the block hashed to each bucket, or zero.
+	array<memory_size_type> m_index;
+	array<memory_size_type> m_freeSlots;
+	memory_size_type m_freeCount;
+	memory_size_type m_recent[recentCount];
+	memory_size_type m_recentNext;
+	memory_size_type m_hand;
+	memory_size_type m_indexShift;
 	memory_size_type m_curSize;
+	// Slots [0, m_maxSize) are evictable; the m_pinnedCount slots after
+	// them hold pinned blocks.
 	memory_size_type m_maxSize;
+	memory_size_type m_pinnedCount;
 	memory_size_type m_blockSize;
 };
 
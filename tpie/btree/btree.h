@@ -23,7 +23,9 @@
 #include <tpie/portability.h>
 #include <tpie/btree/base.h>
 #include <tpie/btree/node.h>
+#include <tpie/btree/key_search.h>
 #include <tpie/memory.h>
+#include <algorithm>
 #include <cstddef>
 #include <vector>
 
@@ -42,6 +44,7 @@ public:
 	static const bool is_internal = state_type::is_internal;
 	static const bool is_static = state_type::is_static;
 	static const bool is_ordered = state_type::is_ordered;
+	static const bool is_serialized = state_type::is_serialized;
 	
 	typedef typename state_type::augmenter_type augmenter_type;
 
@@ -99,6 +102,72 @@ private:
 		return m_state.store().get_child_leaf(node, i);
 	}
 
+	/**
+	 * Arithmetic keys compared with < are searched with key_rank, which
+	 * reads the keys of a node in place instead of calling the comparator
+	 * on one key at a time.
+	 */
+	template <typename K>
+	using fast_search = std::integral_constant<bool,
+		bbits::key_search_enabled<key_type, comp_type>::value
+		&& std::is_same<typename std::decay<K>::type, key_type>::value>;
+
+	template <typename K>
+	using fast_leaf_search = std::integral_constant<bool,
+		fast_search<K>::value
+		&& std::is_same<keyextract_type, identity_key>::value
+		&& std::is_same<value_type, key_type>::value>;
+
+	/**
+	 * Return the index of the child of n to descend into when searching for k
+	 */
+	template <bool upper_bound, typename K>
+	size_t child_index(internal_type n, const K & k, std::false_type) const {
+		const size_t z = m_state.store().count(n);
+		for (size_t j=0; ; ++j) {
+			if (j+1 == z ||
+				(upper_bound
+				 ? m_comp(k, m_state.min_key(n, j+1))
+				 : !m_comp(m_state.min_key(n, j+1), k)))
+				return j;
+		}
+	}
+
+	template <bool upper_bound, typename K>
+	size_t child_index(internal_type n, const K & k, std::true_type) const {
+		typedef typename state_type::key_augment key_augment;
+		const size_t z = m_state.store().count(n);
+		const size_t stride = store_type::augment_stride();
+		const char * first = reinterpret_cast<const char *>(
+			&static_cast<const key_augment *>(&m_state.store().augment(n, 0))->key);
+		// Child j is the first one whose successor does not come before k.
+		return bbits::key_rank<upper_bound>(
+			reinterpret_cast<const key_type *>(first + stride), stride, z-1, key_type(k));
+	}
+
+	/**
+	 * Return the number of items in l that are less than k, or not
+	 * greater than k if upper_bound is set
+	 */
+	template <bool upper_bound, typename K>
+	size_t leaf_index(leaf_type l, const K & k, std::false_type) const {
+		const size_t z = m_state.store().count(l);
+		for (size_t i = 0 ; i < z ; ++i) {
+			if (upper_bound
+				? m_comp(k, m_state.min_key(l, i))
+				: !m_comp(m_state.min_key(l, i), k))
+				return i;
+		}
+		return z;
+	}
+
+	template <bool upper_bound, typename K>
+	size_t leaf_index(leaf_type l, const K & k, std::true_type) const {
+		const size_t z = m_state.store().count(l);
+		return bbits::key_rank<upper_bound>(
+			&m_state.store().get(l, 0), sizeof(value_type), z, key_type(k));
+	}
+
 	template <bool upper_bound = false, typename K>
 	leaf_type find_leaf(std::vector<internal_type> & path, K k) const {
 		path.clear();
@@ -106,16 +175,9 @@ private:
 		internal_type n = m_state.store().get_root_internal();
 		for (size_t i=2;; ++i) {
 			path.push_back(n);
-			for (size_t j=0; ; ++j) {
- 				if (j+1 == m_state.store().count(n) ||
-					(upper_bound
-					 ? m_comp(k, m_state.min_key(n, j+1))
-					 : !m_comp(m_state.min_key(n, j+1), k))) {
-					if (i == m_state.store().height()) return m_state.store().get_child_leaf(n, j);
-					n = m_state.store().get_child_internal(n, j);
-					break;
-				}
-			}
+			size_t j = child_index<upper_bound>(n, k, fast_search<K>());
+			if (i == m_state.store().height()) return m_state.store().get_child_leaf(n, j);
+			n = m_state.store().get_child_internal(n, j);
 		}
 	}
 
@@ -387,16 +449,10 @@ public:
 		std::vector<internal_type> path;
 		leaf_type l = find_leaf<true>(path, v);
 	
-		size_t i=0;
-		size_t z = m_state.store().count(l);
-		while (true) {
-			if (i == z) {
-				itr.goto_end();
-				return itr;
-			}
-			if (!m_comp(m_state.min_key(l, i), v) &&
-				!m_comp(v, m_state.min_key(l, i))) break;
-			++i;
+		size_t i = leaf_index<false>(l, v, fast_leaf_search<K>());
+		if (i == m_state.store().count(l) || m_comp(v, m_state.min_key(l, i))) {
+			itr.goto_end();
+			return itr;
 		}
 		itr.goto_item(path, l, i);
 		return itr;
@@ -418,11 +474,10 @@ public:
 		leaf_type l = find_leaf(path, v);
 		
 		const size_t z = m_state.store().count(l);
-		for (size_t i = 0 ; i < z ; ++i) {
-			if (!m_comp(m_state.min_key(l, i), v)) {
-				itr.goto_item(path, l, i);
-				return itr;
-			}
+		const size_t i = leaf_index<false>(l, v, fast_leaf_search<K>());
+		if (i < z) {
+			itr.goto_item(path, l, i);
+			return itr;
 		}
 		itr.goto_item(path, l, z-1);
 		return ++itr;
@@ -444,16 +499,189 @@ public:
 		leaf_type l = find_leaf<true>(path, v);
 		
 		const size_t z = m_state.store().count(l);
-		for (size_t i = 0 ; i < z ; ++i) {
-			if (m_comp(v, m_state.min_key(l, i))) {
-				itr.goto_item(path, l, i);
-				return itr;
-			}
+		const size_t i = leaf_index<true>(l, v, fast_leaf_search<K>());
+		if (i < z) {
+			itr.goto_item(path, l, i);
+			return itr;
 		}
 		itr.goto_item(path, l, z-1);
 		return ++itr;
 	}
 
+	/**
+	 * \brief Looks up a sequence of keys one at a time. Each lookup descends
+	 * from the deepest node of the previous root-to-leaf path that still
+	 * covers the key, rather than from the root, and on an external tree the
+	 * following leaves under the same parent are prefetched.
+	 *
+	 * Keys are looked up fastest in sorted order, but any order gives the
+	 * same results as the corresponding methods on the tree. The tree must
+	 * not be modified while the cursor is in use.
+	 */
+	class lookup_cursor {
+	public:
+		explicit lookup_cursor(const tree & t): m_tree(&t), m_prefetched(0) {}
+
+		/**
+		 * \brief Return an iterator to the first item with the given key,
+		 * or end() if there is none
+		 */
+		template <typename K>
+		iterator find(K v) {
+			return m_tree->cursor_find(*this, v);
+		}
+
+		/**
+		 * \brief Return an iterator to the first item that is "not less"
+		 * than the given key
+		 */
+		template <typename K>
+		iterator lower_bound(K v) {
+			return m_tree->cursor_lower_bound(*this, v);
+		}
+
+		/**
+		 * \brief Forget the current path, for instance after the tree has
+		 * been modified
+		 */
+		void reset() {
+			m_path.clear();
+			m_index.clear();
+		}
+
+	private:
+		const tree * m_tree;
+		std::vector<internal_type> m_path;
+		std::vector<size_t> m_index;
+		leaf_type m_leaf;
+		// Children of m_path.back() before this index have been prefetched
+		size_t m_prefetched;
+
+		friend class tree;
+	};
+
+	/**
+	 * \brief Look up each key in [first, last) as find() would, and write
+	 * the resulting iterators to out. The keys should be sorted.
+	 *
+	 * \returns the end of the output range
+	 */
+	template <typename IT, typename OIT, typename X=enab>
+	OIT find_many(IT first, IT last, OIT out, enable<X, is_ordered> =enab()) const {
+		lookup_cursor c(*this);
+		for (; first != last; ++first) *out++ = c.find(*first);
+		return out;
+	}
+
+	/**
+	 * \brief Look up each key in [first, last) as lower_bound() would, and
+	 * write the resulting iterators to out. The keys should be sorted.
+	 *
+	 * \returns the end of the output range
+	 */
+	template <typename IT, typename OIT, typename X=enab>
+	OIT lower_bound_many(IT first, IT last, OIT out, enable<X, is_ordered> =enab()) const {
+		lookup_cursor c(*this);
+		for (; first != last; ++first) *out++ = c.lower_bound(*first);
+		return out;
+	}
+
+private:
+	/**
+	 * Number of leaves after the current one that a lookup_cursor prefetches
+	 */
+	static const size_t cursor_prefetch_leaves = 4;
+
+	/**
+	 * Find the leaf where lower_bound would look for k, starting from the
+	 * path of the cursor
+	 */
+	template <typename K>
+	leaf_type cursor_find_leaf(lookup_cursor & c, K k) const {
+		const size_t height = m_state.store().height();
+		if (height == 1) {
+			c.reset();
+			return m_state.store().get_root_leaf();
+		}
+
+		if (c.m_path.size() + 1 == height) {
+			// The position of k is in the current leaf if a key before it
+			// and a key after it are both there.
+			const size_t i = leaf_index<false>(c.m_leaf, k, fast_leaf_search<K>());
+			if (i > 0 && i < m_state.store().count(c.m_leaf)) return c.m_leaf;
+
+			// Likewise, keep the deepest node that has children with keys
+			// on both sides of k, or the root.
+			size_t level = c.m_path.size();
+			while (true) {
+				internal_type n = c.m_path[level-1];
+				size_t j = child_index<false>(n, k, fast_search<K>());
+				if (level == 1 || (j > 0 && j+1 < m_state.store().count(n))) {
+					c.m_path.resize(level);
+					c.m_index.resize(level);
+					if (level + 1 < height) c.m_prefetched = 0;
+					c.m_index.back() = j;
+					break;
+				}
+				--level;
+			}
+		} else {
+			c.m_path.assign(1, m_state.store().get_root_internal());
+			c.m_index.assign(1, child_index<false>(c.m_path[0], k, fast_search<K>()));
+			c.m_prefetched = 0;
+		}
+
+		while (c.m_path.size() + 1 < height) {
+			internal_type n = m_state.store().get_child_internal(c.m_path.back(), c.m_index.back());
+			c.m_path.push_back(n);
+			c.m_index.push_back(child_index<false>(n, k, fast_search<K>()));
+		}
+
+		internal_type p = c.m_path.back();
+		const size_t j = c.m_index.back();
+		const size_t first = std::max(c.m_prefetched, j+1);
+		const size_t last = std::min(m_state.store().count(p), j + 1 + cursor_prefetch_leaves);
+		if (first < last) {
+			m_state.store().prefetch_child_leaves(p, first, last);
+			c.m_prefetched = last;
+		}
+		c.m_leaf = m_state.store().get_child_leaf(p, j);
+		return c.m_leaf;
+	}
+
+	template <typename K>
+	iterator cursor_lower_bound(lookup_cursor & c, K v) const {
+		iterator itr(&m_state);
+		if (m_state.store().height() == 0) {
+			itr.goto_end();
+			return itr;
+		}
+
+		leaf_type l = cursor_find_leaf(c, v);
+
+		const size_t z = m_state.store().count(l);
+		const size_t i = leaf_index<false>(l, v, fast_leaf_search<K>());
+		if (i < z) {
+			itr.goto_item(c.m_path, l, i);
+			return itr;
+		}
+		itr.goto_item(c.m_path, l, z-1);
+		return ++itr;
+	}
+
+	template <typename K>
+	iterator cursor_find(lookup_cursor & c, K v) const {
+		iterator itr = cursor_lower_bound(c, v);
+		if (m_state.store().height() == 0) return itr;
+		// An iterator past the last item of its leaf is the end iterator.
+		if (itr.m_index < m_state.store().count(itr.m_leaf) &&
+			m_comp(v, m_state.min_key(*itr)))
+			itr.goto_end();
+		return itr;
+	}
+
+public:
+
 	/**
 	 * \brief remove item at iterator
 	 */
@@ -598,6 +826,37 @@ public:
 		m_state(store_type(path), std::move(augmenter), keyextract_type()),
 		m_comp(comp) {}
 
+	/**
+	 * Construct an external btree with the given storage, caching at most
+	 * cacheMemory bytes of blocks in memory
+	 */
+	template <typename X=enab>
+	tree(std::string path, memory_size_type cacheMemory, comp_type comp=comp_type(), augmenter_type augmenter=augmenter_type(), enable<X, !is_internal && !is_serialized> =enab() ): 
+		m_state(store_type(path, btree_flags::defaults, cacheMemory), std::move(augmenter), keyextract_type()),
+		m_comp(comp) {}
+
+	/**
+	 * \brief Change the amount of memory used to cache blocks of an
+	 * external btree. The cached blocks are written back and dropped.
+	 */
+	template <typename X=enab>
+	void set_cache_memory(memory_size_type cacheMemory, enable<X, !is_internal && !is_serialized> =enab()) {
+		m_state.store().set_cache_memory(cacheMemory);
+	}
+
+	/**
+	 * \brief Keep up to the given number of levels from the root down in
+	 * memory, pinning only whole levels that fit in the given memory.
+	 * A lookup then reads at most height() minus the returned number of
+	 * nodes from disk.
+	 *
+	 * \returns the number of levels pinned.
+	 */
+	template <typename X=enab>
+	memory_size_type pin_levels(memory_size_type levels, memory_size_type memory, enable<X, !is_internal> =enab()) {
+		return m_state.store().pin_levels(levels, memory);
+	}
+
 	/**
 	 * Construct a btree with the given storage
 	 */
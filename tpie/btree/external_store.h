@@ -26,6 +26,7 @@
 #include <tpie/blocks/block_collection_cache.h>
 #include <tpie/btree/external_store_base.h>
 #include <memory>
+#include <vector>
 
 #include <cstddef>
 
@@ -58,8 +59,15 @@ public:
 
 	typedef size_t size_type;
 
-	static constexpr memory_size_type cacheSize() {return 32;}
 	static constexpr memory_size_type blockSize() {return bs?bs:7000;}
+
+	/**
+	 * \brief Memory used for caching blocks unless otherwise requested:
+	 * enough for 32 blocks.
+	 */
+	static memory_size_type default_cache_memory() {
+		return blocks::block_collection_cache::memory_usage(32, blockSize());
+	}
 	
 	struct internal_content {
 		blocks::block_handle handle;
@@ -110,12 +118,15 @@ public:
 
 	/**
 	 * \brief Construct a new empty btree storage
+	 * \param cacheMemory the memory used to cache blocks. The cache always
+	 * holds a few blocks, even if this is less than their size.
 	 */
-	explicit external_store(const std::string & path, btree_flags /*flags*/=btree_flags::defaults)
+	explicit external_store(const std::string & path, btree_flags /*flags*/=btree_flags::defaults,
+							memory_size_type cacheMemory=default_cache_memory())
 	: external_store_base(path)
 		{
 			m_collection = std::make_shared<blocks::block_collection_cache>(
-				path, blockSize(), cacheSize(), true);
+				path, blockSize(), cache_capacity(cacheMemory), true);
 		}
 			
 	external_store(external_store&& other) noexcept = default;
@@ -366,6 +377,25 @@ public:
 
 		return nodeInter.values[i].augment;
 	}
+
+	/**
+	 * \brief Distance in bytes between the augments of consecutive children
+	 */
+	static constexpr size_t augment_stride() {
+		return sizeof(internal_content);
+	}
+
+	/**
+	 * \brief Hint that children [first, last) of node, which are leaves,
+	 * will be read soon, so their blocks are read from disk in the background
+	 */
+	void prefetch_child_leaves(internal_type node, size_t first, size_t last) const {
+		blocks::block * nodeBlock = m_collection->read_block(node.handle);
+		internal nodeInter(nodeBlock);
+
+		for (size_t i = first; i < last; ++i)
+			m_collection->prefetch_block(nodeInter.values[i].handle);
+	}
 	
 	size_t height() const throw() {
 		return m_height;
@@ -385,6 +415,58 @@ public:
 	
 	void flush() {}
 	void finalize_build() {}
+
+	/**
+	 * \brief Change the memory used to cache blocks. The cached blocks are
+	 * written back and dropped.
+	 */
+	void set_cache_memory(memory_size_type cacheMemory) {
+		m_collection->set_capacity(cache_capacity(cacheMemory));
+	}
+
+	/**
+	 * \brief Return the memory used by the block cache when it is full.
+	 */
+	memory_size_type cache_memory() const {
+		return blocks::block_collection_cache::memory_usage(m_collection->capacity(), blockSize());
+	}
+
+	/**
+	 * \brief Keep the nodes of the top levels of the tree in memory, in
+	 * addition to the block cache.
+	 *
+	 * Whole levels are pinned from the root down, until the given number of
+	 * levels is reached or the next level does not fit in the given memory.
+	 * A lookup then reads at most height() minus the returned number of
+	 * nodes from disk. Nodes created after the call are cached normally, so
+	 * pin the levels again after modifying the tree heavily.
+	 *
+	 * \returns the number of levels pinned.
+	 */
+	memory_size_type pin_levels(memory_size_type levels, memory_size_type memory) {
+		std::vector<blocks::block_handle> pinned;
+		std::vector<blocks::block_handle> level;
+		if (m_height > 0) level.push_back(m_root);
+		memory_size_type depth = 0;
+		while (depth < levels && depth < m_height) {
+			if (blocks::block_collection_cache::pinned_memory_usage(
+					pinned.size() + level.size(), blockSize()) > memory)
+				break;
+			pinned.insert(pinned.end(), level.begin(), level.end());
+			++depth;
+			if (depth == m_height) break;
+			std::vector<blocks::block_handle> next;
+			for (size_t j = 0; j < level.size(); ++j) {
+				internal_type node(level[j]);
+				size_t c = count(node);
+				for (size_t i = 0; i < c; ++i)
+					next.push_back(get_child_internal(node, i).handle);
+			}
+			level.swap(next);
+		}
+		m_collection->set_pinned(pinned);
+		return depth;
+	}
 	
 	void set_metadata(const std::string & /*data*/) {
 		throw exception("Not yet implemnted.");
@@ -394,6 +476,10 @@ public:
 		throw exception("Not yet implemnted.");
 	}
 
+	static memory_size_type cache_capacity(memory_size_type cacheMemory) {
+		return blocks::block_collection_cache::capacity_for_memory(cacheMemory, blockSize());
+	}
+
 	std::shared_ptr<blocks::block_collection_cache> m_collection;
 
 	template <typename>
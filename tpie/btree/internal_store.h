@@ -244,6 +244,19 @@ private:
 	const augment_type & augment(internal_type p, size_t i) const {
 		return p->values[i].augment;
 	}
+
+	/**
+	 * \brief Distance in bytes between the augments of consecutive children
+	 */
+	static constexpr size_t augment_stride() {
+		return sizeof(internal_content);
+	}
+
+	/**
+	 * \brief Hint that children [first, last) of node, which are leaves,
+	 * will be read soon
+	 */
+	void prefetch_child_leaves(internal_type, size_t, size_t) const {}
 	
 	size_t height() const throw() {
 		return m_height;
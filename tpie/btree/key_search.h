@@ -0,0 +1,264 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024 The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef _TPIE_BTREE_KEY_SEARCH_H_
+#define _TPIE_BTREE_KEY_SEARCH_H_
+
+#include <tpie/btree/base.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TPIE_BTREE_SSE2
+#endif
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace tpie {
+namespace bbits {
+
+/**
+ * \brief True if keys of type K ordered by C can be searched without
+ * calling the comparator, that is, K is arithmetic and C is its < operator.
+ */
+template <typename K, typename C>
+struct key_search_enabled : std::integral_constant<bool,
+	std::is_arithmetic<K>::value
+	&& (std::is_same<C, default_comp>::value || std::is_same<C, std::less<K> >::value)> {};
+
+namespace key_search_bits {
+
+/**
+ * Below this many keys the remaining range is scanned instead of halved.
+ */
+static const size_t contiguous_scan = 32;
+static const size_t strided_scan = 8;
+
+template <typename K>
+inline const K & at(const K * keys, size_t stride, size_t i) {
+	return *reinterpret_cast<const K *>(reinterpret_cast<const char *>(keys) + i * stride);
+}
+
+/**
+ * \brief Count the keys for which a < b, where a is the key and b is k,
+ * or the other way around if swap is set. Branch free, so the compiler may
+ * vectorize it for contiguous keys.
+ */
+template <bool swap, typename K>
+inline size_t count_lt_scalar(const K * keys, size_t stride, size_t n, K k) {
+	size_t c = 0;
+	for (size_t i = 0; i < n; ++i) {
+		const K x = at(keys, stride, i);
+		c += swap ? (k < x) : (x < k);
+	}
+	return c;
+}
+
+template <bool swap, typename K>
+inline size_t count_lt(const K * keys, size_t n, K k) {
+	return count_lt_scalar<swap>(keys, sizeof(K), n, k);
+}
+
+#ifdef TPIE_BTREE_SSE2
+
+// Sum the 32-bit lanes of a vector of negated comparison masks.
+inline size_t sum_epi32(__m128i acc) {
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return static_cast<uint32_t>(_mm_cvtsi128_si32(acc));
+}
+
+inline size_t sum_epi64(__m128i acc) {
+	acc = _mm_add_epi64(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	uint64_t r;
+	_mm_storel_epi64(reinterpret_cast<__m128i *>(&r), acc);
+	return static_cast<size_t>(r);
+}
+
+#ifdef __AVX2__
+inline size_t sum_epi32(__m256i acc) {
+	return sum_epi32(_mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+}
+
+inline size_t sum_epi64(__m256i acc) {
+	return sum_epi64(_mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+}
+#endif
+
+template <bool swap>
+inline size_t count_lt(const int32_t * keys, size_t n, int32_t k) {
+	size_t i = 0;
+	size_t c = 0;
+#ifdef __AVX2__
+	{
+		const __m256i kv = _mm256_set1_epi32(k);
+		__m256i acc = _mm256_setzero_si256();
+		for (; i + 8 <= n; i += 8) {
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+			acc = _mm256_sub_epi32(acc, swap ? _mm256_cmpgt_epi32(x, kv) : _mm256_cmpgt_epi32(kv, x));
+		}
+		c += sum_epi32(acc);
+	}
+#endif
+	const __m128i kv = _mm_set1_epi32(k);
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+		acc = _mm_sub_epi32(acc, swap ? _mm_cmpgt_epi32(x, kv) : _mm_cmpgt_epi32(kv, x));
+	}
+	c += sum_epi32(acc);
+	return c + count_lt_scalar<swap>(keys + i, sizeof(int32_t), n - i, k);
+}
+
+template <bool swap>
+inline size_t count_lt(const float * keys, size_t n, float k) {
+	size_t i = 0;
+	size_t c = 0;
+#ifdef __AVX2__
+	{
+		const __m256 kv = _mm256_set1_ps(k);
+		__m256i acc = _mm256_setzero_si256();
+		for (; i + 8 <= n; i += 8) {
+			__m256 x = _mm256_loadu_ps(keys + i);
+			__m256 m = swap ? _mm256_cmp_ps(kv, x, _CMP_LT_OQ) : _mm256_cmp_ps(x, kv, _CMP_LT_OQ);
+			acc = _mm256_sub_epi32(acc, _mm256_castps_si256(m));
+		}
+		c += sum_epi32(acc);
+	}
+#endif
+	const __m128 kv = _mm_set1_ps(k);
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_loadu_ps(keys + i);
+		__m128 m = swap ? _mm_cmplt_ps(kv, x) : _mm_cmplt_ps(x, kv);
+		acc = _mm_sub_epi32(acc, _mm_castps_si128(m));
+	}
+	c += sum_epi32(acc);
+	return c + count_lt_scalar<swap>(keys + i, sizeof(float), n - i, k);
+}
+
+template <bool swap>
+inline size_t count_lt(const double * keys, size_t n, double k) {
+	size_t i = 0;
+	size_t c = 0;
+#ifdef __AVX2__
+	{
+		const __m256d kv = _mm256_set1_pd(k);
+		__m256i acc = _mm256_setzero_si256();
+		for (; i + 4 <= n; i += 4) {
+			__m256d x = _mm256_loadu_pd(keys + i);
+			__m256d m = swap ? _mm256_cmp_pd(kv, x, _CMP_LT_OQ) : _mm256_cmp_pd(x, kv, _CMP_LT_OQ);
+			acc = _mm256_sub_epi64(acc, _mm256_castpd_si256(m));
+		}
+		c += sum_epi64(acc);
+	}
+#endif
+	const __m128d kv = _mm_set1_pd(k);
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 2 <= n; i += 2) {
+		__m128d x = _mm_loadu_pd(keys + i);
+		__m128d m = swap ? _mm_cmplt_pd(kv, x) : _mm_cmplt_pd(x, kv);
+		acc = _mm_sub_epi64(acc, _mm_castpd_si128(m));
+	}
+	c += sum_epi64(acc);
+	return c + count_lt_scalar<swap>(keys + i, sizeof(double), n - i, k);
+}
+
+#ifdef __SSE4_2__
+template <bool swap>
+inline size_t count_lt(const int64_t * keys, size_t n, int64_t k) {
+	size_t i = 0;
+	size_t c = 0;
+#ifdef __AVX2__
+	{
+		const __m256i kv = _mm256_set1_epi64x(k);
+		__m256i acc = _mm256_setzero_si256();
+		for (; i + 4 <= n; i += 4) {
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+			acc = _mm256_sub_epi64(acc, swap ? _mm256_cmpgt_epi64(x, kv) : _mm256_cmpgt_epi64(kv, x));
+		}
+		c += sum_epi64(acc);
+	}
+#endif
+	const __m128i kv = _mm_set1_epi64x(k);
+	__m128i acc = _mm_setzero_si128();
+	for (; i + 2 <= n; i += 2) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+		acc = _mm_sub_epi64(acc, swap ? _mm_cmpgt_epi64(x, kv) : _mm_cmpgt_epi64(kv, x));
+	}
+	c += sum_epi64(acc);
+	return c + count_lt_scalar<swap>(keys + i, sizeof(int64_t), n - i, k);
+}
+#endif
+
+#endif // TPIE_BTREE_SSE2
+
+/**
+ * \brief Count the keys before the position of k in a sorted range that has
+ * at most a few keys: the keys less than k, or not greater if upper is set.
+ */
+template <bool upper, typename K>
+inline size_t scan(const K * keys, size_t stride, size_t n, K k) {
+	if (stride == sizeof(K)) {
+		return upper ? n - count_lt<true>(keys, n, k) : count_lt<false>(keys, n, k);
+	}
+	return upper
+		? n - count_lt_scalar<true>(keys, stride, n, k)
+		: count_lt_scalar<false>(keys, stride, n, k);
+}
+
+} //namespace key_search_bits
+
+/**
+ * \brief Return the number of keys that come before k in a sorted range:
+ * the keys less than k, or if upper is set, the keys not greater than k.
+ *
+ * The range is halved without branches until it is short enough to be
+ * scanned with SIMD comparisons (for contiguous keys) or a branch free
+ * loop.
+ *
+ * \param keys the first key
+ * \param stride the distance in bytes between consecutive keys
+ * \param n the number of keys
+ */
+template <bool upper, typename K>
+inline size_t key_rank(const K * keys, size_t stride, size_t n, K k) {
+	using namespace key_search_bits;
+	const size_t limit = stride == sizeof(K) ? contiguous_scan : strided_scan;
+	size_t lo = 0;
+	while (n > limit) {
+		const size_t half = n / 2;
+		const K & x = at(keys, stride, lo + half);
+		const bool before = upper ? !(k < x) : (x < k);
+		lo = before ? lo + half + 1 : lo;
+		n = before ? n - half - 1 : half;
+	}
+	return lo + scan<upper>(&at(keys, stride, lo), stride, n, k);
+}
+
+} //namespace bbits
+} //namespace tpie
+#endif /*_TPIE_BTREE_KEY_SEARCH_H_*/
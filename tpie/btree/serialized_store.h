@@ -24,8 +24,12 @@
 #include <tpie/btree/base.h>
 #include <tpie/tpie_assert.h>
 #include <tpie/serialization2.h>
+#include <tpie/memory.h>
 #include <cstddef>
 #include <fstream>
+#include <functional>
+#include <unordered_map>
+#include <vector>
 
 #ifdef TPIE_HAS_LZ4
 #include <lz4.h>
@@ -283,6 +287,12 @@ private:
 			ptr->my_offset = offset;
 		}
 
+		template <typename Alloc>
+		leaf_type(off_t offset, const Alloc & a) {
+			ptr = std::allocate_shared<leaf>(a);
+			ptr->my_offset = offset;
+		}
+
 		leaf & operator*() const noexcept {
 			return *ptr;
 		}
@@ -485,8 +495,12 @@ private:
 	}
 
 	internal_type get_child_internal(internal_type node, size_t i) const {
-		internal_type child = std::make_shared<internal>();
 		assert(i < node->count);
+		if (!m_pinnedInternal.empty()) {
+			auto it = m_pinnedInternal.find(node->values[i].offset);
+			if (it != m_pinnedInternal.end()) return it->second;
+		}
+		internal_type child = std::make_shared<internal>();
 		child->my_offset = node->values[i].offset;
 		f->seekg(child->my_offset);
 		unserialize(*f, *child);
@@ -494,13 +508,95 @@ private:
 	}
 
 	leaf_type get_child_leaf(internal_type node, size_t i) const {
-		leaf_type child = leaf_type(node->values[i].offset);
 		assert(i < node->count);
+		if (!m_pinnedLeaves.empty()) {
+			auto it = m_pinnedLeaves.find(node->values[i].offset);
+			if (it != m_pinnedLeaves.end()) return it->second;
+		}
+		leaf_type child = leaf_type(node->values[i].offset);
+		f->seekg(child->my_offset);
+		unserialize(*f, *child);
+		return child;
+	}
+
+	/**
+	 * \brief Read a child to be pinned. Unlike get_child_internal and
+	 * get_child_leaf, the node is allocated through the TPIE memory manager,
+	 * since it stays in memory.
+	 */
+	internal_type read_pinned_internal(internal_type node, size_t i) const {
+		internal_type child = std::allocate_shared<internal>(allocator<internal>());
+		child->my_offset = node->values[i].offset;
+		f->seekg(child->my_offset);
+		unserialize(*f, *child);
+		return child;
+	}
+
+	leaf_type read_pinned_leaf(internal_type node, size_t i) const {
+		leaf_type child(node->values[i].offset, allocator<leaf>());
 		f->seekg(child->my_offset);
 		unserialize(*f, *child);
 		return child;
 	}
 
+	/**
+	 * \brief Memory used by a pinned node, including its index entry.
+	 */
+	template <typename N>
+	static constexpr memory_size_type pinned_node_memory() {
+		return sizeof(N) + sizeof(off_t) + 8 * sizeof(void *);
+	}
+
+	/**
+	 * \brief Keep the nodes of the top levels of the tree in memory, so
+	 * they are not read and unserialized on every access.
+	 *
+	 * Whole levels are pinned from the root down, until the given number of
+	 * levels is reached or the next level does not fit in the given memory.
+	 * The root is always in memory and does not count against the memory.
+	 * A lookup then reads at most height() minus the returned number of
+	 * nodes from disk.
+	 *
+	 * \returns the number of levels pinned.
+	 */
+	memory_size_type pin_levels(memory_size_type levels, memory_size_type memory) {
+		m_pinnedInternal.clear();
+		m_pinnedLeaves.clear();
+		if (m_height == 0 || levels == 0) return 0;
+		if (m_height == 1) return 1;
+
+		std::vector<internal_type> level(1, root_internal);
+		memory_size_type used = 0;
+		memory_size_type depth = 1;
+		while (depth < levels && depth < m_height) {
+			const bool leaves = depth + 1 == m_height;
+			memory_size_type children = 0;
+			for (size_t j = 0; j < level.size(); ++j) children += level[j]->count;
+			const memory_size_type cost = children * (leaves
+				? pinned_node_memory<leaf>()
+				: pinned_node_memory<internal>());
+			if (used + cost > memory) break;
+			used += cost;
+
+			std::vector<internal_type> next;
+			for (size_t j = 0; j < level.size(); ++j) {
+				for (size_t i = 0; i < level[j]->count; ++i) {
+					if (leaves) {
+						leaf_type l = read_pinned_leaf(level[j], i);
+						m_pinnedLeaves[l->my_offset] = l;
+					} else {
+						internal_type n = read_pinned_internal(level[j], i);
+						m_pinnedInternal[n->my_offset] = n;
+						next.push_back(n);
+					}
+				}
+			}
+			level.swap(next);
+			++depth;
+		}
+		return depth;
+	}
+
 	size_t index(off_t my_offset, internal_type node) const {
 		for (size_t i=0; i < node->count; ++i)
 			if (node->values[i].offset == my_offset) return i;
@@ -529,6 +625,19 @@ private:
 	const augment_type & augment(internal_type p, size_t i) const {
 		return p->values[i].augment;
 	}
+
+	/**
+	 * \brief Distance in bytes between the augments of consecutive children
+	 */
+	static constexpr size_t augment_stride() {
+		return sizeof(internal_content);
+	}
+
+	/**
+	 * \brief Hint that children [first, last) of node, which are leaves,
+	 * will be read soon
+	 */
+	void prefetch_child_leaves(internal_type, size_t, size_t) const {}
 	
 	size_t height() const throw() {
 		return m_height;
@@ -615,6 +724,11 @@ private:
 	std::unique_ptr<std::fstream> f;
 	internal_type current_internal, root_internal;
 	leaf_type current_leaf, root_leaf;
+	template <typename N>
+	using pinned_map = std::unordered_map<off_t, N, std::hash<off_t>, std::equal_to<off_t>,
+										  allocator<std::pair<const off_t, N> > >;
+	pinned_map<internal_type> m_pinnedInternal;
+	pinned_map<leaf_type> m_pinnedLeaves;
 
 	template <typename>
 	friend class ::tpie::btree_node;
@@ -24,6 +24,7 @@
 /// \file compressed/request.h  Compressor thread requests and responses.
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <memory>
 #include <thread>
 #include <condition_variable>
@@ -33,6 +34,7 @@
 #include <tpie/file_accessor/byte_stream_accessor.h>
 #include <tpie/compressed/predeclare.h>
 #include <tpie/compressed/direction.h>
+#include <tpie/compressed/scheme.h>
 
 namespace tpie {
 
@@ -58,6 +60,10 @@ public:
 		, m_endOfStream(false)
 		, m_nextReadOffset(0)
 		, m_nextBlockSize(0)
+		, m_worker(std::numeric_limits<memory_size_type>::max())
+		, m_requestedBlocks(0)
+		, m_adaptiveSkip(0)
+		, m_adaptiveInterval(0)
 	{
 	}
 
@@ -153,6 +159,77 @@ public:
 		m_changed.notify_all();
 	}
 
+	// any, thread -- must have lock!
+	// The compressor worker serving this stream, or max() if none is assigned.
+	memory_size_type get_worker() const {
+		return m_worker;
+	}
+
+	// any, thread -- must have lock!
+	void set_worker(memory_size_type worker) {
+		m_worker = worker;
+	}
+
+	// write, stream
+	void reset_statistics() {
+		m_statistics = compression_statistics();
+		m_requestedBlocks = 0;
+		m_adaptiveSkip = m_adaptiveInterval = 0;
+	}
+
+	// write, stream -- must have lock!
+	// Called for each compressed write request.
+	void block_requested() {
+		++m_requestedBlocks;
+	}
+
+	// write, stream
+	// Waits until all requested blocks have been recorded.
+	const compression_statistics & get_statistics(compressor_thread_lock & lock) {
+		while (m_statistics.compressedBlocks + m_statistics.uncompressedBlocks
+			   < m_requestedBlocks)
+			wait(lock);
+		return m_statistics;
+	}
+
+	// write, thread -- must have lock!
+	void record_block(bool compressed, memory_size_type inputBytes,
+					  memory_size_type outputBytes, stream_size_type microseconds)
+	{
+		if (compressed) ++m_statistics.compressedBlocks;
+		else ++m_statistics.uncompressedBlocks;
+		m_statistics.inputBytes += inputBytes;
+		m_statistics.outputBytes += outputBytes;
+		m_statistics.compressionMicroseconds += microseconds;
+		m_changed.notify_all();
+	}
+
+	// write, thread
+	// In compression_adaptive mode: Whether the next block should be
+	// compressed to probe whether compression pays off.
+	bool adaptive_should_compress() {
+		if (m_adaptiveSkip == 0) return true;
+		--m_adaptiveSkip;
+		return false;
+	}
+
+	// write, thread
+	// In compression_adaptive mode: Record whether compressing the last
+	// block paid off. If not, skip compression for a number of blocks that
+	// doubles with every consecutive failed probe.
+	void adaptive_record_probe(bool paidOff, memory_size_type minInterval,
+							   memory_size_type maxInterval)
+	{
+		if (paidOff) {
+			m_adaptiveInterval = 0;
+		} else {
+			m_adaptiveInterval =
+				(m_adaptiveInterval == 0) ? minInterval
+				: std::min(maxInterval, 2 * m_adaptiveInterval);
+		}
+		m_adaptiveSkip = m_adaptiveInterval;
+	}
+
 private:
 	std::condition_variable m_changed;
 
@@ -168,6 +245,16 @@ private:
 	bool m_endOfStream;
 	stream_size_type m_nextReadOffset;
 	memory_size_type m_nextBlockSize;
+
+	// Information about the compressor worker
+	memory_size_type m_worker;
+
+	// Information about the compression of written blocks
+	compression_statistics m_statistics;
+	stream_size_type m_requestedBlocks;
+	// Only accessed by the compressor worker serving the stream.
+	memory_size_type m_adaptiveSkip;
+	memory_size_type m_adaptiveInterval;
 };
 
 #ifdef __GNUC__
@@ -194,6 +281,10 @@ public:
 		m_response->initiate_request();
 	}
 
+	compressor_response & get_response() {
+		return *m_response;
+	}
+
 protected:
 	compressor_response * m_response;
 };
@@ -255,6 +346,7 @@ public:
 				  stream_size_type writeOffset,
 				  memory_size_type blockItems,
 				  stream_size_type blockNumber,
+				  compression_scheme::type compressionScheme,
 				  compressor_response * response)
 		: request_base(response)
 		, m_buffer(buffer)
@@ -263,6 +355,7 @@ public:
 		, m_writeOffset(writeOffset)
 		, m_blockItems(blockItems)
 		, m_blockNumber(blockNumber)
+		, m_compressionScheme(compressionScheme)
 	{
 	}
 
@@ -290,6 +383,13 @@ public:
 		return m_writeOffset;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  The compression scheme preferred by the stream for this block.
+	///////////////////////////////////////////////////////////////////////////
+	compression_scheme::type get_compression_scheme() {
+		return m_compressionScheme;
+	}
+
 	// must have lock!
 	void set_block_info(stream_size_type readOffset,
 						memory_size_type blockSize)
@@ -316,6 +416,7 @@ private:
 	const stream_size_type m_writeOffset;
 	const memory_size_type m_blockItems;
 	const stream_size_type m_blockNumber;
+	const compression_scheme::type m_compressionScheme;
 };
 
 class compressor_request_kind {
@@ -393,13 +494,15 @@ public:
 									  stream_size_type writeOffset,
 									  memory_size_type blockItems,
 									  stream_size_type blockNumber,
+									  compression_scheme::type compressionScheme,
 									  compressor_response * response)
 	{
 		destruct();
 		m_kind = compressor_request_kind::WRITE;
 		return *new (m_payload) write_request(buffer, fileAccessor, tempFile,
 											  writeOffset, blockItems,
-											  blockNumber, response);
+											  blockNumber, compressionScheme,
+											  response);
 	}
 
 	write_request & set_write_request(const write_request & other) {
@@ -0,0 +1,88 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2013, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+
+#include <mutex>
+#include <sstream>
+#include <tpie/config.h>
+#include <tpie/exception.h>
+#include <tpie/compressed/scheme.h>
+
+namespace {
+
+std::mutex registered_schemes_mutex;
+const tpie::compression_scheme * registered_schemes[tpie::compression_scheme::max_type + 1];
+
+const tpie::compression_scheme * get_registered_scheme(tpie::compression_scheme::type t) {
+	if (t < tpie::compression_scheme::user_defined || t > tpie::compression_scheme::max_type)
+		return nullptr;
+	std::lock_guard<std::mutex> lock(registered_schemes_mutex);
+	return registered_schemes[t];
+}
+
+} // unnamed namespace
+
+namespace tpie {
+
+void register_compression_scheme(compression_scheme::type t, const compression_scheme & scheme) {
+	if (t < compression_scheme::user_defined || t > compression_scheme::max_type) {
+		std::stringstream ss;
+		ss << "register_compression_scheme: Type " << static_cast<int>(t)
+		   << " is reserved for built-in compression schemes";
+		throw invalid_argument_exception(ss.str());
+	}
+	std::lock_guard<std::mutex> lock(registered_schemes_mutex);
+	registered_schemes[t] = &scheme;
+}
+
+bool is_compression_scheme_known(compression_scheme::type t) {
+	switch (t) {
+		case compression_scheme::none:
+		case compression_scheme::snappy:
+		case compression_scheme::lz4:
+		case compression_scheme::zstd:
+			return true;
+		default:
+			return get_registered_scheme(t) != nullptr;
+	}
+}
+
+const compression_scheme & get_compression_scheme(compression_scheme::type t) {
+	switch (t) {
+		case compression_scheme::none:
+			return get_compression_scheme_none();
+		case compression_scheme::snappy:
+			return get_compression_scheme_snappy();
+		case compression_scheme::lz4:
+			return get_compression_scheme_lz4();
+		case compression_scheme::zstd:
+			return get_compression_scheme_zstd();
+		default:
+			break;
+	}
+	const compression_scheme * scheme = get_registered_scheme(t);
+	if (scheme == nullptr) {
+		std::stringstream ss;
+		ss << "get_compression_scheme: Unknown compression scheme " << static_cast<int>(t);
+		throw stream_exception(ss.str());
+	}
+	return *scheme;
+}
+
+} // namespace tpie
@@ -24,6 +24,8 @@
 /// \file compressed/scheme.h  Compression scheme virtual interface.
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <tpie/types.h>
+
 namespace tpie {
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -39,19 +41,57 @@ enum compression_flags {
 	 * according to available resources (time, memory). */
 	compression_normal = 1,
 	/** Compress all blocks according to the preferred compression scheme
-	 * which can be set using
-	 * tpie::the_compressor_thread().set_preferred_compression(). */
-	compression_all = 2
+	 * which can be set for a single stream using
+	 * compressed_stream_base::set_preferred_compression(), or for all
+	 * streams using tpie::the_compressor_thread().set_preferred_compression(). */
+	compression_all = 2,
+	/** Compress blocks with the preferred compression scheme as long as it
+	 * pays off. When a block does not shrink enough, the following blocks
+	 * are stored uncompressed, and compression is retried after a while. */
+	compression_adaptive = 3
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Counters of the work done compressing the blocks of a stream.
+///////////////////////////////////////////////////////////////////////////////
+struct compression_statistics {
+	/** Number of blocks stored with a compression scheme. */
+	stream_size_type compressedBlocks = 0;
+	/** Number of blocks stored uncompressed. */
+	stream_size_type uncompressedBlocks = 0;
+	/** Total size of the blocks before compression. */
+	stream_size_type inputBytes = 0;
+	/** Total size of the blocks as stored, excluding block headers. */
+	stream_size_type outputBytes = 0;
+	/** Time spent compressing, in microseconds. */
+	stream_size_type compressionMicroseconds = 0;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Number of bytes compression has saved on disk.
+	///////////////////////////////////////////////////////////////////////////
+	stream_size_type bytes_saved() const {
+		return inputBytes > outputBytes ? inputBytes - outputBytes : 0;
+	}
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief  Abstract virtual base class for each compression scheme.
+///
+/// The type of the scheme used to compress a block is stored in the block
+/// header, so a single stream may contain blocks compressed with different
+/// schemes.
 ///////////////////////////////////////////////////////////////////////////////
 class compression_scheme {
 public:
 	enum type {
 		none = 0,
-		snappy = 1
+		snappy = 1,
+		lz4 = 2,
+		zstd = 3,
+		/** First type available to register_compression_scheme(). */
+		user_defined = 128,
+		/** Largest type that fits in a block header. */
+		max_type = 255
 	};
 
 	///////////////////////////////////////////////////////////////////////////
@@ -85,16 +125,30 @@ protected:
 
 const compression_scheme & get_compression_scheme_none();
 const compression_scheme & get_compression_scheme_snappy();
+const compression_scheme & get_compression_scheme_lz4();
+const compression_scheme & get_compression_scheme_zstd();
 
-inline const compression_scheme & get_compression_scheme(compression_scheme::type t) {
-	switch (t) {
-		case compression_scheme::none:
-			return get_compression_scheme_none();
-		case compression_scheme::snappy:
-			return get_compression_scheme_snappy();
-	}
-	return get_compression_scheme_none();
-}
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Make a user-defined compression scheme available to streams.
+///
+/// The scheme must outlive every stream that reads or writes blocks with the
+/// given type. The type must be in the range [user_defined, max_type], and
+/// the same type must be used for the scheme every time the program runs,
+/// since it is recorded in the header of each compressed block.
+///////////////////////////////////////////////////////////////////////////////
+void register_compression_scheme(compression_scheme::type t, const compression_scheme & scheme);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Check whether \c t is a built-in or registered compression scheme.
+///////////////////////////////////////////////////////////////////////////////
+bool is_compression_scheme_known(compression_scheme::type t);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Get the compression scheme of the given type.
+///
+/// Throws a stream_exception if the type is neither built in nor registered.
+///////////////////////////////////////////////////////////////////////////////
+const compression_scheme & get_compression_scheme(compression_scheme::type t);
 
 }
 
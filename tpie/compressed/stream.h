@@ -29,8 +29,12 @@
 #include <tpie/tempname.h>
 #include <tpie/file_base_crtp.h>
 #include <tpie/file_stream_base.h>
+#include <tpie/compressed/scheme.h>
 #include <tpie/compressed/stream_position.h>
 #include <tpie/stream_writable.h>
+#include <algorithm>
+#include <iterator>
+#include <vector>
 
 namespace tpie {
 
@@ -54,6 +58,9 @@ struct open {
 		 * which can be set using
 		 * tpie::the_compressor_thread().set_preferred_compression(). */
 		compression_all = 00000040,
+		/** Compress blocks as long as it pays off; see
+		 * tpie::compression_adaptive. */
+		compression_adaptive = 00000100,
 
 		defaults = 0
 	};
@@ -154,6 +161,33 @@ public:
 
 	const std::string & path() const;
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Set the compression scheme used for blocks written by this
+	/// stream from now on.
+	///
+	/// By default, the stream uses the preferred compression scheme of
+	/// tpie::the_compressor_thread(). Blocks already written keep their
+	/// scheme, since it is recorded in each block header. Has no effect
+	/// if the stream was opened without compression.
+	///////////////////////////////////////////////////////////////////////////
+	void set_preferred_compression(compression_scheme::type scheme);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Get the compression scheme used for blocks written by this
+	/// stream.
+	///////////////////////////////////////////////////////////////////////////
+	compression_scheme::type get_preferred_compression();
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Get counters of the compression work done for the blocks
+	/// written since the stream was opened.
+	///
+	/// Blocks to take the compressor lock, and waits for blocks that are
+	/// still being written. The block currently being filled is not counted
+	/// until it is flushed.
+	///////////////////////////////////////////////////////////////////////////
+	compression_statistics get_compression_statistics();
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Deprecated interface for opening a named stream.
 	///
@@ -234,9 +268,16 @@ public:
 	/// open::compression_all
 	///     Create the stream in compression mode if it does not already exist,
 	///     and compress all written blocks using the preferred compression
-	///     scheme, which can be set using
+	///     scheme, which can be set using set_preferred_compression() or
 	///     tpie::the_compressor_thread().set_preferred_compression().
 	///
+	/// open::compression_adaptive
+	///     Create the stream in compression mode if it does not already exist,
+	///     and compress written blocks using the preferred compression scheme
+	///     as long as the blocks shrink enough to make it worthwhile.
+	///     Blocks that do not are stored uncompressed, and compression is
+	///     periodically retried.
+	///
 	/// \param path  The path to the file to open
 	/// \param openFlags  A bit-wise combination of the flags; see above.
 	/// \param userDataSize  Required user data capacity in stream header.
@@ -316,6 +357,23 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	void set_position(const stream_position & pos);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Return the position of the first item of every block in the
+	/// stream, in stream order.
+	///
+	/// A reader positioned with set_position at one of these positions can
+	/// decode the stream from that block on without reading the blocks
+	/// before it, so several readers may split the stream between them.
+	/// For compressed streams the block headers are read from disk, which
+	/// costs one small read per block but no decompression.
+	///
+	/// Pending writes are flushed, and the stream is positioned at the
+	/// beginning afterwards.
+	///
+	/// Blocks to take the compressor lock.
+	///////////////////////////////////////////////////////////////////////////
+	std::vector<stream_position> block_positions();
+
 	stream_size_type size() const { return m_size; }
 
 	stream_size_type file_size() const { return size(); }
@@ -468,7 +526,22 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	template <typename IT>
 	void read(IT const a, IT const b) {
-		for (IT i = a; i != b; ++i) *i = read();
+		IT i = a;
+		while (i != b) {
+			if (m_cachedReads == 0) {
+				*i = read();
+				++i;
+				continue;
+			}
+			// Copy the items left in the current block in one go.
+			const memory_size_type n = static_cast<memory_size_type>(
+				std::min<stream_size_type>(m_cachedReads, std::distance(i, b)));
+			const T * first = reinterpret_cast<const T *>(m_nextItem);
+			i = std::copy(first, first + n, i);
+			m_cachedReads -= n;
+			m_offset += n;
+			m_nextItem += n * sizeof(T);
+		}
 	}
 	
 	const T & read_back() {
@@ -494,7 +567,23 @@ public:
 
 	template <typename IT>
 	void write(IT const a, IT const b) {
-		for (IT i = a; i != b; ++i) write(*i);
+		IT i = a;
+		while (i != b) {
+			if (m_cachedWrites == 0) {
+				write(*i);
+				++i;
+				continue;
+			}
+			// Fill the rest of the current block in one go.
+			const memory_size_type n = static_cast<memory_size_type>(
+				std::min<stream_size_type>(m_cachedWrites, std::distance(i, b)));
+			T * first = reinterpret_cast<T *>(m_nextItem);
+			for (memory_size_type k = 0; k < n; ++k, ++i) first[k] = *i;
+			m_nextItem += n * sizeof(T);
+			m_size += n;
+			m_offset += n;
+			m_cachedWrites -= n;
+		}
 	}
 };
 
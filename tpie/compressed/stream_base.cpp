@@ -24,6 +24,10 @@
 #include <tpie/compressed/buffer.h>
 #include <tpie/compressed/request.h>
 #include <tpie/compressed/direction.h>
+#include <tpie/compressed/scheme.h>
+#include <tpie/tpie_log.h>
+#include <algorithm>
+#include <atomic>
 
 namespace tpie {
 
@@ -40,6 +44,7 @@ open::type translate(access_type accessType, cache_hint cacheHint, compression_f
 									 
 									 (compressionFlags == tpie::compression_normal) ? open::compression_normal :
 									 (compressionFlags == tpie::compression_all) ? open::compression_all :
+									 (compressionFlags == tpie::compression_adaptive) ? open::compression_adaptive :
 									 open::defaults));
 }
 
@@ -59,12 +64,14 @@ cache_hint translate_cache(open::type openFlags) {
 
 compression_flags translate_compression(open::type openFlags) {
 	const open::type compressionFlags =
-		openFlags & (open::compression_normal | open::compression_all);
+		openFlags & (open::compression_normal | open::compression_all | open::compression_adaptive);
 	
 	if (compressionFlags == open::compression_normal)
 		return tpie::compression_normal;
 	else if (compressionFlags == open::compression_all)
 		return tpie::compression_all;
+	else if (compressionFlags == open::compression_adaptive)
+		return tpie::compression_adaptive;
 	else if (!compressionFlags)
 		return tpie::compression_none;
 	else
@@ -151,6 +158,11 @@ public:
 	/** Response from compressor thread; protected by compressor thread mutex. */
 	compressor_response m_response;
 
+	/** Whether blocks are compressed with m_preferredCompression rather than
+	 * the compressor thread's preferred compression scheme. */
+	bool m_hasPreferredCompression = false;
+	compression_scheme::type m_preferredCompression = compression_scheme::none;
+
 	/** When use_compression() is true:
 	 * Indicates whether m_response is the response to a write request.
 	 * Used for knowing where to read next in read/read_back.
@@ -221,6 +233,7 @@ public:
 		m_lastBlockReadOffset = m_byteStreamAccessor.get_last_block_read_offset();
 		m_currentFileSize = m_byteStreamAccessor.file_size();
 		m_response.clear_block_info();
+		m_response.reset_statistics();
 		
 		m_o->seek(0);
 	}
@@ -278,6 +291,10 @@ public:
 		}
 		m_buffer->set_size(blockItems * m_itemSize);
 		m_buffer->set_state(compressor_buffer_state::writing);
+		compression_scheme::type compressionScheme =
+			m_hasPreferredCompression
+			? m_preferredCompression
+			: compressor().get_preferred_compression(lock);
 		compressor_request r;
 		r.set_write_request(m_buffer,
 							&m_byteStreamAccessor,
@@ -285,8 +302,10 @@ public:
 							writeOffset,
 							blockItems,
 							blockNumber,
+							compressionScheme,
 							&m_response);
 		compressor().request(r);
+		if (use_compression()) m_response.block_requested();
 		m_bufferDirty = false;
 		
 		if (m_updateReadOffsetFromWrite) {
@@ -775,11 +794,28 @@ compressed_stream_base::~compressed_stream_base() {
 	// m_ownedTempFile::~unique_ptr()
 }
 
+namespace {
+
+// The largest single read of a block: its compressed contents and trailer
+// (or the whole block, if it is stored uncompressed).
+memory_size_type max_block_read_size(memory_size_type blockSize) noexcept {
+	memory_size_type res = blockSize;
+	for (int t = 0; t <= compression_scheme::max_type; ++t) {
+		compression_scheme::type scheme = static_cast<compression_scheme::type>(t);
+		if (!is_compression_scheme_known(scheme)) continue;
+		res = std::max<memory_size_type>(res, get_compression_scheme(scheme).max_compressed_length(blockSize));
+	}
+	return res + 2 * sizeof(stream_size_type);
+}
+
+} // unnamed namespace
+
 memory_size_type compressed_stream_base::memory_usage(double blockFactor) noexcept {
 	// m_buffer is included in m_buffers memory usage
 	return sizeof(temp_file) // m_ownedTempFile
 		+ stream_buffers::memory_usage(block_size(blockFactor)) // m_buffers;
-		+ sizeof(compressed_stream_base_p);
+		+ sizeof(compressed_stream_base_p)
+		+ default_raw_file_accessor::read_ahead_memory_usage(max_block_read_size(block_size(blockFactor)));
 }
 
 memory_size_type compressed_stream_base::block_size(double blockFactor) noexcept {
@@ -827,6 +863,24 @@ const std::string & compressed_stream_base::path() const {
 	return m_p->m_byteStreamAccessor.path();
 }
 
+void compressed_stream_base::set_preferred_compression(compression_scheme::type scheme) {
+	if (!is_compression_scheme_known(scheme))
+		throw invalid_argument_exception("set_preferred_compression: Unknown compression scheme");
+	m_p->m_hasPreferredCompression = true;
+	m_p->m_preferredCompression = scheme;
+}
+
+compression_scheme::type compressed_stream_base::get_preferred_compression() {
+	if (m_p->m_hasPreferredCompression) return m_p->m_preferredCompression;
+	compressor_thread_lock l(m_p->compressor());
+	return m_p->compressor().get_preferred_compression(l);
+}
+
+compression_statistics compressed_stream_base::get_compression_statistics() {
+	compressor_thread_lock l(m_p->compressor());
+	return m_p->m_response.get_statistics(l);
+}
+
 void compressed_stream_base::open(const std::string & path, open::type openFlags,
 								  memory_size_type userDataSize /*= 0*/)
 {
@@ -834,12 +888,28 @@ void compressed_stream_base::open(const std::string & path, open::type openFlags
 	m_p->open_inner(path, openFlags, userDataSize);
 }
 
+namespace {
+
+// Compressed blocks have variable sizes and are not aligned, so the file is
+// accessed through the page cache. Say so once instead of for every run file.
+void warn_direct_io_ignored(temp_file & file) {
+	static std::atomic<bool> warned(false);
+	if (file.direct_io() && !warned.exchange(true)) {
+		log_warning() << "Compressed streams do not support direct I/O; "
+					  << "temporary files such as " << file.path()
+					  << " are accessed through the page cache" << std::endl;
+	}
+}
+
+} // unnamed namespace
+
 void compressed_stream_base::open(open::type openFlags,
 								  memory_size_type userDataSize /*= 0*/)
 {
 	close();
 	m_p->m_ownedTempFile.reset(tpie_new<temp_file>());
 	m_p->m_tempFile = m_p->m_ownedTempFile.get();
+	warn_direct_io_ignored(*m_p->m_tempFile);
 	m_p->open_inner(m_p->m_tempFile->path(), openFlags, userDataSize);
 }
 
@@ -848,6 +918,7 @@ void compressed_stream_base::open(temp_file & file, open::type openFlags,
 {
 	close();
 	m_p->m_tempFile = &file;
+	warn_direct_io_ignored(file);
 	m_p->open_inner(m_p->m_tempFile->path(), openFlags, userDataSize);
 }
 
@@ -1224,6 +1295,34 @@ void compressed_stream_base::set_position(const stream_position & pos) {
 	m_p->uncache_read_writes();
 }
 
+std::vector<stream_position> compressed_stream_base::block_positions() {
+	tp_assert(is_open(), "block_positions: !is_open");
+	m_p->uncache_read_writes();
+	m_p->m_updateReadOffsetFromWrite = false;
+	{
+		compressor_thread_lock l(m_p->compressor());
+		if (m_p->m_bufferDirty)
+			m_p->flush_block(l);
+		m_p->m_buffer.reset();
+		m_p->finish_requests(l);
+	}
+	m_seekState = seek_state::beginning;
+
+	std::vector<stream_position> positions;
+	positions.reserve(static_cast<size_t>(m_p->m_streamBlocks));
+	stream_size_type readOffset = 0;
+	for (stream_size_type b = 0; b < m_p->m_streamBlocks; ++b) {
+		if (!m_p->use_compression()) {
+			positions.push_back(stream_position(0, b * m_p->m_blockItems));
+			continue;
+		}
+		positions.push_back(stream_position(readOffset, b * m_p->m_blockItems));
+		if (b + 1 < m_p->m_streamBlocks)
+			readOffset = compressor_thread::next_block_read_offset(m_p->m_byteStreamAccessor, readOffset);
+	}
+	return positions;
+}
+
 bool compressed_stream_base::is_readable() const noexcept { return m_p->m_canRead; }
 
 bool compressed_stream_base::is_writable() const noexcept { return m_p->m_canWrite; }
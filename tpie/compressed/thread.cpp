@@ -18,11 +18,14 @@
 // along with TPIE.  If not, see <http://www.gnu.org/licenses/>
 
 #include <queue>
+#include <vector>
+#include <cstdlib>
 #include <tpie/compressed/thread.h>
 #include <tpie/compressed/request.h>
 #include <tpie/compressed/buffer.h>
 #include <tpie/compressed/scheme.h>
 #include <condition_variable>
+#include <mutex>
 namespace {
 
 class block_header {
@@ -81,17 +84,47 @@ namespace tpie {
 	return dataOffset - sizeof(block_header);
 }
 
+/*static*/ stream_size_type compressor_thread::next_block_read_offset(file_accessor_t & accessor,
+																	  stream_size_type readOffset) {
+	block_header blockHeader;
+	if (accessor.read(readOffset, &blockHeader, sizeof(blockHeader)) != sizeof(blockHeader))
+		throw exception("read failed to read right amount");
+	const memory_size_type blockSize = blockHeader.get_block_size();
+	if (blockSize == 0)
+		throw exception("Block size was unexpectedly zero");
+	return readOffset + sizeof(blockHeader) + blockSize + sizeof(blockHeader);
+}
+
 class compressor_thread::impl {
 public:
 	impl()
 		: m_done(false)
 		, m_preferredCompression(compression_scheme::snappy)
+		, m_nextWorker(0)
 	{
 	}
 
 	void stop(compressor_thread_lock & /*lock*/) {
 		m_done = true;
-		m_newRequest.notify_one();
+		for (size_t i = 0; i < m_workers.size(); ++i)
+			m_workers[i]->newRequest.notify_one();
+	}
+
+	void set_worker_count(compressor_thread_lock & /*lock*/, memory_size_type workers) {
+		tp_assert(workers > 0, "set_worker_count: Need at least one worker");
+		for (size_t i = 0; i < m_workers.size(); ++i) {
+			if (!m_workers[i]->requests.empty())
+				throw exception("set_worker_count: Worker has pending requests");
+		}
+		m_workers.clear();
+		for (memory_size_type i = 0; i < workers; ++i)
+			m_workers.emplace_back(new worker_state());
+		m_nextWorker = 0;
+		m_done = false;
+	}
+
+	memory_size_type get_worker_count(compressor_thread_lock & /*lock*/) {
+		return m_workers.size();
 	}
 
 	bool request_valid(const compressor_request & r) {
@@ -105,18 +138,23 @@ public:
 		tp_assert(false, "Unknown request type");
 	}
 
-	void run() {
+	void run(memory_size_type workerIndex) {
+		compressor_thread_lock::lock_t lock(mutex());
+		tp_assert(workerIndex < m_workers.size(), "run: Invalid worker index");
+		worker_state & w = *m_workers[workerIndex];
+		lock.unlock();
 		while (true) {
-			compressor_thread_lock::lock_t lock(mutex());
-			m_idle = false;
-			while (!m_done && m_requests.empty()) {
-				m_idle = true;
-				m_newRequest.wait(lock);
+			lock.lock();
+			w.idle = false;
+			while (!m_done && w.requests.empty()) {
+				w.idle = true;
+				w.newRequest.wait(lock);
 			}
-			if (m_done && m_requests.empty()) break;
+			if (m_done && w.requests.empty()) break;
 			{
-				compressor_request r = m_requests.front();
-				m_requests.pop();
+				compressor_request r = w.requests.front();
+				w.requests.pop();
+				const bool idle = w.idle;
 				lock.unlock();
 
 				switch (r.kind()) {
@@ -126,12 +164,13 @@ public:
 						process_read_request(r.get_read_request());
 						break;
 					case compressor_request_kind::WRITE:
-						process_write_request(r.get_write_request());
+						process_write_request(r.get_write_request(), idle);
 						break;
 				}
 			}
 			lock.lock();
 			m_requestDone.notify_all();
+			lock.unlock();
 		}
 	}
 
@@ -219,7 +258,7 @@ private:
 		rr.set_next_block_offset(nextReadOffset);
 	}
 
-	void process_write_request(write_request & wr) {
+	void process_write_request(write_request & wr, bool idle) {
 		stat_timer t(4); // Time writing
 		size_t inputLength = wr.buffer()->size();
 		if (!wr.file_accessor().get_compressed()) {
@@ -232,28 +271,54 @@ private:
 			return;
 		}
 		// Compressed case
-		const bool adaptiveCompression =
-			wr.file_accessor().get_compression_flags() != compression_all;
+		const int compressionFlags = wr.file_accessor().get_compression_flags();
+		compressor_response & response = wr.get_response();
 		block_header blockHeader;
 		block_header & blockTrailer = blockHeader;
-		compression_scheme::type schemeType = m_preferredCompression;
-		if (adaptiveCompression && !m_idle) {
+		compression_scheme::type schemeType = wr.get_compression_scheme();
+		if (compressionFlags == compression_normal && !idle) {
 			schemeType = compression_scheme::none;
 		}
-		if (schemeType == compression_scheme::snappy)
-			increment_user(7, 1);
-		if (schemeType == compression_scheme::none)
-			increment_user(8, 1);
-		const compression_scheme & compressionScheme = get_compression_scheme(schemeType);
-		const memory_size_type maxBlockSize = compressionScheme.max_compressed_length(inputLength);
+		const bool probe = compressionFlags == compression_adaptive
+			&& schemeType != compression_scheme::none;
+		if (probe && !response.adaptive_should_compress()) {
+			schemeType = compression_scheme::none;
+		}
+		const compression_scheme * compressionScheme = &get_compression_scheme(schemeType);
+		// If support for the scheme is not built in, the block is stored
+		// uncompressed, and the header must say so.
+		if (compressionScheme == &get_compression_scheme_none())
+			schemeType = compression_scheme::none;
+		const memory_size_type maxBlockSize = std::max(
+			inputLength, compressionScheme->max_compressed_length(inputLength));
 		if (maxBlockSize > blockHeader.max_block_size())
 			throw exception("process_write_request: MaxCompressedLength > max_block_size");
 		array<char> scratch(sizeof(blockHeader) + maxBlockSize + sizeof(blockTrailer));
 		memory_size_type blockSize;
-		compressionScheme.compress(scratch.get() + sizeof(blockHeader),
-								   reinterpret_cast<const char *>(wr.buffer()->get()),
-								   inputLength,
-								   &blockSize);
+		const ptime compressStart = ptime::now();
+		compressionScheme->compress(scratch.get() + sizeof(blockHeader),
+									reinterpret_cast<const char *>(wr.buffer()->get()),
+									inputLength,
+									&blockSize);
+		const stream_size_type compressTime = (schemeType == compression_scheme::none) ? 0 :
+			static_cast<stream_size_type>(ptime::seconds(compressStart, ptime::now()) * 1000000);
+		if (probe && schemeType != compression_scheme::none) {
+			const bool paidOff = blockSize <= adaptive_max_ratio * inputLength;
+			response.adaptive_record_probe(paidOff, adaptive_min_interval, adaptive_max_interval);
+			if (blockSize >= inputLength) {
+				// Compression did not help at all; store the block as it is.
+				schemeType = compression_scheme::none;
+				compressionScheme = &get_compression_scheme_none();
+				compressionScheme->compress(scratch.get() + sizeof(blockHeader),
+											reinterpret_cast<const char *>(wr.buffer()->get()),
+											inputLength,
+											&blockSize);
+			}
+		}
+		if (schemeType != compression_scheme::none)
+			increment_user(7, 1);
+		else
+			increment_user(8, 1);
 		blockHeader.set_block_size(blockSize);
 		blockHeader.set_compression_scheme(schemeType);
 		memcpy(scratch.get(), &blockHeader, sizeof(blockHeader));
@@ -274,6 +339,8 @@ private:
 			wr.set_block_info(offset, writeSize);
 			const stream_size_type newSize = offset + writeSize;
 			wr.update_recorded_size(newSize);
+			response.record_block(schemeType != compression_scheme::none,
+								  inputLength, blockSize, compressTime);
 		}
 		wr.file_accessor().append(scratch.get(), writeSize);
 	}
@@ -283,12 +350,25 @@ public:
 		return m_mutex;
 	}
 
-	void request(const compressor_request & r) {
+	void request(compressor_request & r) {
 		tp_assert(request_valid(r), "Invalid request");
+		if (m_workers.empty())
+			throw exception("Compressor thread is not initialized; call tpie_init with the COMPRESSION subsystem");
+
+		// Pin the stream to a single worker, so that its requests
+		// are served in the order they were made.
+		compressor_response & response = r.get_request_base().get_response();
+		memory_size_type workerIndex = response.get_worker();
+		if (workerIndex >= m_workers.size()) {
+			workerIndex = m_nextWorker;
+			m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+			response.set_worker(workerIndex);
+		}
 
-		m_requests.push(r);
-		m_requests.back().get_request_base().initiate_request();
-		m_newRequest.notify_one();
+		worker_state & w = *m_workers[workerIndex];
+		w.requests.push(r);
+		w.requests.back().get_request_base().initiate_request();
+		w.newRequest.notify_one();
 	}
 
 	void wait_for_request_done(compressor_thread_lock & l) {
@@ -298,19 +378,45 @@ public:
 	}
 
 	void set_preferred_compression(compressor_thread_lock &, compression_scheme::type scheme) {
+		if (!is_compression_scheme_known(scheme))
+			throw invalid_argument_exception("set_preferred_compression: Unknown compression scheme");
 		m_preferredCompression = scheme;
 	}
 
+	compression_scheme::type get_preferred_compression(compressor_thread_lock &) {
+		return m_preferredCompression;
+	}
+
 private:
+	// In compression_adaptive mode, compressing a block pays off if it
+	// shrinks to at most this fraction of its size.
+	static constexpr double adaptive_max_ratio = 0.9;
+	// Number of blocks stored uncompressed after the first probe that did
+	// not pay off; doubled after every consecutive failed probe.
+	static const memory_size_type adaptive_min_interval = 4;
+	static const memory_size_type adaptive_max_interval = 256;
+
+	struct worker_state {
+		worker_state()
+			: idle(false)
+		{
+		}
+
+		std::queue<compressor_request> requests;
+		std::condition_variable newRequest;
+
+		// Whether the worker was idle prior to handling the current request.
+		bool idle;
+	};
+
 	mutex_t m_mutex;
-	std::queue<compressor_request> m_requests;
-	std::condition_variable m_newRequest;
+	std::vector<std::unique_ptr<worker_state> > m_workers;
 	std::condition_variable m_requestDone;
 	bool m_done;
 	compression_scheme::type m_preferredCompression;
 
-	// Whether the thread was idle prior to handling the current request.
-	bool m_idle;
+	// Worker to assign to the next stream that makes a request.
+	memory_size_type m_nextWorker;
 };
 
 } // namespace tpie
@@ -318,50 +424,93 @@ private:
 namespace {
 
 tpie::compressor_thread the_compressor_thread;
-std::thread the_compressor_thread_handle;
+std::vector<std::thread> the_compressor_thread_handles;
 bool compressor_thread_already_finished = false;
+tpie::memory_size_type the_compressor_thread_count = 0;
+// Protects the three variables above.
+std::mutex the_compressor_pool_mutex;
 
-void run_the_compressor_thread() {
-	the_compressor_thread.run();
+void run_the_compressor_thread(tpie::memory_size_type worker) {
+	the_compressor_thread.run(worker);
 }
 
-} // unnamed namespace
-
-namespace tpie {
-
-compressor_thread & the_compressor_thread() {
-	return ::the_compressor_thread;
+tpie::memory_size_type compressor_thread_count_unlocked() {
+	if (the_compressor_thread_count == 0) {
+		const char * v = getenv("TPIE_COMPRESSOR_THREADS");
+		if (v != NULL) the_compressor_thread_count = atol(v);
+		if (the_compressor_thread_count == 0) the_compressor_thread_count = 1;
+	}
+	return the_compressor_thread_count;
 }
 
-void init_compressor() {
-	if (the_compressor_thread_handle.get_id() != std::thread::id()) {
-		log_debug() << "Attempted to initiate compressor thread twice" << std::endl;
+void init_compressor_unlocked() {
+	if (!the_compressor_thread_handles.empty()) {
+		tpie::log_debug() << "Attempted to initiate compressor thread twice" << std::endl;
 		return;
 	}
-	std::thread t(run_the_compressor_thread);
-	the_compressor_thread_handle.swap(t);
+	const tpie::memory_size_type threads = compressor_thread_count_unlocked();
+	{
+		tpie::compressor_thread_lock lock(the_compressor_thread);
+		the_compressor_thread.set_worker_count(lock, threads);
+	}
+	for (tpie::memory_size_type i = 0; i < threads; ++i)
+		the_compressor_thread_handles.emplace_back(run_the_compressor_thread, i);
 	compressor_thread_already_finished = false;
 }
 
-void finish_compressor() {
-	if (the_compressor_thread_handle.get_id() == std::thread::id()) {
+void finish_compressor_unlocked() {
+	if (the_compressor_thread_handles.empty()) {
 		if (compressor_thread_already_finished) {
-			log_debug() << "Compressor thread already finished" << std::endl;
+			tpie::log_debug() << "Compressor thread already finished" << std::endl;
 		} else {
-			log_debug() << "Attempted to finish compressor thread that was never initiated" << std::endl;
+			tpie::log_debug() << "Attempted to finish compressor thread that was never initiated" << std::endl;
 		}
 		return;
 	}
 	{
-		compressor_thread_lock lock(the_compressor_thread());
-		the_compressor_thread().stop(lock);
+		tpie::compressor_thread_lock lock(the_compressor_thread);
+		the_compressor_thread.stop(lock);
 	}
-	the_compressor_thread_handle.join();
-	std::thread t;
-	the_compressor_thread_handle.swap(t);
+	for (size_t i = 0; i < the_compressor_thread_handles.size(); ++i)
+		the_compressor_thread_handles[i].join();
+	the_compressor_thread_handles.clear();
 	compressor_thread_already_finished = true;
 }
 
+} // unnamed namespace
+
+namespace tpie {
+
+compressor_thread & the_compressor_thread() {
+	return ::the_compressor_thread;
+}
+
+memory_size_type get_compressor_thread_count() {
+	std::lock_guard<std::mutex> lock(the_compressor_pool_mutex);
+	return compressor_thread_count_unlocked();
+}
+
+void set_compressor_thread_count(memory_size_type threads) {
+	if (threads == 0) threads = 1;
+	std::lock_guard<std::mutex> lock(the_compressor_pool_mutex);
+	if (threads == compressor_thread_count_unlocked()) return;
+	the_compressor_thread_count = threads;
+	if (!the_compressor_thread_handles.empty()) {
+		finish_compressor_unlocked();
+		init_compressor_unlocked();
+	}
+}
+
+void init_compressor() {
+	std::lock_guard<std::mutex> lock(the_compressor_pool_mutex);
+	init_compressor_unlocked();
+}
+
+void finish_compressor() {
+	std::lock_guard<std::mutex> lock(the_compressor_pool_mutex);
+	finish_compressor_unlocked();
+}
+
 compressor_thread::compressor_thread()
 	: pimpl(new impl)
 {
@@ -379,8 +528,8 @@ void compressor_thread::request(compressor_request & r) {
 	pimpl->request(r);
 }
 
-void compressor_thread::run() {
-	pimpl->run();
+void compressor_thread::run(memory_size_type worker) {
+	pimpl->run(worker);
 }
 
 void compressor_thread::wait_for_request_done(compressor_thread_lock & l) {
@@ -391,8 +540,20 @@ void compressor_thread::stop(compressor_thread_lock & lock) {
 	pimpl->stop(lock);
 }
 
+void compressor_thread::set_worker_count(compressor_thread_lock & lock, memory_size_type workers) {
+	pimpl->set_worker_count(lock, workers);
+}
+
+memory_size_type compressor_thread::get_worker_count(compressor_thread_lock & lock) {
+	return pimpl->get_worker_count(lock);
+}
+
 void compressor_thread::set_preferred_compression(compressor_thread_lock & lock, compression_scheme::type scheme) {
 	pimpl->set_preferred_compression(lock, scheme);
 }
 
+compression_scheme::type compressor_thread::get_preferred_compression(compressor_thread_lock & lock) {
+	return pimpl->get_preferred_compression(lock);
+}
+
 }
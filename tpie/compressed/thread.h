@@ -22,6 +22,11 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \file compressed/thread.h  Interface to the compressor thread.
+///
+/// The compressor thread is in fact a pool of worker threads, each with its
+/// own request queue. All requests from a single stream are served by the
+/// same worker, so blocks of one stream are compressed, written and read
+/// in the order they were requested.
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <thread>
@@ -46,6 +51,16 @@ public:
 
 	static stream_size_type subtract_block_header(stream_size_type dataOffset);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Read the header of the compressed block at readOffset and
+	/// return the read offset of the block following it.
+	///
+	/// Does not take the compressor lock; the caller must ensure that no
+	/// requests are pending on the accessor.
+	///////////////////////////////////////////////////////////////////////////
+	static stream_size_type next_block_read_offset(file_accessor_t & accessor,
+												   stream_size_type readOffset);
+
 	compressor_thread();
 	~compressor_thread();
 
@@ -56,11 +71,30 @@ public:
 
 	void wait_for_request_done(compressor_thread_lock & l);
 
-	void run();
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Serve the request queue of the given worker until stop() is
+	/// called and the queue is empty.
+	///////////////////////////////////////////////////////////////////////////
+	void run(memory_size_type worker);
 
 	void stop(compressor_thread_lock & lock);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Set up the request queues for the given number of workers.
+	///
+	/// Must not be called while any worker is running.
+	///////////////////////////////////////////////////////////////////////////
+	void set_worker_count(compressor_thread_lock & lock, memory_size_type workers);
+
+	memory_size_type get_worker_count(compressor_thread_lock & lock);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Set the compression scheme used by streams that have not
+	/// chosen one with compressed_stream_base::set_preferred_compression().
+	///////////////////////////////////////////////////////////////////////////
 	void set_preferred_compression(compressor_thread_lock &, compression_scheme::type);
+
+	compression_scheme::type get_preferred_compression(compressor_thread_lock &);
 };
 
 class compressor_thread_lock {
@@ -92,6 +126,22 @@ private:
 	ptime t2;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Set the number of compressor worker threads.
+///
+/// The default is taken from the TPIE_COMPRESSOR_THREADS environment
+/// variable, or 1 if it is not set. If the compressor is running, it is
+/// restarted with the new number of workers, which requires that no
+/// compressed streams are open.
+///////////////////////////////////////////////////////////////////////////////
+void set_compressor_thread_count(memory_size_type threads);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief  Get the number of compressor worker threads started by
+/// init_compressor().
+///////////////////////////////////////////////////////////////////////////////
+memory_size_type get_compressor_thread_count();
+
 } // namespace tpie
 
 #endif // TPIE_COMPRESSED_THREAD_H
@@ -69,6 +69,7 @@
 #cmakedefine TPIE_HAS_SNAPPY
 #cmakedefine TPIE_HAS_LZ4
 #cmakedefine TPIE_HAS_ZSTD
+#cmakedefine TPIE_HAS_IO_URING
 
 // See https://github.com/lz4/lz4/pull/459
 #if __cplusplus >= 201402
@@ -0,0 +1,89 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/config.h>
+#include <tpie/file_accessor/backend.h>
+#include <tpie/tpie_log.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef TPIE_HAS_IO_URING
+#include <tpie/file_accessor/io_uring.h>
+#endif // TPIE_HAS_IO_URING
+
+namespace {
+
+std::atomic<int> the_backend(-1);
+std::atomic<tpie::memory_size_type> the_read_ahead(2);
+std::atomic<tpie::memory_size_type> the_read_ahead_memory(64*1024*1024);
+
+} // unnamed namespace
+
+namespace tpie {
+
+bool file_accessor_backend_available(file_accessor_backend backend) {
+	switch (backend) {
+		case backend_posix:
+			return true;
+		case backend_io_uring:
+#ifdef TPIE_HAS_IO_URING
+			return file_accessor::bits::io_uring_available();
+#else // TPIE_HAS_IO_URING
+			return false;
+#endif // TPIE_HAS_IO_URING
+	}
+	return false;
+}
+
+void set_file_accessor_backend(file_accessor_backend backend) {
+	if (!file_accessor_backend_available(backend))
+		log_debug() << "File accessor backend " << backend
+					<< " is not available; using posix" << std::endl;
+	the_backend = backend;
+}
+
+file_accessor_backend get_file_accessor_backend() {
+	int backend = the_backend;
+	if (backend == -1) {
+		backend = backend_posix;
+		const char * v = getenv("TPIE_FILE_ACCESSOR");
+		if (v != NULL && strcmp(v, "io_uring") == 0) backend = backend_io_uring;
+		the_backend = backend;
+	}
+	return static_cast<file_accessor_backend>(backend);
+}
+
+void set_io_uring_read_ahead(memory_size_type reads) {
+	the_read_ahead = reads;
+}
+
+memory_size_type get_io_uring_read_ahead() {
+	return the_read_ahead;
+}
+
+void set_io_uring_read_ahead_memory(memory_size_type bytes) {
+	the_read_ahead_memory = bytes;
+}
+
+memory_size_type get_io_uring_read_ahead_memory() {
+	return the_read_ahead_memory;
+}
+
+} // namespace tpie
@@ -0,0 +1,83 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file backend.h  Runtime selection of the raw file accessor backend.
+///
+/// On Linux builds with io_uring support, the default raw file accessor can
+/// perform its I/O either with blocking read/write system calls (the posix
+/// backend) or through a process-wide io_uring. The backend is chosen when a
+/// file is opened, so changing it only affects files opened afterwards. The
+/// initial backend is taken from the TPIE_FILE_ACCESSOR environment variable
+/// ("posix" or "io_uring") and defaults to posix.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TPIE_FILE_ACCESSOR_BACKEND_H
+#define TPIE_FILE_ACCESSOR_BACKEND_H
+
+#include <tpie/types.h>
+
+namespace tpie {
+
+enum file_accessor_backend {
+	/** Blocking read/write system calls. */
+	backend_posix,
+	/** Asynchronous I/O through a shared io_uring, with read-ahead. */
+	backend_io_uring
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Return true if the given backend is compiled in and supported by
+/// the running kernel.
+///////////////////////////////////////////////////////////////////////////////
+bool file_accessor_backend_available(file_accessor_backend backend);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Select the backend used by files opened from now on. If the
+/// backend is not available, files silently use the posix backend instead.
+///////////////////////////////////////////////////////////////////////////////
+void set_file_accessor_backend(file_accessor_backend backend);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Return the backend selected with set_file_accessor_backend or the
+/// TPIE_FILE_ACCESSOR environment variable.
+///////////////////////////////////////////////////////////////////////////////
+file_accessor_backend get_file_accessor_backend();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Set the number of reads the io_uring backend keeps in flight
+/// ahead of a sequential reader. Zero disables read-ahead. Defaults to 2.
+///////////////////////////////////////////////////////////////////////////////
+void set_io_uring_read_ahead(memory_size_type reads);
+
+memory_size_type get_io_uring_read_ahead();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Set the number of bytes all open files may use together for
+/// read-ahead buffers in the io_uring backend. The buffers are allocated
+/// through the TPIE memory manager and are included in the memory_usage()
+/// of streams; this limit additionally caps their total. Defaults to 64 MiB.
+///////////////////////////////////////////////////////////////////////////////
+void set_io_uring_read_ahead_memory(memory_size_type bytes);
+
+memory_size_type get_io_uring_read_ahead_memory();
+
+} // namespace tpie
+
+#endif // TPIE_FILE_ACCESSOR_BACKEND_H
@@ -23,7 +23,9 @@
 /// \file file_accessor.h Declare default file accessor.
 ///////////////////////////////////////////////////////////////////////////////
 
+#include <tpie/config.h>
 #include <tpie/file_accessor/stream_accessor.h>
+#include <tpie/file_accessor/backend.h>
 
 #ifdef WIN32
 
@@ -35,6 +37,18 @@ typedef stream_accessor_base<win32> file_accessor;
 }
 }
 
+#elif defined(TPIE_HAS_IO_URING)
+
+// The io_uring accessor falls back to posix I/O unless the io_uring backend
+// is selected at runtime; see backend.h.
+#include <tpie/file_accessor/io_uring.h>
+namespace tpie {
+namespace file_accessor {
+typedef io_uring raw_file_accessor;
+typedef stream_accessor_base<io_uring> file_accessor;
+}
+}
+
 #else // WIN32
 
 #include <tpie/file_accessor/posix.h>
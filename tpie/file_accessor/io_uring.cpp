@@ -0,0 +1,347 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/config.h>
+#include <tpie/file_accessor/io_uring.h>
+#include <tpie/tpie_log.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+using tpie::memory_size_type;
+using tpie::file_accessor::bits::io_uring_request;
+
+int sys_io_uring_setup(unsigned entries, io_uring_params * p) {
+	return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sys_io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+	return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void * arg, unsigned args) {
+	return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, args));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// The ring shared by all io_uring accessors. Submission and reaping of
+/// completions happen under a mutex; one submitting thread and one waiting
+/// thread at a time enter the kernel, and the others let them submit their
+/// entries or publish the completions.
+///////////////////////////////////////////////////////////////////////////////
+class ring {
+public:
+	ring()
+		: m_fd(-1)
+		, m_sqRing(MAP_FAILED)
+		, m_cqRing(MAP_FAILED)
+		, m_sqes(MAP_FAILED)
+		, m_inFlight(0)
+		, m_unsubmitted(0)
+		, m_submitting(false)
+		, m_reaping(false)
+		, m_reserved(0)
+	{
+		setup();
+	}
+
+	~ring() {
+		teardown();
+	}
+
+	bool available() const {
+		return m_fd != -1;
+	}
+
+	void submit(io_uring_request * const * requests, memory_size_type count) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		memory_size_type i = 0;
+		while (i < count) {
+			// Never have more requests in flight than the completion queue
+			// can hold.
+			if (m_inFlight >= m_sqEntries) {
+				flush(lock);
+				while (m_inFlight >= m_sqEntries) wait_for_completion(lock);
+			}
+			const unsigned tail = *m_sqTail;
+			unsigned n = 0;
+			while (i < count && m_inFlight + n < m_sqEntries) {
+				const unsigned index = (tail + n) & *m_sqMask;
+				io_uring_request & r = *requests[i];
+				io_uring_sqe & sqe = m_sqeArray[index];
+				memset(&sqe, 0, sizeof(sqe));
+				sqe.opcode = r.write ? IORING_OP_WRITE : IORING_OP_READ;
+				sqe.fd = r.fd;
+				sqe.addr = reinterpret_cast<__u64>(r.data);
+				sqe.len = static_cast<__u32>(r.size);
+				sqe.off = r.offset;
+				sqe.user_data = reinterpret_cast<__u64>(&r);
+				m_sqArray[index] = index;
+				r.done = false;
+				r.result = 0;
+				++n;
+				++i;
+			}
+			__atomic_store_n(m_sqTail, tail + n, __ATOMIC_RELEASE);
+			m_inFlight += n;
+			m_unsubmitted += n;
+		}
+		flush(lock);
+	}
+
+	void wait(io_uring_request & request) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		flush(lock);
+		reap();
+		while (!request.done) wait_for_completion(lock);
+	}
+
+	bool reserve(memory_size_type bytes) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_reserved + bytes > tpie::get_io_uring_read_ahead_memory()) return false;
+		m_reserved += bytes;
+		return true;
+	}
+
+	void release(memory_size_type bytes) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_reserved -= std::min(bytes, m_reserved);
+	}
+
+private:
+	void setup() {
+		const unsigned entries = 256;
+		io_uring_params p;
+		memset(&p, 0, sizeof(p));
+		m_fd = sys_io_uring_setup(entries, &p);
+		if (m_fd == -1) {
+			tpie::log_debug() << "io_uring_setup failed: " << strerror(errno) << std::endl;
+			return;
+		}
+		if (!probe()) {
+			tpie::log_debug() << "io_uring lacks read/write support" << std::endl;
+			teardown();
+			return;
+		}
+
+		size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single) sqSize = cqSize = std::max(sqSize, cqSize);
+		m_sqSize = sqSize;
+		m_cqSize = cqSize;
+		m_sqRing = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						m_fd, IORING_OFF_SQ_RING);
+		if (m_sqRing == MAP_FAILED) {
+			teardown();
+			return;
+		}
+		if (single) {
+			m_cqRing = m_sqRing;
+		} else {
+			m_cqRing = mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+							m_fd, IORING_OFF_CQ_RING);
+			if (m_cqRing == MAP_FAILED) {
+				teardown();
+				return;
+			}
+		}
+		m_sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+		m_sqes = mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					  m_fd, IORING_OFF_SQES);
+		if (m_sqes == MAP_FAILED) {
+			teardown();
+			return;
+		}
+
+		char * sq = static_cast<char *>(m_sqRing);
+		char * cq = static_cast<char *>(m_cqRing);
+		m_sqTail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+		m_sqMask = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+		m_sqArray = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+		m_sqeArray = static_cast<io_uring_sqe *>(m_sqes);
+		m_sqEntries = p.sq_entries;
+		m_cqHead = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+		m_cqTail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+		m_cqMask = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+		m_cqes = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+	}
+
+	bool probe() {
+		const unsigned ops = 256;
+		std::vector<char> buffer(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op));
+		io_uring_probe * probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+		if (sys_io_uring_register(m_fd, IORING_REGISTER_PROBE, probe, ops) < 0) return false;
+		if (probe->last_op < IORING_OP_WRITE) return false;
+		return (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)
+			&& (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED);
+	}
+
+	void teardown() {
+		if (m_sqes != MAP_FAILED) munmap(m_sqes, m_sqesSize);
+		if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) munmap(m_cqRing, m_cqSize);
+		if (m_sqRing != MAP_FAILED) munmap(m_sqRing, m_sqSize);
+		m_sqes = m_cqRing = m_sqRing = MAP_FAILED;
+		if (m_fd != -1) ::close(m_fd);
+		m_fd = -1;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Move completions from the completion queue into their requests.
+	/// Must be called with the mutex held.
+	///////////////////////////////////////////////////////////////////////////
+	void reap() {
+		unsigned head = *m_cqHead;
+		const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+		if (head == tail) return;
+		for (; head != tail; ++head) {
+			const io_uring_cqe & cqe = m_cqes[head & *m_cqMask];
+			io_uring_request * r = reinterpret_cast<io_uring_request *>(cqe.user_data);
+			r->result = cqe.res;
+			r->done = true;
+			--m_inFlight;
+		}
+		__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+		m_completed.notify_all();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Submit all queued entries to the kernel. Only one thread submits at a
+	/// time; entries queued by other streams while it is in the kernel are
+	/// picked up by its next io_uring_enter, so concurrent streams share
+	/// system calls. Must be called with the mutex held.
+	///////////////////////////////////////////////////////////////////////////
+	void flush(std::unique_lock<std::mutex> & lock) {
+		if (m_submitting) return;
+		m_submitting = true;
+		try {
+			while (m_unsubmitted > 0) {
+				const unsigned n = m_unsubmitted;
+				lock.unlock();
+				int res = sys_io_uring_enter(m_fd, n, 0, 0);
+				int error = errno;
+				lock.lock();
+				if (res >= 0) {
+					m_unsubmitted -= std::min(static_cast<unsigned>(res), n);
+				} else if (error == EAGAIN || error == EBUSY) {
+					wait_for_completion(lock);
+				} else if (error != EINTR) {
+					throw tpie::io_exception(std::string("io_uring_enter: ") + strerror(error));
+				}
+			}
+		} catch (...) {
+			m_submitting = false;
+			throw;
+		}
+		m_submitting = false;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Wait until at least one more request has completed.
+	///////////////////////////////////////////////////////////////////////////
+	void wait_for_completion(std::unique_lock<std::mutex> & lock) {
+		if (m_reaping) {
+			m_completed.wait(lock);
+			return;
+		}
+		m_reaping = true;
+		lock.unlock();
+		int res = sys_io_uring_enter(m_fd, 0, 1, IORING_ENTER_GETEVENTS);
+		int error = errno;
+		lock.lock();
+		m_reaping = false;
+		reap();
+		m_completed.notify_all();
+		if (res < 0 && error != EINTR)
+			throw tpie::io_exception(std::string("io_uring_enter: ") + strerror(error));
+	}
+
+	int m_fd;
+	void * m_sqRing;
+	void * m_cqRing;
+	void * m_sqes;
+	size_t m_sqSize;
+	size_t m_cqSize;
+	size_t m_sqesSize;
+
+	unsigned * m_sqTail;
+	unsigned * m_sqMask;
+	unsigned * m_sqArray;
+	io_uring_sqe * m_sqeArray;
+	unsigned m_sqEntries;
+	unsigned * m_cqHead;
+	unsigned * m_cqTail;
+	unsigned * m_cqMask;
+	io_uring_cqe * m_cqes;
+
+	std::mutex m_mutex;
+	std::condition_variable m_completed;
+	memory_size_type m_inFlight;
+	// Entries queued in the submission ring but not yet passed to the kernel.
+	unsigned m_unsubmitted;
+	// Whether a thread is in flush().
+	bool m_submitting;
+	bool m_reaping;
+	memory_size_type m_reserved;
+};
+
+ring & the_ring() {
+	static ring r;
+	return r;
+}
+
+} // unnamed namespace
+
+namespace tpie {
+namespace file_accessor {
+namespace bits {
+
+bool io_uring_available() {
+	return the_ring().available();
+}
+
+void io_uring_submit(io_uring_request * const * requests, memory_size_type count) {
+	the_ring().submit(requests, count);
+}
+
+void io_uring_wait(io_uring_request & request) {
+	the_ring().wait(request);
+}
+
+bool io_uring_reserve_read_ahead(memory_size_type bytes) {
+	return the_ring().reserve(bytes);
+}
+
+void io_uring_release_read_ahead(memory_size_type bytes) {
+	if (bytes == 0) return;
+	the_ring().release(bytes);
+}
+
+} // namespace bits
+} // namespace file_accessor
+} // namespace tpie
@@ -0,0 +1,152 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file io_uring.h  Linux io_uring file accessor
+///
+/// All io_uring accessors in the process share a single ring. While one
+/// thread is in io_uring_enter submitting, requests queued by other streams
+/// are collected and submitted together by that thread's next call. Each
+/// accessor detects sequential reading and keeps up to
+/// get_io_uring_read_ahead() reads of the same size in flight ahead of the
+/// reader. Positions are tracked in user space, so seeking costs no system
+/// call. If the backend is not selected, or the kernel lacks io_uring, the
+/// accessor behaves exactly like file_accessor::posix.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TPIE_FILE_ACCESSOR_IO_URING_H
+#define TPIE_FILE_ACCESSOR_IO_URING_H
+
+#include <tpie/file_accessor/posix.h>
+#include <tpie/file_accessor/backend.h>
+#include <tpie/array.h>
+#include <vector>
+
+namespace tpie {
+namespace file_accessor {
+
+namespace bits {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A single read or write submitted to the shared ring.
+///
+/// The request must stay at the same address until it has completed.
+///////////////////////////////////////////////////////////////////////////////
+struct io_uring_request {
+	int fd;
+	bool write;
+	void * data;
+	memory_size_type size;
+	stream_size_type offset;
+
+	/** Set by the ring when the request has completed. */
+	bool done;
+	/** Bytes transferred, or a negated errno value. */
+	memory_offset_type result;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Return true if the shared ring could be set up.
+///////////////////////////////////////////////////////////////////////////////
+bool io_uring_available();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Queue a batch of requests on the ring and submit them. If another
+/// thread is submitting, that thread submits these requests as well.
+///////////////////////////////////////////////////////////////////////////////
+void io_uring_submit(io_uring_request * const * requests, memory_size_type count);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Block until the given submitted request has completed.
+///////////////////////////////////////////////////////////////////////////////
+void io_uring_wait(io_uring_request & request);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Reserve bytes of the global read-ahead budget. Returns false if
+/// the budget would be exceeded.
+///////////////////////////////////////////////////////////////////////////////
+bool io_uring_reserve_read_ahead(memory_size_type bytes);
+
+void io_uring_release_read_ahead(memory_size_type bytes);
+
+} // namespace bits
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief io_uring file accessor with sequential read-ahead.
+///////////////////////////////////////////////////////////////////////////////
+
+class io_uring : public posix {
+public:
+	inline io_uring();
+	inline io_uring(const io_uring & other);
+	inline io_uring & operator=(const io_uring & other);
+	inline ~io_uring();
+
+	inline void open_ro(const std::string & path);
+	inline void open_wo(const std::string & path);
+	inline bool try_open_rw(const std::string & path);
+	inline void open_rw_new(const std::string & path);
+
+	inline void read_i(void * data, memory_size_type size);
+	inline void write_i(const void * data, memory_size_type size);
+	inline void seek_i(stream_size_type offset);
+	inline void close_i();
+	inline void truncate_i(stream_size_type bytes);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return true if the open file performs its I/O through the ring.
+	///////////////////////////////////////////////////////////////////////////
+	bool uses_ring() const {return m_ring;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Memory used by the read-ahead buffers of one open file that
+	/// reads readSize bytes at a time.
+	///////////////////////////////////////////////////////////////////////////
+	static inline memory_size_type read_ahead_memory_usage(memory_size_type readSize);
+
+private:
+	struct read_ahead_slot {
+		bits::io_uring_request request;
+		array<char> buffer;
+		bool active;
+
+		read_ahead_slot(): active(false) {}
+	};
+
+	inline void opened();
+	inline void transfer(bool write, void * data, memory_size_type size);
+	inline bool read_from_slots(void * data, memory_size_type size);
+	inline void schedule_read_ahead(memory_size_type size);
+	inline void drop_read_ahead();
+	inline void release_read_ahead();
+
+	bool m_ring;
+	stream_size_type m_position;
+	stream_size_type m_sequentialEnd;
+	std::vector<read_ahead_slot> m_slots;
+	std::vector<bits::io_uring_request *> m_batch;
+	memory_size_type m_reserved;
+};
+
+}
+}
+
+#include <tpie/file_accessor/io_uring.inl>
+
+#endif // TPIE_FILE_ACCESSOR_IO_URING_H
@@ -0,0 +1,285 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/file_accessor/io_uring.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+namespace tpie {
+namespace file_accessor {
+
+io_uring::io_uring()
+	: m_ring(false)
+	, m_position(0)
+	, m_sequentialEnd(0)
+	, m_reserved(0)
+{
+}
+
+// Copies share the file descriptor like posix copies do, but never the
+// read-ahead slots, since the ring holds pointers into them.
+io_uring::io_uring(const io_uring & other)
+	: posix(other)
+	, m_ring(other.m_ring)
+	, m_position(other.m_position)
+	, m_sequentialEnd(other.m_position)
+	, m_reserved(0)
+{
+}
+
+io_uring & io_uring::operator=(const io_uring & other) {
+	if (this == &other) return *this;
+	drop_read_ahead();
+	release_read_ahead();
+	posix::operator=(other);
+	m_ring = other.m_ring;
+	m_position = other.m_position;
+	m_sequentialEnd = other.m_position;
+	return *this;
+}
+
+/*static*/ memory_size_type io_uring::read_ahead_memory_usage(memory_size_type readSize) {
+	if (get_file_accessor_backend() != backend_io_uring) return 0;
+	return get_io_uring_read_ahead() * array<char>::memory_usage(readSize);
+}
+
+io_uring::~io_uring() {
+	drop_read_ahead();
+	release_read_ahead();
+}
+
+void io_uring::open_ro(const std::string & path) {
+	drop_read_ahead();
+	posix::open_ro(path);
+	opened();
+}
+
+void io_uring::open_wo(const std::string & path) {
+	drop_read_ahead();
+	posix::open_wo(path);
+	opened();
+}
+
+bool io_uring::try_open_rw(const std::string & path) {
+	drop_read_ahead();
+	if (!posix::try_open_rw(path)) return false;
+	opened();
+	return true;
+}
+
+void io_uring::open_rw_new(const std::string & path) {
+	drop_read_ahead();
+	posix::open_rw_new(path);
+	opened();
+}
+
+void io_uring::opened() {
+	m_ring = get_file_accessor_backend() == backend_io_uring
+		&& bits::io_uring_available();
+	// The ring reads through the ordinary descriptor and has its own
+	// read-ahead, so direct I/O only applies to the posix fallback.
+	if (m_ring) disable_direct_io();
+	m_position = 0;
+	m_sequentialEnd = 0;
+	const memory_size_type depth = m_ring ? get_io_uring_read_ahead() : 0;
+	if (m_slots.size() != depth) {
+		release_read_ahead();
+		m_slots.clear();
+		m_slots.resize(depth);
+		m_batch.resize(depth);
+	}
+}
+
+void io_uring::read_i(void * data, memory_size_type size) {
+	if (!m_ring) {
+		posix::read_i(data, size);
+		return;
+	}
+	const bool sequential = m_position == m_sequentialEnd;
+	if (!read_from_slots(data, size))
+		transfer(false, data, size);
+	m_position += size;
+	m_sequentialEnd = m_position;
+	increment_bytes_read(size);
+	if (sequential && m_cacheHint != access_random)
+		schedule_read_ahead(size);
+}
+
+void io_uring::write_i(const void * data, memory_size_type size) {
+	if (!m_ring) {
+		posix::write_i(data, size);
+		return;
+	}
+	drop_read_ahead();
+	transfer(true, const_cast<void *>(data), size);
+	m_position += size;
+	increment_bytes_written(size);
+}
+
+void io_uring::seek_i(stream_size_type offset) {
+	if (!m_ring) {
+		posix::seek_i(offset);
+		return;
+	}
+	m_position = offset;
+}
+
+void io_uring::close_i() {
+	drop_read_ahead();
+	release_read_ahead();
+	posix::close_i();
+}
+
+void io_uring::truncate_i(stream_size_type bytes) {
+	drop_read_ahead();
+	posix::truncate_i(bytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Perform a blocking transfer of the given bytes at the current position
+/// through the ring, resubmitting the remainder after short transfers.
+///////////////////////////////////////////////////////////////////////////////
+void io_uring::transfer(bool write, void * data, memory_size_type size) {
+	// The length field of a submission queue entry is 32 bits.
+	const memory_size_type maxChunk = memory_size_type(1) << 30;
+	char * p = static_cast<char *>(data);
+	memory_size_type done = 0;
+	while (done < size) {
+		bits::io_uring_request r;
+		r.fd = m_fd;
+		r.write = write;
+		r.data = p + done;
+		r.size = std::min(size - done, maxChunk);
+		r.offset = m_position + done;
+		bits::io_uring_request * batch = &r;
+		bits::io_uring_submit(&batch, 1);
+		bits::io_uring_wait(r);
+		if (r.result < 0) {
+			errno = static_cast<int>(-r.result);
+			throw_errno();
+		}
+		if (r.result == 0) {
+			std::stringstream ss;
+			ss << "Wrong number of bytes " << (write ? "written" : "read")
+			   << ": Expected " << size << " but got " << done;
+			throw io_exception(ss.str());
+		}
+		done += static_cast<memory_size_type>(r.result);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Serve a read from a read-ahead slot covering the requested range.
+/// Returns false if no slot covers it.
+///////////////////////////////////////////////////////////////////////////////
+bool io_uring::read_from_slots(void * data, memory_size_type size) {
+	for (memory_size_type i = 0; i < m_slots.size(); ++i) {
+		read_ahead_slot & s = m_slots[i];
+		if (!s.active) continue;
+		if (s.request.offset > m_position
+			|| m_position + size > s.request.offset + s.request.size)
+			continue;
+		bits::io_uring_wait(s.request);
+		const stream_size_type valid =
+			s.request.offset + std::max(s.request.result, memory_offset_type(0));
+		if (m_position + size > valid) {
+			// Short or failed read; let the direct read report it.
+			s.active = false;
+			return false;
+		}
+		memcpy(data, s.buffer.get() + (m_position - s.request.offset), size);
+		return true;
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Make sure the next reads of the given size following the current
+/// position are in flight, reusing slots that lie outside that window.
+///////////////////////////////////////////////////////////////////////////////
+void io_uring::schedule_read_ahead(memory_size_type size) {
+	const memory_size_type depth = m_slots.size();
+	if (depth == 0 || size > (memory_size_type(1) << 30)) return;
+	const stream_size_type windowEnd = m_position + depth * size;
+	memory_size_type submitted = 0;
+	for (memory_size_type k = 0; k < depth; ++k) {
+		const stream_size_type offset = m_position + k * size;
+		bool covered = false;
+		read_ahead_slot * reuse = NULL;
+		for (memory_size_type i = 0; i < depth; ++i) {
+			read_ahead_slot & s = m_slots[i];
+			if (s.active && s.request.offset <= offset
+				&& offset + size <= s.request.offset + s.request.size) {
+				covered = true;
+				break;
+			}
+			if (reuse == NULL
+				&& (!s.active
+					|| s.request.offset + s.request.size <= m_position
+					|| s.request.offset >= windowEnd))
+				reuse = &s;
+		}
+		if (covered) continue;
+		if (reuse == NULL) break;
+		if (reuse->active) {
+			bits::io_uring_wait(reuse->request);
+			reuse->active = false;
+		}
+		if (reuse->buffer.size() < size) {
+			const memory_size_type extra = size - reuse->buffer.size();
+			if (!bits::io_uring_reserve_read_ahead(extra)) break;
+			m_reserved += extra;
+			reuse->buffer.resize(size);
+		}
+		bits::io_uring_request & r = reuse->request;
+		r.fd = m_fd;
+		r.write = false;
+		r.data = reuse->buffer.get();
+		r.size = size;
+		r.offset = offset;
+		reuse->active = true;
+		m_batch[submitted++] = &r;
+	}
+	if (submitted > 0)
+		bits::io_uring_submit(m_batch.data(), submitted);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Wait for all outstanding read-ahead and forget its contents.
+///////////////////////////////////////////////////////////////////////////////
+void io_uring::drop_read_ahead() {
+	for (memory_size_type i = 0; i < m_slots.size(); ++i) {
+		read_ahead_slot & s = m_slots[i];
+		if (!s.active) continue;
+		bits::io_uring_wait(s.request);
+		s.active = false;
+	}
+}
+
+void io_uring::release_read_ahead() {
+	for (memory_size_type i = 0; i < m_slots.size(); ++i) {
+		m_slots[i].buffer.resize(0);
+	}
+	bits::io_uring_release_read_ahead(m_reserved);
+	m_reserved = 0;
+}
+
+}
+}
@@ -33,10 +33,20 @@ namespace file_accessor {
 ///////////////////////////////////////////////////////////////////////////////
 
 class posix {
-private:
+protected:
 	int m_fd;
 	cache_hint m_cacheHint;
 
+private:
+	/** Whether the next file opened should use direct I/O. */
+	bool m_requestDirectIO;
+	/** Whether the open file is accessed with pread/pwrite at m_offset. */
+	bool m_positional;
+	/** Descriptor opened with O_DIRECT, or -1. */
+	int m_directFd;
+	/** File position when m_positional is set. */
+	stream_size_type m_offset;
+
 public:
 	inline posix();
 	inline ~posix() {close_i();}
@@ -62,9 +72,45 @@ public:
 
 	inline void set_cache_hint(cache_hint cacheHint);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief The posix accessor keeps no read-ahead buffers of its own.
+	///////////////////////////////////////////////////////////////////////////
+	static memory_size_type read_ahead_memory_usage(memory_size_type) {return 0;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Let the kernel start reading the given range of the file into
+	/// the page cache, so a later read of it does not block on the disk.
+	///////////////////////////////////////////////////////////////////////////
+	inline void prefetch_i(stream_size_type offset, memory_size_type size);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Request direct I/O (O_DIRECT) for files opened from now on.
+	///
+	/// Transfers whose file offset, buffer address and size are multiples of
+	/// direct_io_alignment bypass the page cache. Other transfers, such as
+	/// the stream header and the unaligned tail of a block, use an ordinary
+	/// descriptor to the same file. If the file system rejects O_DIRECT, all
+	/// transfers silently use the ordinary descriptor.
+	///////////////////////////////////////////////////////////////////////////
+	inline void set_direct_io(bool directIO);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return true if the open file has a direct I/O descriptor.
+	///////////////////////////////////////////////////////////////////////////
+	bool direct_io() const {return m_directFd != -1;}
+
+protected:
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Close the direct I/O descriptor of the open file, if any, and
+	/// continue with ordinary I/O.
+	///////////////////////////////////////////////////////////////////////////
+	inline void disable_direct_io();
+
 private:
 	inline void _open(const std::string & path, int flags, mode_t mode);
+	inline void open_direct(const std::string & path, int flags);
 	inline void give_advice();
+	inline void transfer_positional(bool write, char * data, memory_size_type size);
 };
 
 }
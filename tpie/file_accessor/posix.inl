@@ -20,11 +20,13 @@
 #include <string.h>
 #include <tpie/exception.h>
 #include <tpie/file_manager.h>
+#include <tpie/tpie_log.h>
 #include <tpie/file_accessor/posix.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <unistd.h>
 #include <iostream>
 #include <sstream>
 
@@ -42,6 +44,10 @@ void posix::throw_errno(std::string path /*=std::string()*/) {
 posix::posix()
 	: m_fd(-1)
 	, m_cacheHint(access_normal)
+	, m_requestDirectIO(false)
+	, m_positional(false)
+	, m_directFd(-1)
+	, m_offset(0)
 {
 }
 
@@ -49,6 +55,19 @@ inline void posix::set_cache_hint(cache_hint cacheHint) {
 	m_cacheHint = cacheHint;
 }
 
+inline void posix::prefetch_i(stream_size_type offset, memory_size_type size) {
+#ifndef __MACH__
+	::posix_fadvise(m_fd, offset, size, POSIX_FADV_WILLNEED);
+#else
+	unused(offset);
+	unused(size);
+#endif // __MACH__
+}
+
+inline void posix::set_direct_io(bool directIO) {
+	m_requestDirectIO = directIO;
+}
+
 inline void posix::give_advice() {
 #ifndef __MACH__
 	int advice;
@@ -71,6 +90,11 @@ inline void posix::give_advice() {
 }
 
 inline void posix::read_i(void * data, memory_size_type size) {
+	if (m_positional) {
+		transfer_positional(false, static_cast<char *>(data), size);
+		increment_bytes_read(size);
+		return;
+	}
 	memory_offset_type bytesRead = ::read(m_fd, data, size);
 	if (bytesRead == -1)
 		throw_errno();
@@ -83,6 +107,11 @@ inline void posix::read_i(void * data, memory_size_type size) {
 }
 
 inline void posix::write_i(const void * data, memory_size_type size) {
+	if (m_positional) {
+		transfer_positional(true, static_cast<char *>(const_cast<void *>(data)), size);
+		increment_bytes_written(size);
+		return;
+	}
 	do {
 		ssize_t res = ::write(m_fd, data, size);
 		if(res == -1) {
@@ -95,9 +124,53 @@ inline void posix::write_i(const void * data, memory_size_type size) {
 }
 
 inline void posix::seek_i(stream_size_type size) {
+	if (m_positional) {
+		m_offset = size;
+		return;
+	}
 	if (::lseek(m_fd, size, SEEK_SET) == -1) throw_errno();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// The longest prefix of the transfer that satisfies the alignment
+/// requirements goes through the direct descriptor, and the remainder through
+/// the ordinary one. Both descriptors refer to the same file, and the kernel
+/// keeps the page cache coherent with direct transfers.
+///////////////////////////////////////////////////////////////////////////////
+inline void posix::transfer_positional(bool write, char * data, memory_size_type size) {
+	const memory_size_type a = direct_io_alignment;
+	while (size > 0) {
+		memory_size_type n = size;
+		int fd = m_fd;
+		if (m_directFd != -1 && m_offset % a == 0
+			&& reinterpret_cast<size_t>(data) % a == 0 && size >= a) {
+			n = size / a * a;
+			fd = m_directFd;
+		}
+		ssize_t res = write
+			? ::pwrite(fd, data, n, m_offset)
+			: ::pread(fd, data, n, m_offset);
+		if (res == -1) {
+			if (errno == EINTR) continue;
+			if (errno == EINVAL && fd == m_directFd) {
+				// Some file systems accept O_DIRECT on open but not on transfer.
+				disable_direct_io();
+				continue;
+			}
+			throw_errno();
+		}
+		if (res == 0) {
+			std::stringstream ss;
+			ss << "Wrong number of bytes " << (write ? "written" : "read")
+			   << ": " << size << " bytes remained";
+			throw io_exception(ss.str());
+		}
+		data += res;
+		size -= res;
+		m_offset += res;
+	}
+}
+
 inline stream_size_type posix::file_size_i() {
 	struct stat buf;
 	if (::fstat(m_fd, &buf) == -1) throw_errno();
@@ -112,6 +185,31 @@ void posix::_open(const std::string & path, int flags, mode_t mode = 0755) {
 	}
 	get_file_manager().increment_open_file_count();
 	give_advice();
+	m_positional = m_requestDirectIO;
+	m_offset = 0;
+	if (m_positional) open_direct(path, flags & ~(O_CREAT | O_TRUNC));
+}
+
+void posix::open_direct(const std::string & path, int flags) {
+#ifdef O_DIRECT
+	m_directFd = ::open(path.c_str(), flags | O_DIRECT);
+	if (m_directFd == -1) {
+		log_debug() << "Direct I/O not available for " << path << ": "
+					<< strerror(errno) << std::endl;
+		return;
+	}
+	get_file_manager().increment_open_file_count();
+#else
+	unused(path);
+	unused(flags);
+#endif // O_DIRECT
+}
+
+void posix::disable_direct_io() {
+	if (m_directFd == -1) return;
+	::close(m_directFd);
+	get_file_manager().decrement_open_file_count();
+	m_directFd = -1;
 }
 
 void posix::open_wo(const std::string & path) {
@@ -144,6 +242,8 @@ bool posix::is_open() const {
 
 void posix::close_i() {
 	if (m_fd == -1) return;
+	disable_direct_io();
+	m_positional = false;
 	if (::close(m_fd) == -1) throw_errno();
 	get_file_manager().decrement_open_file_count();
 	m_fd = -1;
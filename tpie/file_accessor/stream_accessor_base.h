@@ -30,6 +30,12 @@
 namespace tpie {
 namespace file_accessor {
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Alignment of file offsets, buffer addresses and transfer sizes
+/// required for direct I/O. Stream blocks start on this boundary.
+///////////////////////////////////////////////////////////////////////////////
+const memory_size_type direct_io_alignment = 4096;
+
 template <typename file_accessor_t>
 class stream_accessor_base {
 private:
@@ -88,7 +94,7 @@ protected:
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Returns the boundary on which we align blocks.
 	///////////////////////////////////////////////////////////////////////////
-	inline memory_size_type boundary() const { return 4096; }
+	inline memory_size_type boundary() const { return direct_io_alignment; }
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Given a memory offset, rounds up to the nearest alignment
@@ -131,6 +137,18 @@ public:
 
 	inline void close();
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Request that the next file opened bypasses the operating
+	/// system page cache where the platform and file system allow it.
+	///////////////////////////////////////////////////////////////////////////
+	void set_direct_io(bool directIO) {m_fileAccessor.set_direct_io(directIO);}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return true if the open file performs aligned transfers with
+	/// direct I/O.
+	///////////////////////////////////////////////////////////////////////////
+	bool direct_io() const {return m_fileAccessor.direct_io();}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Read the given number of items from the given block into the
 	/// given buffer.
@@ -64,6 +64,23 @@ public:
 
 	inline void set_cache_hint(cache_hint cacheHint);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief The Win32 accessor keeps no read-ahead buffers of its own.
+	///////////////////////////////////////////////////////////////////////////
+	static memory_size_type read_ahead_memory_usage(memory_size_type) {return 0;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Prefetching is not implemented for Win32.
+	///////////////////////////////////////////////////////////////////////////
+	void prefetch_i(stream_size_type, memory_size_type) {}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Direct I/O is not implemented for Win32; files always use the
+	/// system cache.
+	///////////////////////////////////////////////////////////////////////////
+	void set_direct_io(bool) {}
+	bool direct_io() const {return false;}
+
 private:
 	inline void _open(const std::string & path, DWORD access, DWORD create_mode);
 };
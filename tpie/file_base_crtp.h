@@ -125,6 +125,7 @@ public:
 	void read_user_data(TT & data) {
 		assert(m_open);
 		if (sizeof(TT) != user_data_size()) throw io_exception("Wrong user data size");
+		self().wait_for_io();
 		m_fileAccessor->read_user_data(reinterpret_cast<void*>(&data), sizeof(TT));
 	}
 
@@ -137,6 +138,7 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	memory_size_type read_user_data(void * data, memory_size_type count) {
 		assert(m_open);
+		self().wait_for_io();
 		return m_fileAccessor->read_user_data(data, count);
 	}
 
@@ -152,6 +154,7 @@ public:
 	void write_user_data(const TT & data) {
 		assert(m_open);
 		if (sizeof(TT) > max_user_data_size()) throw io_exception("Wrong user data size");
+		self().wait_for_io();
 		m_fileAccessor->write_user_data(reinterpret_cast<const void*>(&data), sizeof(TT));
 	}
 
@@ -166,6 +169,7 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	void write_user_data(const void * data, memory_size_type count) {
 		assert(m_open);
+		self().wait_for_io();
 		m_fileAccessor->write_user_data(data, count);
 	}
 
@@ -209,6 +213,7 @@ public:
 					 memory_size_type userDataSize=0,
 					 cache_hint cacheHint=access_sequential) {
 		self().close();
+		m_fileAccessor->set_direct_io(m_directIO);
 		self().open_inner(path, accessType, userDataSize, cacheHint);
 	}
 
@@ -221,6 +226,7 @@ public:
 		self().close();
 		m_ownedTempFile.reset(tpie_new<temp_file>());
 		m_tempFile=m_ownedTempFile.get();
+		m_fileAccessor->set_direct_io(m_directIO || m_tempFile->direct_io());
 		self().open_inner(m_tempFile->path(), access_read_write, userDataSize, cacheHint);
 	}
 
@@ -235,9 +241,25 @@ public:
 					 cache_hint cacheHint=access_sequential) {
 		self().close();
 		m_tempFile=&file;
+		m_fileAccessor->set_direct_io(m_directIO || m_tempFile->direct_io());
 		self().open_inner(m_tempFile->path(), accessType, userDataSize, cacheHint);
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Set whether the file is accessed with direct I/O, bypassing
+	/// the operating system page cache. Takes effect when the file is next
+	/// opened. Temporary files also use direct I/O if
+	/// temp_file::direct_io() is set. Where the platform or file system
+	/// does not support it, the file is accessed normally.
+	///////////////////////////////////////////////////////////////////////////
+	void set_direct_io(bool directIO) {
+		m_directIO = directIO;
+	}
+
+	bool get_direct_io() const {
+		return m_directIO;
+	}
+
 	/////////////////////////////////////////////////////////////////////////
 	/// \brief Close the file.
 	///
@@ -293,6 +315,13 @@ protected:
 				   file_accessor::file_accessor * fileAccessor);
 
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Wait for any I/O the child performs in the background before
+	/// the file accessor is used directly. Children with background I/O
+	/// override this.
+	///////////////////////////////////////////////////////////////////////////
+	void wait_for_io() {}
+
 	template <typename BT>
 	void read_block(BT & b, stream_size_type block);
 	void get_block_check(stream_size_type block);
@@ -302,6 +331,7 @@ protected:
 	bool m_canRead;
 	bool m_canWrite;
 	bool m_open;
+	bool m_directIO;
 	memory_size_type m_itemSize;
 	file_accessor::file_accessor * m_fileAccessor;
 	tpie::unique_ptr<temp_file> m_ownedTempFile;
@@ -31,6 +31,7 @@ file_base_crtp<child_t>::file_base_crtp(
 	m_canRead = false;
 	m_canWrite = false;
 	m_open = false;
+	m_directIO = false;
 	if (fileAccessor == 0)
 		fileAccessor = new default_file_accessor();
 	m_fileAccessor = fileAccessor;
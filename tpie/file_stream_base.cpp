@@ -27,6 +27,9 @@ file_stream_base::file_stream_base(memory_size_type itemSize,
 								   double blockFactor,
 								   file_accessor::file_accessor * fileAccessor):
 	file_base_crtp<file_stream_base>(itemSize, blockFactor, fileAccessor)
+	, m_readAhead(0)
+	, m_writeBehind(false)
+	, m_lastBlock(std::numeric_limits<stream_size_type>::max())
 {
 	m_blockStartIndex = 0;
 	m_nextBlock = std::numeric_limits<stream_size_type>::max();
@@ -38,7 +41,147 @@ file_stream_base::file_stream_base(memory_size_type itemSize,
 
 void file_stream_base::get_block(stream_size_type block) {
 	get_block_check(block);
-	read_block(m_block, block);
+	const bool sequential = m_lastBlock == std::numeric_limits<stream_size_type>::max()
+		|| block == m_lastBlock + 1;
+	m_lastBlock = block;
+	if (!take_read_ahead(block)) {
+		// The accessor may only be used directly when no background I/O
+		// is in flight. Blocks past the end are not read, so appending
+		// does not wait for the previous write.
+		if (block * static_cast<stream_size_type>(m_blockItems) < size())
+			wait_for_io();
+		read_block(m_block, block);
+	}
+	if (sequential) schedule_read_ahead(block);
+}
+
+void file_stream_base::allocate_io_buffers() {
+	const memory_size_type bytes = m_blockItems * m_itemSize;
+	const memory_size_type alignment = file_accessor::direct_io_alignment;
+	m_lastBlock = std::numeric_limits<stream_size_type>::max();
+	if (m_canRead && m_readAhead > 0) {
+		m_readAheadBlocks.resize(m_readAhead);
+		for (memory_size_type i = 0; i < m_readAhead; ++i)
+			m_readAheadBlocks[i].block.data = tpie_new_aligned_array<char>(bytes, alignment);
+	}
+	if (m_canWrite && m_writeBehind)
+		m_writeBehindBlock.block.data = tpie_new_aligned_array<char>(bytes, alignment);
+}
+
+void file_stream_base::free_io_buffers() {
+	const memory_size_type bytes = m_blockItems * m_itemSize;
+	for (memory_size_type i = 0; i < m_readAheadBlocks.size(); ++i)
+		tpie_delete_aligned_array(m_readAheadBlocks[i].block.data, bytes);
+	m_readAheadBlocks.resize(0);
+	tpie_delete_aligned_array(m_writeBehindBlock.block.data, bytes);
+	m_writeBehindBlock.block.data = 0;
+}
+
+void file_stream_base::wait_for_io() {
+	for (memory_size_type i = 0; i < m_readAheadBlocks.size(); ++i)
+		discard(m_readAheadBlocks[i]);
+	complete_write_behind();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Hand the dirty block to the I/O thread and continue in the spare buffer.
+/// The caller reloads or resets m_block afterwards, so the stale contents
+/// of the spare buffer are never observed.
+///////////////////////////////////////////////////////////////////////////////
+void file_stream_base::write_behind() {
+	complete_write_behind();
+	buffered_block & b = m_writeBehindBlock;
+	std::swap(b.block.data, m_block.data);
+	b.block.number = m_block.number;
+	b.block.size = m_block.size;
+	stream_io_request & r = b.request;
+	r.accessor = m_fileAccessor;
+	r.write = true;
+	r.data = b.block.data;
+	r.block = b.block.number;
+	r.items = b.block.size;
+	b.pending = true;
+	stream_io_submit(r);
+}
+
+void file_stream_base::complete_write_behind() {
+	buffered_block & b = m_writeBehindBlock;
+	if (!b.pending) return;
+	b.pending = false;
+	stream_io_wait(b.request);
+	if (m_tempFile)
+		m_tempFile->update_recorded_size(m_fileAccessor->byte_size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// If the given block has been read ahead, move it into m_block.
+///////////////////////////////////////////////////////////////////////////////
+bool file_stream_base::take_read_ahead(stream_size_type block) {
+	for (memory_size_type i = 0; i < m_readAheadBlocks.size(); ++i) {
+		buffered_block & b = m_readAheadBlocks[i];
+		if (!b.pending || b.block.number != block) continue;
+		b.pending = false;
+		stream_io_wait(b.request);
+		std::swap(b.block.data, m_block.data);
+		m_block.number = b.block.number;
+		m_block.size = b.block.size;
+		m_block.dirty = false;
+		return true;
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Start reading the blocks following the given block that are not already
+/// being read, reusing buffers of blocks outside that window.
+///////////////////////////////////////////////////////////////////////////////
+void file_stream_base::schedule_read_ahead(stream_size_type block) {
+	const memory_size_type depth = m_readAheadBlocks.size();
+	for (memory_size_type k = 1; k <= depth; ++k) {
+		const stream_size_type next = block + k;
+		const stream_size_type first = next * static_cast<stream_size_type>(m_blockItems);
+		if (first >= size()) break;
+		buffered_block * reuse = 0;
+		bool pending = false;
+		for (memory_size_type i = 0; i < depth; ++i) {
+			buffered_block & b = m_readAheadBlocks[i];
+			if (b.pending && b.block.number == next) {
+				pending = true;
+				break;
+			}
+			if (reuse == 0 && (!b.pending || b.block.number <= block
+							   || b.block.number > block + depth))
+				reuse = &b;
+		}
+		if (pending) continue;
+		if (reuse == 0) break;
+		discard(*reuse);
+		reuse->block.number = next;
+		reuse->block.size = static_cast<memory_size_type>(
+			std::min(static_cast<stream_size_type>(m_blockItems), size() - first));
+		reuse->block.dirty = false;
+		stream_io_request & r = reuse->request;
+		r.accessor = m_fileAccessor;
+		r.write = false;
+		r.data = reuse->block.data;
+		r.block = next;
+		r.items = reuse->block.size;
+		reuse->pending = true;
+		stream_io_submit(r);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// Wait for a block read ahead and forget it. Errors are ignored, since the
+/// block was never requested by the user.
+///////////////////////////////////////////////////////////////////////////////
+void file_stream_base::discard(buffered_block & b) {
+	if (!b.pending) return;
+	b.pending = false;
+	try {
+		stream_io_wait(b.request);
+	} catch (const exception &) {
+	}
 }
 
 void file_stream_base::update_block_core() {
@@ -26,6 +26,8 @@
 
 #include <tpie/file_base_crtp.h>
 #include <tpie/stream_crtp.h>
+#include <tpie/stream_io_thread.h>
+#include <tpie/array.h>
 #include <algorithm>
 namespace tpie {
 
@@ -49,12 +51,59 @@ public:
 	/// This will close the file and resources used by buffers and such.
 	/////////////////////////////////////////////////////////////////////////
 	inline void close() {
-		if (m_open) flush_block();
-		tpie_delete_array(m_block.data, m_itemSize * m_blockItems);
+		if (m_open) {
+			flush_block();
+			wait_for_io();
+		}
+		tpie_delete_aligned_array(m_block.data, m_itemSize * m_blockItems);
 		m_block.data = 0;
+		free_io_buffers();
 		p_t::close();
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Set the number of blocks to read ahead of a sequential reader.
+	///
+	/// When the stream moves from one block to the next, the following
+	/// blocks are read by the stream I/O thread while the current block is
+	/// being processed. Each block read ahead costs an extra block buffer;
+	/// pass the same value to memory_usage(). Takes effect when the stream
+	/// is next opened. The default is zero, meaning blocks are read on
+	/// demand.
+	///////////////////////////////////////////////////////////////////////////
+	void set_read_ahead(memory_size_type blocks) {
+		m_readAhead = blocks;
+	}
+
+	memory_size_type get_read_ahead() const {
+		return m_readAhead;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Enable or disable asynchronous writing of full blocks.
+	///
+	/// With write-behind, a dirty block is handed to the stream I/O thread
+	/// and the stream continues in a second block buffer. Takes effect when
+	/// the stream is next opened. Disabled by default.
+	///////////////////////////////////////////////////////////////////////////
+	void set_write_behind(bool enabled) {
+		m_writeBehind = enabled;
+	}
+
+	bool get_write_behind() const {
+		return m_writeBehind;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Amount of memory used by the extra buffers for the given
+	/// read-ahead and write-behind settings.
+	///////////////////////////////////////////////////////////////////////////
+	static inline memory_size_type io_buffers_memory_usage(
+		float blockFactor, memory_size_type readAhead, bool writeBehind) noexcept {
+		return (readAhead + (writeBehind ? 1 : 0)) * block_memory_usage(blockFactor)
+			+ readAhead * sizeof(buffered_block);
+	}
+
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \copydoc file_base::truncate()
@@ -66,6 +115,7 @@ public:
 	inline void truncate(stream_size_type size) {
 		stream_size_type o=offset();
 		flush_block();
+		wait_for_io();
 		m_block.number = std::numeric_limits<stream_size_type>::max();
 		m_nextBlock = std::numeric_limits<stream_size_type>::max();
 		m_nextIndex = std::numeric_limits<memory_size_type>::max();
@@ -88,6 +138,8 @@ protected:
 
 	void swap(file_stream_base & other) {
 		using std::swap;
+		wait_for_io();
+		other.wait_for_io();
 		swap(m_index,           other.m_index);
 		swap(m_nextBlock,       other.m_nextBlock);
 		swap(m_nextIndex,       other.m_nextIndex);
@@ -99,6 +151,7 @@ protected:
 		swap(m_canWrite,        other.m_canWrite);
 		swap(m_itemSize,        other.m_itemSize);
 		swap(m_open,            other.m_open);
+		swap(m_directIO,        other.m_directIO);
 		swap(m_fileAccessor,    other.m_fileAccessor);
 		swap(m_block.size,      other.m_block.size);
 		swap(m_block.number,    other.m_block.number);
@@ -106,6 +159,11 @@ protected:
 		swap(m_block.data,      other.m_block.data);
 		swap(m_ownedTempFile,   other.m_ownedTempFile);
 		swap(m_tempFile,        other.m_tempFile);
+		swap(m_readAhead,       other.m_readAhead);
+		swap(m_writeBehind,     other.m_writeBehind);
+		swap(m_lastBlock,       other.m_lastBlock);
+		m_readAheadBlocks.swap(other.m_readAheadBlocks);
+		swap(m_writeBehindBlock.block.data, other.m_writeBehindBlock.block.data);
 	}
 
 	inline void open_inner(const std::string & path,
@@ -122,7 +180,9 @@ protected:
 		m_block.size = 0;
 		m_block.number = std::numeric_limits<stream_size_type>::max();
 		m_block.dirty = false;
-		m_block.data = tpie_new_array<char>(m_blockItems * m_itemSize);
+		m_block.data = tpie_new_aligned_array<char>(
+			m_blockItems * m_itemSize, file_accessor::direct_io_alignment);
+		allocate_io_buffers();
 
 		initialize();
 		seek(0);
@@ -140,13 +200,24 @@ protected:
 		if (m_block.dirty) {
 			assert(m_canWrite);
 			update_vars();
-			m_fileAccessor->write_block(m_block.data, m_block.number, m_block.size);
-			if (m_tempFile)
-				m_tempFile->update_recorded_size(m_fileAccessor->byte_size());
+			if (m_writeBehindBlock.block.data != 0) {
+				write_behind();
+			} else {
+				wait_for_io();
+				m_fileAccessor->write_block(m_block.data, m_block.number, m_block.size);
+				if (m_tempFile)
+					m_tempFile->update_recorded_size(m_fileAccessor->byte_size());
+			}
 		}
 		m_block.dirty = false;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Wait for outstanding read-ahead and write-behind, so the file
+	/// accessor may be used directly. Blocks read ahead are discarded.
+	///////////////////////////////////////////////////////////////////////////
+	void wait_for_io();
+
 	inline void update_vars() {
 		if (m_block.dirty && m_index != std::numeric_limits<memory_size_type>::max()) {
 			assert(m_index <= m_blockItems);
@@ -168,6 +239,31 @@ protected:
 	block_t m_block;
 
 private:
+	struct buffered_block {
+		block_t block;
+		stream_io_request request;
+		bool pending;
+
+		buffered_block(): pending(false) {
+			block.data = 0;
+		}
+	};
+
+	void allocate_io_buffers();
+	void free_io_buffers();
+	void write_behind();
+	void complete_write_behind();
+	bool take_read_ahead(stream_size_type block);
+	void schedule_read_ahead(stream_size_type block);
+	void discard(buffered_block & b);
+
+	memory_size_type m_readAhead;
+	bool m_writeBehind;
+	/** Number of the block most recently fetched by get_block(). */
+	stream_size_type m_lastBlock;
+	array<buffered_block> m_readAheadBlocks;
+	buffered_block m_writeBehindBlock;
+
 	friend class stream_crtp<file_stream_base>;
 	file_stream_base & get_file() {return *this;}
 	const file_stream_base & get_file() const {return *this;}
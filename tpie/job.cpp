@@ -19,15 +19,84 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 /// \file job.cpp Job methods and job manager.
+///
+/// Every worker thread owns a queue of jobs. A worker pushes the jobs it
+/// enqueues onto the back of its own queue and takes its next job from the
+/// back as well, so it continues with the job it spawned most recently.
+/// Threads outside the pool enqueue into a shared queue. An idle worker
+/// first empties its own queue, then the shared queue, and then steals the
+/// oldest job from the front of another worker's queue. A thread waiting in
+/// job::join() runs queued jobs until the job it waits for is done.
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <tpie/job.h>
 #include <tpie/array.h>
-#include <tpie/internal_queue.h>
 #include <tpie/exception.h>
+#include <atomic>
 #include <functional>
 #include <thread>
 namespace tpie {
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Bounded double-ended queue of jobs guarded by its own mutex.
+///////////////////////////////////////////////////////////////////////////////
+class job_deque {
+public:
+	static const size_t capacity = 256;
+
+	job_deque() : m_jobs(capacity), m_first(0), m_size(0) {}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Add a job at the back.
+	/// \return false if the queue is full.
+	///////////////////////////////////////////////////////////////////////////
+	bool push_back(job * j) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_size == capacity) return false;
+		m_jobs[(m_first + m_size) % capacity] = j;
+		++m_size;
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Remove the newest job, or return 0 if the queue is empty.
+	///////////////////////////////////////////////////////////////////////////
+	job * pop_back() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_size == 0) return 0;
+		--m_size;
+		return m_jobs[(m_first + m_size) % capacity];
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Remove the oldest job, or return 0 if the queue is empty.
+	///////////////////////////////////////////////////////////////////////////
+	job * pop_front() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_size == 0) return 0;
+		job * j = m_jobs[m_first];
+		m_first = (m_first + 1) % capacity;
+		--m_size;
+		return j;
+	}
+
+private:
+	std::mutex m_mutex;
+	tpie::array<job *> m_jobs;
+	size_t m_first;
+	size_t m_size;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Index of the worker running on this thread, or no_worker for threads
+/// outside the pool.
+///////////////////////////////////////////////////////////////////////////////
+const size_t no_worker = static_cast<size_t>(-1);
+thread_local size_t this_worker = no_worker;
+
+} // unnamed namespace
  
 ///////////////////////////////////////////////////////////////////////////////
 /// Job manager singleton.
@@ -41,15 +110,22 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Default constructor.
 	///////////////////////////////////////////////////////////////////////////
-	job_manager() : m_jobs(128), m_kill_job_pool(false) {}
+	job_manager()
+		: m_pending(0)
+		, m_sleepers(0)
+		, m_joiners(0)
+		, m_kill_job_pool(false)
+	{
+	}
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Initialize the thread pool.
 	///////////////////////////////////////////////////////////////////////////
 	void init_pool(size_t threads) {
+		m_queues.resize(threads);
 		m_thread_pool.resize(threads);
 		for (size_t i = 0; i < threads; ++i) {
-			std::function<void()> f(worker);
+			std::function<void()> f(std::bind(worker, i));
 			std::thread t(f);
 			// thread is move-constructible
 			m_thread_pool[i].swap(t);
@@ -60,9 +136,9 @@ public:
 	/// \brief Notify all waiting workers, wait for them to quit.
 	///////////////////////////////////////////////////////////////////////////
 	void shutdown_pool() {
-		std::unique_lock<std::mutex> lock(jobs_mutex);
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
 		m_kill_job_pool = true;
-		m_has_data.notify_all();
+		m_wakeup.notify_all();
 		lock.unlock();
 		for (size_t i = 0; i < m_thread_pool.size(); ++i) {
 			m_thread_pool[i].join();
@@ -71,36 +147,124 @@ public:
 
 private:
 
-	tpie::internal_queue<tpie::job *> m_jobs;
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Queue of each worker thread.
+	///////////////////////////////////////////////////////////////////////////
+	tpie::array<job_deque> m_queues;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Queue of jobs enqueued outside the pool.
+	///////////////////////////////////////////////////////////////////////////
+	job_deque m_shared;
+
 	tpie::array<std::thread> m_thread_pool;
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief The only mutex we will ever need.
+	/// \brief Upper bound on the number of queued jobs.
 	///////////////////////////////////////////////////////////////////////////
-	std::mutex jobs_mutex;
+	std::atomic<size_t> m_pending;
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief Notified when a job is added to the queue.
+	/// \brief Number of threads blocked on m_wakeup, and how many of them
+	/// are waiting in job::join().
 	///////////////////////////////////////////////////////////////////////////
-	std::condition_variable m_has_data;
+	std::atomic<size_t> m_sleepers;
+	std::atomic<size_t> m_joiners;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Guards sleeping on m_wakeup. Queue operations never take it,
+	/// and it is only locked to wake threads that are known to be asleep.
+	///////////////////////////////////////////////////////////////////////////
+	std::mutex m_sleep_mutex;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Notified when a job is added to a queue, when a job is done
+	/// while a thread is joining, and on shutdown.
+	///////////////////////////////////////////////////////////////////////////
+	std::condition_variable m_wakeup;
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief True when the workers should quit ASAP.
 	///////////////////////////////////////////////////////////////////////////
-	bool m_kill_job_pool;
+	std::atomic<bool> m_kill_job_pool;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Add a job to the queue of the calling worker, or to the shared
+	/// queue when called from outside the pool.
+	/// \return false if the queue is full.
+	///////////////////////////////////////////////////////////////////////////
+	bool push(job * j) {
+		job_deque & q = (this_worker == no_worker) ? m_shared : m_queues[this_worker];
+		// Count the job before it becomes visible so m_pending never
+		// underestimates the number of queued jobs.
+		++m_pending;
+		if (!q.push_back(j)) {
+			--m_pending;
+			return false;
+		}
+		if (m_sleepers > 0) {
+			std::lock_guard<std::mutex> lock(m_sleep_mutex);
+			m_wakeup.notify_one();
+		}
+		return true;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Take the newest job of our own queue, the oldest job of the
+	/// shared queue or the oldest job of another worker, in that order.
+	/// \return The job, or 0 if every queue is empty.
+	///////////////////////////////////////////////////////////////////////////
+	job * take() {
+		if (m_pending == 0) return 0;
+		job * j = 0;
+		if (this_worker != no_worker) j = m_queues[this_worker].pop_back();
+		if (!j) j = m_shared.pop_front();
+		const size_t n = m_queues.size();
+		const size_t start = (this_worker == no_worker) ? 0 : this_worker + 1;
+		for (size_t i = 0; !j && i < n; ++i) {
+			j = m_queues[(start + i) % n].pop_front();
+		}
+		if (j) --m_pending;
+		return j;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Block until a job may be available, the pool is shut down or,
+	/// if waiting_for is not 0, that job is done.
+	///////////////////////////////////////////////////////////////////////////
+	void sleep(job * waiting_for) {
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
+		// Announce ourselves before checking the conditions; push() and
+		// job_done() check m_sleepers and m_joiners after changing them.
+		++m_sleepers;
+		if (waiting_for) ++m_joiners;
+		while (m_pending == 0 && !m_kill_job_pool
+			   && !(waiting_for && waiting_for->is_done())) {
+			m_wakeup.wait(lock);
+		}
+		if (waiting_for) --m_joiners;
+		--m_sleepers;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Called when a job and its subjobs are done to wake joiners.
+	///////////////////////////////////////////////////////////////////////////
+	void job_done() {
+		if (m_joiners == 0) return;
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_wakeup.notify_all();
+	}
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Worker thread entry point.
 	///////////////////////////////////////////////////////////////////////////
-	static void worker() {
-		for (;;) {
-			std::unique_lock<std::mutex> lock(the_job_manager->jobs_mutex);
-			while (the_job_manager->m_jobs.empty() && !the_job_manager->m_kill_job_pool) the_job_manager->m_has_data.wait(lock);
-			if (the_job_manager->m_kill_job_pool) break;
-			tpie::job * j = the_job_manager->m_jobs.front();
-			the_job_manager->m_jobs.pop();
-			lock.unlock();
-			j->run();
+	static void worker(size_t index) {
+		this_worker = index;
+		job_manager & m = *the_job_manager;
+		while (!m.m_kill_job_pool) {
+			tpie::job * j = m.take();
+			if (j) j->run();
+			else m.sleep(0);
 		}
 	};
 
@@ -133,14 +297,15 @@ job::job()
 }
 
 void job::join() {
-	std::unique_lock<std::mutex> lock(the_job_manager->jobs_mutex);
-	while (m_dependencies) {
-		m_done.wait(lock);
+	while (!is_done()) {
+		job * j = the_job_manager->take();
+		if (j) j->run();
+		else the_job_manager->sleep(this);
 	}
 }
 
 bool job::is_done() {
-	std::lock_guard<std::mutex> lock(the_job_manager->jobs_mutex);
+	std::lock_guard<std::mutex> lock(m_mutex);
 	return !m_dependencies;
 }
 
@@ -150,18 +315,17 @@ void job::enqueue(job * parent) {
 
 	m_state = job_enqueued;
 
-	std::unique_lock<std::mutex> lock(the_job_manager->jobs_mutex);
 	if (the_job_manager->m_kill_job_pool) throw job_manager_exception();
 	m_parent = parent;
-	m_dependencies = 1;
-	if (m_parent) ++m_parent->m_dependencies;
-	if (the_job_manager->m_jobs.full()) {
-		lock.unlock();
-		run();
-		return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_dependencies = 1;
 	}
-	the_job_manager->m_jobs.push(this);
-	the_job_manager->m_has_data.notify_one();
+	if (m_parent) {
+		std::lock_guard<std::mutex> lock(m_parent->m_mutex);
+		++m_parent->m_dependencies;
+	}
+	if (!the_job_manager->push(this)) run();
 }
 
 void job::run() {
@@ -171,23 +335,28 @@ void job::run() {
 	m_state = job_running;
 
 	(*this)();
-	std::lock_guard<std::mutex> lock(the_job_manager->jobs_mutex);
 	done();
 }
 
 void job::done() {
-	if (m_state != job_running)
-		throw tpie::exception("Bad job state");
-
-	--m_dependencies;
-	if (m_dependencies) return;
-
-	m_state = job_idle;
+	job * parent;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_state != job_running)
+			throw tpie::exception("Bad job state");
+
+		--m_dependencies;
+		if (m_dependencies) return;
+
+		m_state = job_idle;
+		parent = m_parent;
+		// A joiner may destroy this job as soon as the lock is released,
+		// so on_done() runs first and only the parent is touched after.
+		on_done();
+	}
 
-	if (m_parent) m_parent->done();
-	m_done.notify_all();
-	on_done();
+	if (parent) parent->done();
+	the_job_manager->job_done();
 }
 
 } // namespace tpie
-
@@ -26,6 +26,7 @@
 
 #include <stddef.h>
 #include <condition_variable>
+#include <mutex>
 #include <tpie/types.h>
 
 namespace tpie {
@@ -53,6 +54,8 @@ public:
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Wait for this job and its subjobs to complete.
+	///
+	/// While waiting, the calling thread runs other enqueued jobs.
 	///////////////////////////////////////////////////////////////////////////
 	void join();
 
@@ -89,15 +92,15 @@ private:
 	job_state m_state;
 
 	///////////////////////////////////////////////////////////////////////////
-	/// \brief Notified when this job and subjobs are done.
+	/// \brief Guards m_dependencies.
 	///////////////////////////////////////////////////////////////////////////
-	std::condition_variable m_done;
+	std::mutex m_mutex;
 
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief Called when this job or a subjob is done.
 	///
-	/// Decrement m_dependencies and call on_done() and notify
-	/// waiters, if applicable.
+	/// Decrement m_dependencies and call on_done() and notify the parent
+	/// and waiters, if applicable.
 	///////////////////////////////////////////////////////////////////////////
 	void done();
 
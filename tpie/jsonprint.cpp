@@ -37,9 +37,7 @@ public:
 	bool pretty;
 	std::vector<item> stack;
 
-	JSONReflectorP(std::ostream & o, bool pretty): o(o), pretty(pretty) {
-		this->pretty = true;
-	}
+	JSONReflectorP(std::ostream & o, bool pretty): o(o), pretty(pretty) {}
 	
 	void next(bool name) {
 		if (!name && !stack.back().array) return;
@@ -73,7 +71,7 @@ public:
 
 	void name(const char * name) {
 		next(true);
-		o << name << ": ";
+		o << '"' << name << "\": ";
 	}
 
 	template <typename T>
@@ -84,7 +82,23 @@ public:
 	
 	void value(const std::string & v) {
 		next(false);
-		o << '"' << v << '"';
+		o << '"';
+		for (char c : v) {
+			switch (c) {
+			case '"': o << "\\\""; break;
+			case '\\': o << "\\\\"; break;
+			case '\n': o << "\\n"; break;
+			case '\t': o << "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					const char * hex = "0123456789abcdef";
+					o << "\\u00" << hex[c >> 4] << hex[c & 15];
+				} else {
+					o << c;
+				}
+			}
+		}
+		o << '"';
 	}
 
 };
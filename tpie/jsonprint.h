@@ -63,6 +63,9 @@ public:
 	bool operator()(const float & v) {writeDouble(v); return true;}
 	bool operator()(const double & v) {writeDouble(v); return true;}
 	bool operator()(const std::string & v) {writeString(v); return true;}
+
+	template <typename T>
+	bool apply(const T & v) {return reflect(*this, v);}
 private:
 	void writeUint(uint64_t v);
 	void writeInt(int64_t v);
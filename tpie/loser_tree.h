@@ -0,0 +1,209 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_LOSER_TREE_H__
+#define __TPIE_LOSER_TREE_H__
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file loser_tree.h
+/// \brief Tournament tree for k-way merging.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/array.h>
+#include <tpie/util.h>
+#include <tpie/tpie_assert.h>
+#include <functional>
+
+namespace tpie {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \class loser_tree
+/// \brief Tree of losers over a fixed number of sorted sources.
+///
+/// Each source contributes its current item. The tree keeps the smallest
+/// current item (according to pred) at the top, and each internal node
+/// remembers the source that lost the comparison at that node. Replacing the
+/// top item with the next item from the same source replays a single
+/// leaf-to-root path with exactly one comparison per level, whereas a binary
+/// heap spends up to two comparisons per level in its sift-down.
+///
+/// Usage: resize() to the number of sources, unsafe_set() the first item of
+/// every non-empty source, make_safe(), and then repeatedly read top() and
+/// top_index() followed by replace_top() or pop().
+///////////////////////////////////////////////////////////////////////////////
+template <typename T, typename pred_t = std::less<T> >
+class loser_tree: public linear_memory_base<loser_tree<T, pred_t> > {
+public:
+	typedef memory_size_type size_type;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Construct an empty tree with no sources.
+	///////////////////////////////////////////////////////////////////////////
+	loser_tree(pred_t pred = pred_t(),
+			   memory_bucket_ref bucket = memory_bucket_ref())
+		: m_items(bucket)
+		, m_live(bucket)
+		, m_losers(bucket)
+		, m_winner(0)
+		, m_size(0)
+		, m_pred(pred)
+	{
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Reset the tree to k sources which are all exhausted.
+	///////////////////////////////////////////////////////////////////////////
+	void resize(size_type k) {
+		m_items.resize(k);
+		m_live.resize(k, false);
+		m_losers.resize(k, 0);
+		m_winner = 0;
+		m_size = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Set the current item of source i, possibly destroying the
+	/// tournament. Call make_safe() before querying the tree.
+	///////////////////////////////////////////////////////////////////////////
+	void unsafe_set(size_type i, const T & v) {
+		tp_assert(i < m_items.size(), "Source index out of range");
+		m_items[i] = v;
+		if (!m_live[i]) { m_live[i] = true; ++m_size; }
+	}
+
+	void unsafe_set(size_type i, T && v) {
+		tp_assert(i < m_items.size(), "Source index out of range");
+		m_items[i] = std::move(v);
+		if (!m_live[i]) { m_live[i] = true; ++m_size; }
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Play the whole tournament after a sequence of unsafe_set().
+	///////////////////////////////////////////////////////////////////////////
+	void make_safe() {
+		if (m_items.size() == 0) return;
+		m_winner = build(1);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return true if every source is exhausted.
+	///////////////////////////////////////////////////////////////////////////
+	bool empty() const {return m_size == 0;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return the number of sources that are not exhausted.
+	///////////////////////////////////////////////////////////////////////////
+	size_type size() const {return m_size;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return the smallest current item.
+	///////////////////////////////////////////////////////////////////////////
+	const T & top() const {return m_items[m_winner];}
+
+	T & top() {return m_items[m_winner];}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return the source of the smallest current item.
+	///////////////////////////////////////////////////////////////////////////
+	size_type top_index() const {return m_winner;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Replace the top item with the next item of the same source.
+	///////////////////////////////////////////////////////////////////////////
+	void replace_top(const T & v) {
+		tp_assert(!empty(), "replace_top() on empty loser_tree");
+		m_items[m_winner] = v;
+		replay(m_winner);
+	}
+
+	void replace_top(T && v) {
+		tp_assert(!empty(), "replace_top() on empty loser_tree");
+		m_items[m_winner] = std::move(v);
+		replay(m_winner);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Mark the source of the top item as exhausted.
+	///////////////////////////////////////////////////////////////////////////
+	void pop() {
+		tp_assert(!empty(), "pop() on empty loser_tree");
+		m_live[m_winner] = false;
+		--m_size;
+		replay(m_winner);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \copybrief linear_memory_structure_doc::memory_coefficient()
+	/// \copydetails linear_memory_structure_doc::memory_coefficient()
+	///////////////////////////////////////////////////////////////////////////
+	static constexpr double memory_coefficient() noexcept {
+		return array<T>::memory_coefficient()
+			+ array<bool>::memory_coefficient()
+			+ array<size_type>::memory_coefficient();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \copybrief linear_memory_structure_doc::memory_overhead()
+	/// \copydetails linear_memory_structure_doc::memory_overhead()
+	///////////////////////////////////////////////////////////////////////////
+	static constexpr double memory_overhead() noexcept {
+		return array<T>::memory_overhead() - sizeof(array<T>)
+			+ array<bool>::memory_overhead() - sizeof(array<bool>)
+			+ array<size_type>::memory_overhead() - sizeof(array<size_type>)
+			+ sizeof(loser_tree);
+	}
+
+private:
+	// Does source a win over source b? Exhausted sources lose to everything.
+	bool wins(size_type a, size_type b) {
+		if (!m_live[a]) return false;
+		if (!m_live[b]) return true;
+		return m_pred(m_items[a], m_items[b]);
+	}
+
+	// Leaves are the nodes k..2k-1, internal nodes are 1..k-1.
+	size_type build(size_type node) {
+		const size_type k = m_items.size();
+		if (node >= k) return node - k;
+		size_type l = build(2*node);
+		size_type r = build(2*node+1);
+		if (wins(r, l)) std::swap(l, r);
+		m_losers[node] = r;
+		return l;
+	}
+
+	void replay(size_type source) {
+		size_type w = source;
+		for (size_type node = (source + m_items.size()) / 2; node > 0; node /= 2) {
+			if (wins(m_losers[node], w)) std::swap(m_losers[node], w);
+		}
+		m_winner = w;
+	}
+
+	array<T> m_items;
+	array<bool> m_live;
+	array<size_type> m_losers;
+	size_type m_winner;
+	size_type m_size;
+	pred_t m_pred;
+};
+
+} // namespace tpie
+
+#endif // __TPIE_LOSER_TREE_H__
@@ -24,6 +24,10 @@
 #include "tpie_log.h"
 #include <cstring>
 #include <cstdlib>
+#include <new>
+#ifdef WIN32
+#include <malloc.h>
+#endif
 #include "pretty_print.h"
 
 namespace tpie {
@@ -194,6 +198,26 @@ memory_manager & get_memory_manager() {
 	return * mm;
 }
 
+void * __allocate_aligned(size_t bytes, size_t alignment) {
+	if (bytes == 0) bytes = 1;
+#ifdef WIN32
+	void * p = _aligned_malloc(bytes, alignment);
+	if (p == 0) throw std::bad_alloc();
+#else
+	void * p;
+	if (posix_memalign(&p, alignment, bytes) != 0) throw std::bad_alloc();
+#endif
+	return p;
+}
+
+void __deallocate_aligned(void * p) throw() {
+#ifdef WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
 size_t consecutive_memory_available(size_t granularity) {
 	std::pair<uint8_t *, size_t> r = get_memory_manager().__allocate_consecutive(0, granularity);
 	tpie_delete_array(r.first, r.second);
@@ -323,6 +323,52 @@ inline void tpie_delete_array(T * a, size_t size) throw() {
 	delete[] a;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// \internal
+/// Allocate and free uninitialized memory aligned to a power of two.
+///////////////////////////////////////////////////////////////////////////////
+void * __allocate_aligned(size_t bytes, size_t alignment);
+void __deallocate_aligned(void * p) throw();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Allocate an array of trivial elements whose address is a multiple
+/// of the given alignment, and register its memory usage with TPIE.
+///
+/// Only the requested size is registered, not any padding the system
+/// allocator adds to satisfy the alignment.
+///
+/// \param size The number of elements.
+/// \param alignment A power of two, at least sizeof(void *).
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline T * tpie_new_aligned_array(size_t size, size_t alignment) {
+	static_assert(std::is_trivial<T>::value, "Aligned arrays must have trivial elements");
+	get_memory_manager().register_allocation(sizeof(T) * size);
+	void * p;
+	try {
+		p = __allocate_aligned(sizeof(T) * size, alignment);
+	} catch (...) {
+		get_memory_manager().register_deallocation(sizeof(T) * size);
+		throw;
+	}
+	__register_pointer(p, sizeof(T) * size, typeid(T));
+	return static_cast<T *>(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Delete an array allocated with tpie_new_aligned_array.
+/// \param a The array to delete.
+/// \param size The size of the array in elements as passed to
+/// tpie_new_aligned_array.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+inline void tpie_delete_aligned_array(T * a, size_t size) throw() {
+	if (a == 0) return;
+	get_memory_manager().register_deallocation(sizeof(T) * size);
+	__unregister_pointer(a, sizeof(T) * size, typeid(T) );
+	__deallocate_aligned(a);
+}
+
 struct tpie_deleter {
 	template <typename T>
 	void operator()(T * t) {
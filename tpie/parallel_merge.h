@@ -0,0 +1,333 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_PARALLEL_MERGE_H__
+#define __TPIE_PARALLEL_MERGE_H__
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file parallel_merge.h
+/// \brief k-way merging of key ranges on the job pool.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/array.h>
+#include <tpie/job.h>
+#include <tpie/loser_tree.h>
+#include <tpie/util.h>
+#include <tpie/tpie_assert.h>
+#include <algorithm>
+
+namespace tpie {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \class parallel_merge_buffer
+/// \brief Merge k sorted sources in batches, merging independent key ranges
+/// of each batch concurrently.
+///
+/// Up to a fixed number of items of every source are kept in memory. A batch
+/// consists of every buffered item that is not greater than the smallest
+/// last buffered item among the sources that are not yet exhausted, since no
+/// unread item can precede it. The batch is split into key ranges by
+/// splitters sampled from the buffered items; each range is merged into its
+/// own slice of the output buffer, the first range by the calling thread and
+/// the rest by jobs on the job pool. The output buffer is then consumed in
+/// order through top() and pop().
+///
+/// A source type must provide bool can_read(size_t i) and T read(size_t i)
+/// for the sources i = 0, 1, ..., k-1.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T, typename pred_t>
+class parallel_merge_buffer {
+public:
+	typedef memory_size_type size_type;
+
+	parallel_merge_buffer(pred_t pred,
+						  memory_bucket_ref bucket = memory_bucket_ref())
+		: m_pred(pred)
+		, m_bucket(bucket)
+		, m_input(bucket)
+		, m_output(bucket)
+		, m_begin(bucket)
+		, m_end(bucket)
+		, m_more(bucket)
+		, m_cuts(bucket)
+		, m_partOffset(bucket)
+		, m_samples(bucket)
+		, m_jobs(bucket)
+		, m_sources(0)
+		, m_bufferItems(default_buffer_items())
+		, m_parts(1)
+		, m_outBegin(0)
+		, m_outEnd(0)
+	{
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Default number of items buffered from every source: 64 KiB
+	/// worth of items, but at least 16.
+	///////////////////////////////////////////////////////////////////////////
+	static constexpr size_type default_buffer_items() noexcept {
+		return sizeof(T) >= 64*1024/16 ? 16 : 64*1024/sizeof(T);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Prepare for merging the given number of sources using up to the
+	/// given number of threads, buffering bufferItems items of every source.
+	/// Nothing is read until fill() is called.
+	///////////////////////////////////////////////////////////////////////////
+	void resize(size_type sources, size_type threads,
+				size_type bufferItems = default_buffer_items()) {
+		if (threads == 0) threads = 1;
+		m_sources = sources;
+		m_bufferItems = std::max<size_type>(bufferItems, 1);
+		m_parts = threads;
+		m_input.resize(sources * m_bufferItems);
+		m_output.resize(sources * m_bufferItems);
+		m_begin.resize(sources, 0);
+		m_end.resize(sources, 0);
+		m_more.resize(sources, true);
+		m_cuts.resize(sources * (threads + 1), 0);
+		m_partOffset.resize(threads + 1, 0);
+		m_samples.resize(threads * oversampling);
+		m_jobs.resize(threads - 1);
+		m_outBegin = m_outEnd = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Free all buffers.
+	///////////////////////////////////////////////////////////////////////////
+	void reset() {
+		m_sources = 0;
+		m_input.resize(0);
+		m_output.resize(0);
+		m_begin.resize(0);
+		m_end.resize(0);
+		m_more.resize(0);
+		m_cuts.resize(0);
+		m_partOffset.resize(0);
+		m_samples.resize(0);
+		m_jobs.resize(0);
+		m_outBegin = m_outEnd = 0;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return true if the output buffer is empty. After fill(), this
+	/// means that every source is exhausted.
+	///////////////////////////////////////////////////////////////////////////
+	bool empty() const {return m_outBegin == m_outEnd;}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Return the next item in the merged output.
+	///////////////////////////////////////////////////////////////////////////
+	T & top() {return m_output[m_outBegin];}
+
+	const T & top() const {return m_output[m_outBegin];}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Skip the next item in the merged output.
+	///////////////////////////////////////////////////////////////////////////
+	void pop() {
+		tp_assert(!empty(), "pop() on empty parallel_merge_buffer");
+		++m_outBegin;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief If the output buffer is empty, read from the sources and merge
+	/// the next batch.
+	///////////////////////////////////////////////////////////////////////////
+	template <typename source_t>
+	void fill(source_t & src) {
+		if (!empty()) return;
+		m_outBegin = m_outEnd = 0;
+		read_sources(src);
+		size_type total = find_batch();
+		if (total == 0) return;
+		size_type parts = split_batch(total);
+		for (size_type j = 1; j < parts; ++j) {
+			m_jobs[j-1].m_self = this;
+			m_jobs[j-1].m_part = j;
+			m_jobs[j-1].enqueue();
+		}
+		merge_part(0);
+		for (size_type j = 1; j < parts; ++j) m_jobs[j-1].join();
+		for (size_type i = 0; i < m_sources; ++i) m_begin[i] = cut(parts, i);
+		m_outEnd = total;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Memory usage as a function of the number of sources.
+	///////////////////////////////////////////////////////////////////////////
+	static constexpr linear_memory_usage memory_usage(
+		size_type threads, size_type bufferItems = default_buffer_items()) noexcept {
+		return linear_memory_usage(
+			2 * bufferItems * array<T>::memory_coefficient() // m_input, m_output
+			+ 2 * array<size_type>::memory_coefficient() // m_begin, m_end
+			+ array<bool>::memory_coefficient() // m_more
+			+ (threads + 1) * array<size_type>::memory_coefficient() // m_cuts
+			+ threads * tree_type::memory_coefficient(), // one tree per part
+			sizeof(parallel_merge_buffer)
+			+ 8 * array<T>::memory_overhead()
+			+ (threads + 1) * sizeof(size_type) // m_partOffset
+			+ threads * oversampling * sizeof(T) // m_samples
+			+ threads * sizeof(part_job) // m_jobs
+			+ threads * tree_type::memory_overhead());
+	}
+
+private:
+	static const size_type oversampling = 16;
+
+	class ptr_pred {
+	public:
+		ptr_pred(pred_t pred): m_pred(pred) {}
+		bool operator()(const T * a, const T * b) {return m_pred(*a, *b);}
+	private:
+		pred_t m_pred;
+	};
+
+	typedef loser_tree<T *, ptr_pred> tree_type;
+
+	class part_job : public job {
+	public:
+		part_job(): m_self(nullptr), m_part(0) {}
+		virtual void operator()() override {m_self->merge_part(m_part);}
+		parallel_merge_buffer * m_self;
+		size_type m_part;
+	};
+
+	T * buffer(size_type i) {return m_input.get() + i * m_bufferItems;}
+
+	size_type & cut(size_type j, size_type i) {return m_cuts[j * m_sources + i];}
+
+	// Move the unmerged items of every source to the front of its buffer and
+	// top up the buffer from the source.
+	template <typename source_t>
+	void read_sources(source_t & src) {
+		for (size_type i = 0; i < m_sources; ++i) {
+			T * b = buffer(i);
+			if (m_begin[i] > 0) {
+				std::move(b + m_begin[i], b + m_end[i], b);
+				m_end[i] -= m_begin[i];
+				m_begin[i] = 0;
+			}
+			while (m_more[i] && m_end[i] < m_bufferItems) {
+				if (src.can_read(i)) b[m_end[i]++] = src.read(i);
+				else m_more[i] = false;
+			}
+		}
+	}
+
+	// Find the buffered items that are safe to merge and store the end of
+	// each source's batch in cut(m_parts, i). Returns the batch size.
+	size_type find_batch() {
+		T * bound = nullptr;
+		for (size_type i = 0; i < m_sources; ++i) {
+			if (!m_more[i]) continue;
+			T * last = buffer(i) + m_end[i] - 1;
+			if (bound == nullptr || m_pred(*last, *bound)) bound = last;
+		}
+		size_type total = 0;
+		for (size_type i = 0; i < m_sources; ++i) {
+			T * b = buffer(i);
+			size_type c = m_end[i];
+			if (bound != nullptr)
+				c = std::upper_bound(b + m_begin[i], b + m_end[i], *bound, m_pred) - b;
+			cut(0, i) = m_begin[i];
+			cut(m_parts, i) = c;
+			total += c - m_begin[i];
+		}
+		return total;
+	}
+
+	// Choose splitters from a sample of the batch and split every source's
+	// part of the batch accordingly. Returns the number of parts used.
+	size_type split_batch(size_type total) {
+		// Do not hand out parts smaller than a quarter of a source buffer;
+		// such parts cost more to schedule than to merge.
+		const size_type minPartItems = std::max<size_type>(16, m_bufferItems / 4);
+		size_type parts = m_parts;
+		if (total < parts * minPartItems) parts = std::max<size_type>(1, total / minPartItems);
+		if (parts > 1) {
+			size_type sampleCount = parts * oversampling;
+			size_type n = 0;
+			for (size_type i = 0; i < m_sources && n < sampleCount; ++i) {
+				size_type len = cut(m_parts, i) - m_begin[i];
+				size_type k = std::min(sampleCount - n, len * sampleCount / total);
+				for (size_type s = 0; s < k; ++s)
+					m_samples[n++] = buffer(i)[m_begin[i] + (2*s+1) * len / (2*k)];
+			}
+			if (n < parts) {
+				parts = 1;
+			} else {
+				std::sort(m_samples.begin(), m_samples.begin() + n, m_pred);
+				for (size_type j = 1; j < parts; ++j) {
+					const T & splitter = m_samples[j * n / parts];
+					for (size_type i = 0; i < m_sources; ++i) {
+						T * b = buffer(i);
+						cut(j, i) = std::lower_bound(b + cut(j-1, i), b + cut(m_parts, i), splitter, m_pred) - b;
+					}
+				}
+			}
+		}
+		for (size_type i = 0; i < m_sources; ++i) cut(parts, i) = cut(m_parts, i);
+		m_partOffset[0] = 0;
+		for (size_type j = 0; j < parts; ++j) {
+			size_type items = 0;
+			for (size_type i = 0; i < m_sources; ++i) items += cut(j+1, i) - cut(j, i);
+			m_partOffset[j+1] = m_partOffset[j] + items;
+		}
+		return parts;
+	}
+
+	// Merge part j of the batch into its slice of the output buffer.
+	void merge_part(size_type j) {
+		T * out = m_output.get() + m_partOffset[j];
+		tree_type tree(ptr_pred(m_pred), m_bucket);
+		tree.resize(m_sources);
+		for (size_type i = 0; i < m_sources; ++i)
+			if (cut(j, i) < cut(j+1, i)) tree.unsafe_set(i, buffer(i) + cut(j, i));
+		tree.make_safe();
+		while (!tree.empty()) {
+			size_type i = tree.top_index();
+			T * p = tree.top();
+			*out++ = std::move(*p);
+			if (++p < buffer(i) + cut(j+1, i)) tree.replace_top(p);
+			else tree.pop();
+		}
+	}
+
+	pred_t m_pred;
+	memory_bucket_ref m_bucket;
+	array<T> m_input;
+	array<T> m_output;
+	array<size_type> m_begin;
+	array<size_type> m_end;
+	array<bool> m_more;
+	array<size_type> m_cuts;
+	array<size_type> m_partOffset;
+	array<T> m_samples;
+	array<part_job> m_jobs;
+	size_type m_sources;
+	size_type m_bufferItems;
+	size_type m_parts;
+	size_type m_outBegin;
+	size_type m_outEnd;
+};
+
+} // namespace tpie
+
+#endif // __TPIE_PARALLEL_MERGE_H__
@@ -31,10 +31,13 @@
 #include <mutex>
 #include <cmath>
 #include <functional>
+#include <vector>
 #include <tpie/progress_indicator_base.h>
 #include <tpie/dummy_progress.h>
 #include <tpie/internal_queue.h>
+#include <tpie/array.h>
 #include <tpie/job.h>
+#include <tpie/radix_sort.h>
 #include <tpie/config.h>
 
 namespace tpie {
@@ -283,7 +286,200 @@ private:
 };
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief Sort items in the range [a,b) using a parallel quick sort.
+/// \brief Parallel sample sort with a fixed degree of parallelism.
+///
+/// The input is cut into one slab per thread. Splitters are chosen from a
+/// sorted sample of the input, and every thread classifies the items of its
+/// own slab into the buckets between consecutive splitters and moves them
+/// to their final bucket in a buffer as large as the input. The buckets are
+/// then sorted concurrently and moved back. Items equal to a splitter are
+/// put in a bucket of their own which needs no sorting, so inputs with few
+/// distinct keys are balanced as well as inputs with many.
+///
+/// Unlike parallel_sort_impl, no partitioning step runs on a single thread,
+/// at the price of the additional buffer.
+///////////////////////////////////////////////////////////////////////////////
+template <typename iterator_type, typename comp_type>
+class parallel_sample_sort_impl {
+private:
+	typedef typename boost::iterator_value<iterator_type>::type value_type;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Number of samples drawn per thread.
+	///////////////////////////////////////////////////////////////////////////
+	static const size_t oversampling = 32;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Below this many items per thread, std::sort is used.
+	///////////////////////////////////////////////////////////////////////////
+	static const size_t min_items_per_thread = 4096;
+
+	enum phase_t { phase_count, phase_scatter, phase_sort };
+
+#ifdef DOXYGEN
+public:
+#endif
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Runs one phase of the sort for one thread.
+	///////////////////////////////////////////////////////////////////////////
+	class slab_job : public job {
+	public:
+		slab_job() : m_self(0), m_thread(0) {}
+
+		void set(parallel_sample_sort_impl * self, size_t thread) {
+			m_self = self;
+			m_thread = thread;
+		}
+
+		virtual void operator()() override {
+			m_self->run_phase(m_thread);
+		}
+
+	private:
+		parallel_sample_sort_impl * m_self;
+		size_t m_thread;
+	};
+
+public:
+	parallel_sample_sort_impl(size_t threads, comp_type comp = comp_type())
+		: m_threads(std::max<size_t>(threads, 1))
+		, m_comp(comp)
+	{
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Sort the items in [a,b). Waits until all threads are done.
+	///////////////////////////////////////////////////////////////////////////
+	void operator()(iterator_type a, iterator_type b) {
+		const size_t n = static_cast<size_t>(b - a);
+		m_parts = std::min(m_threads, n / min_items_per_thread);
+		if (m_parts <= 1) {
+			std::sort(a, b, m_comp);
+			return;
+		}
+		m_a = a;
+		m_n = n;
+
+		choose_splitters();
+		m_buckets = 2 * m_splitters.size() + 1;
+		m_counts.resize(m_parts * m_buckets);
+		m_offsets.resize(m_parts * m_buckets);
+		m_buffer.resize(n);
+		m_jobs.resize(m_parts);
+		for (size_t t = 0; t < m_parts; ++t) m_jobs[t].set(this, t);
+
+		run(phase_count);
+
+		// Bucket j of thread t goes after all items of buckets before j
+		// and after the items of bucket j in the slabs before t.
+		size_t offset = 0;
+		for (size_t j = 0; j < m_buckets; ++j) {
+			for (size_t t = 0; t < m_parts; ++t) {
+				m_offsets[t * m_buckets + j] = offset;
+				offset += m_counts[t * m_buckets + j];
+			}
+		}
+
+		run(phase_scatter);
+		run(phase_sort);
+
+		m_buffer.resize(0);
+		m_jobs.resize(0);
+	}
+
+private:
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Pick m_parts-1 splitters from an evenly spaced sample.
+	///////////////////////////////////////////////////////////////////////////
+	void choose_splitters() {
+		const size_t samples = std::min(m_n, oversampling * m_parts);
+		std::vector<value_type> sample;
+		sample.reserve(samples);
+		for (size_t i = 0; i < samples; ++i)
+			sample.push_back(*(m_a + static_cast<std::ptrdiff_t>(i * (m_n / samples))));
+		std::sort(sample.begin(), sample.end(), m_comp);
+
+		m_splitters.clear();
+		for (size_t t = 1; t < m_parts; ++t) {
+			const value_type & s = sample[t * samples / m_parts];
+			if (m_splitters.empty() || m_comp(m_splitters.back(), s))
+				m_splitters.push_back(s);
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Bucket 2i holds the items strictly between splitters i-1 and
+	/// i, and bucket 2i+1 the items equal to splitter i.
+	///////////////////////////////////////////////////////////////////////////
+	size_t bucket(const value_type & v) const {
+		const size_t i = static_cast<size_t>(
+			std::lower_bound(m_splitters.begin(), m_splitters.end(), v, m_comp)
+			- m_splitters.begin());
+		if (i < m_splitters.size() && !m_comp(v, m_splitters[i])) return 2*i+1;
+		return 2*i;
+	}
+
+	iterator_type slab_begin(size_t t) const {
+		return m_a + static_cast<std::ptrdiff_t>(t * m_n / m_parts);
+	}
+
+	void run(phase_t phase) {
+		m_phase = phase;
+		// The calling thread takes the first slab itself.
+		for (size_t t = 1; t < m_parts; ++t) m_jobs[t].enqueue();
+		run_phase(0);
+		for (size_t t = 1; t < m_parts; ++t) m_jobs[t].join();
+	}
+
+	void run_phase(size_t t) {
+		size_t * counts = &m_counts[t * m_buckets];
+		switch (m_phase) {
+			case phase_count:
+				std::fill(counts, counts + m_buckets, size_t(0));
+				for (iterator_type i = slab_begin(t); i != slab_begin(t+1); ++i)
+					++counts[bucket(*i)];
+				break;
+			case phase_scatter: {
+				size_t * offsets = &m_offsets[t * m_buckets];
+				for (iterator_type i = slab_begin(t); i != slab_begin(t+1); ++i)
+					m_buffer[offsets[bucket(*i)]++] = std::move(*i);
+				break;
+			}
+			case phase_sort:
+				// Thread t sorts bucket 2t and copies it and the equal
+				// items of splitter t back.
+				for (size_t j = 2*t; j < std::min(2*t + 2, m_buckets); ++j) {
+					// After the scatter, the offsets of the last slab
+					// point to the end of each bucket.
+					const size_t end = m_offsets[(m_parts-1) * m_buckets + j];
+					size_t begin = end;
+					for (size_t s = 0; s < m_parts; ++s) begin -= m_counts[s * m_buckets + j];
+					if (j % 2 == 0)
+						std::sort(m_buffer.begin() + begin, m_buffer.begin() + end, m_comp);
+					std::move(m_buffer.begin() + begin, m_buffer.begin() + end,
+							  m_a + static_cast<std::ptrdiff_t>(begin));
+				}
+				break;
+		}
+	}
+
+	size_t m_threads;
+	comp_type m_comp;
+	size_t m_parts;
+	size_t m_buckets;
+	iterator_type m_a;
+	size_t m_n;
+	phase_t m_phase;
+	std::vector<value_type> m_splitters;
+	array<size_t> m_counts;
+	array<size_t> m_offsets;
+	array<value_type> m_buffer;
+	array<slab_job> m_jobs;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Sort items in the range [a,b) using a parallel quick sort, or a
+/// parallel radix sort if radix_key is enabled for the items and comparator.
 /// \param a Iterator to left boundary.
 /// \param b Iterator to right boundary.
 /// \param pi Progress tracker. No thread-safety required.
@@ -295,6 +491,7 @@ void parallel_sort(iterator_type a,
 				   iterator_type b, 
 				   typename tpie::progress_types<Progress>::base & pi,
 				   comp_type comp=std::less<typename boost::iterator_value<iterator_type>::type>()) {
+	if (radix_sort_if_possible(a, b, comp, pi)) return;
 #ifdef TPIE_PARALLEL_SORT
 	parallel_sort_impl<iterator_type, comp_type, Progress> s(&pi);
 	s(a,b,comp);
@@ -306,7 +503,8 @@ void parallel_sort(iterator_type a,
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-/// \brief Sort items in the range [a,b) using a parallel quick sort.
+/// \brief Sort items in the range [a,b) using a parallel quick sort, or a
+/// parallel radix sort if radix_key is enabled for the items and comparator.
 /// \param a Iterator to left boundary.
 /// \param b Iterator to right boundary.
 /// \param comp Comparator.
@@ -316,6 +514,7 @@ template <typename iterator_type, typename comp_type>
 void parallel_sort(iterator_type a, 
 				   iterator_type b, 
 				   comp_type comp=std::less<typename boost::iterator_value<iterator_type>::type>()) {
+	if (radix_sort_if_possible(a, b, comp)) return;
 #ifdef TPIE_PARALLEL_SORT
 	parallel_sort_impl<iterator_type, comp_type, false> s(0);
 	s(a,b,comp);
@@ -325,5 +524,31 @@ void parallel_sort(iterator_type a,
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Sort items in the range [a,b) using a parallel sample sort on the
+/// given number of threads.
+///
+/// Uses a temporary buffer as large as the input.
+/// \param a Iterator to left boundary.
+/// \param b Iterator to right boundary.
+/// \param comp Comparator.
+/// \param threads Number of slabs sorted concurrently.
+/// \sa parallel_sample_sort_impl
+///////////////////////////////////////////////////////////////////////////////
+template <typename iterator_type, typename comp_type>
+void parallel_sort(iterator_type a,
+				   iterator_type b,
+				   comp_type comp,
+				   memory_size_type threads) {
+#ifdef TPIE_PARALLEL_SORT
+	parallel_sample_sort_impl<iterator_type, comp_type> s(threads, comp);
+	s(a, b);
+#else
+	unused(threads);
+	std::sort(a, b, comp);
+#endif
+}
+
+
 }
 #endif //__TPIE_PARALLEL_SORT_H__
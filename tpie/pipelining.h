@@ -33,6 +33,7 @@
 #include <tpie/pipelining/pair_factory.h>
 #include <tpie/pipelining/pipe_base.h>
 #include <tpie/pipelining/factory_helpers.h>
+#include <tpie/pipelining/push_batch.h>
 #include <tpie/pipelining/virtual.h>
 
 // Library
@@ -52,6 +53,7 @@
 #include <tpie/pipelining/stdio.h>
 #include <tpie/pipelining/uniq.h>
 #include <tpie/pipelining/parallel.h>
+#include <tpie/pipelining/parallel_input.h>
 #include <tpie/pipelining/map.h>
 
 #endif
@@ -0,0 +1,85 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_PIPELINING_BTREE_LOOKUP_H__
+#define __TPIE_PIPELINING_BTREE_LOOKUP_H__
+
+#include <tpie/pipelining/node.h>
+#include <tpie/pipelining/pipe_base.h>
+#include <tpie/pipelining/factory_helpers.h>
+#include <memory>
+#include <utility>
+
+namespace tpie {
+namespace pipelining {
+namespace bits {
+
+template <typename dest_t, typename tree_t>
+class btree_find_t: public node {
+public:
+	typedef typename tree_t::key_type item_type;
+	typedef typename tree_t::iterator iterator;
+
+	btree_find_t(dest_t dest, const tree_t & tree)
+		: tree(tree)
+		, dest(std::move(dest))
+	{
+		add_push_destination(this->dest);
+		set_name("B-tree lookup", PRIORITY_INSIGNIFICANT);
+	}
+
+	virtual void begin() override {
+		cursor.reset(new typename tree_t::lookup_cursor(tree));
+	}
+
+	void push(const item_type & item) {
+		dest.push(std::pair<item_type, iterator>(item, cursor->find(item)));
+	}
+
+	virtual void end() override {
+		cursor.reset();
+	}
+
+private:
+	const tree_t & tree;
+	std::unique_ptr<typename tree_t::lookup_cursor> cursor;
+	dest_t dest;
+};
+
+} // namespace bits
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A pipelining node that looks up each pushed key in the given
+/// btree, and pushes the key paired with the iterator find() would return.
+///
+/// The lookups share a btree lookup_cursor, so a stream of sorted keys is
+/// looked up without descending from the root for every key. The tree must
+/// not be modified while the pipeline runs.
+/// \param tree The tree to search
+///////////////////////////////////////////////////////////////////////////////
+template <typename tree_t>
+inline pipe_middle<tfactory<bits::btree_find_t, Args<tree_t>, const tree_t &> >
+btree_find(const tree_t & tree) {
+	return {tree};
+}
+
+} // namespace pipelining
+} // namespace tpie
+
+#endif // __TPIE_PIPELINING_BTREE_LOOKUP_H__
@@ -25,6 +25,7 @@
 #include <tpie/pipelining/node.h>
 #include <tpie/pipelining/factory_helpers.h>
 #include <tpie/pipelining/pipe_base.h>
+#include <tpie/pipelining/push_batch.h>
 #include <tpie/maybe.h>
 #include <tpie/flags.h>
 
@@ -41,6 +42,32 @@ typedef tpie::flags<stream_option> stream_options;
 
 namespace bits {
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Push the rest of the stream to dest one item at a time.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T, typename dest_t>
+void push_stream(file_stream<T> & fs, dest_t & dest, node & n, std::false_type) {
+	while (fs.can_read()) {
+		dest.push(fs.read());
+		n.step();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Push the rest of the stream to dest in batches.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T, typename dest_t>
+void push_stream(file_stream<T> & fs, dest_t & dest, node & n, std::true_type) {
+	array<T> batch(push_batch_items<T>());
+	while (fs.can_read()) {
+		const memory_size_type count = static_cast<memory_size_type>(
+			std::min<stream_size_type>(batch.size(), fs.size() - fs.offset()));
+		fs.read(batch.begin(), batch.begin() + count);
+		dest.push_batch(array_view<const T>(batch.get(), count));
+		n.step(count);
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \class input_t
 ///
@@ -69,12 +96,8 @@ public:
 	}
 
 	virtual void go() override {
-		if (fs.is_open()) {
-			while (fs.can_read()) {
-				dest.push(fs.read());
-				step();
-			}
-		}
+		if (fs.is_open())
+			bits::push_stream(fs, dest, *this, accepts_push_batch<dest_t, item_type>());
 	}
 
 	virtual void end() override {
@@ -111,10 +134,7 @@ public:
 	}
 
 	virtual void go() override {
-		while (fs->can_read()) {
-			dest.push(fs->read());
-			step();
-		}
+		bits::push_stream(*fs, dest, *this, accepts_push_batch<dest_t, item_type>());
 		fs.destruct();
 	}
 private:
@@ -261,6 +281,10 @@ public:
 	void push(const T & item) {
 		fs.write(item);
 	}
+
+	void push_batch(array_view<const T> items) {
+		fs.write(items.begin(), items.end());
+	}
 private:
 	file_stream<T> & fs;
 };
@@ -289,6 +313,10 @@ public:
 		fs->write(item);
 	}
 
+	void push_batch(array_view<const T> items) {
+		fs->write(items.begin(), items.end());
+	}
+
 	void end() override {
 		fs->close();
 		fs.destruct();
@@ -24,6 +24,7 @@
 #include <tpie/pipelining/node.h>
 #include <tpie/pipelining/pipe_base.h>
 #include <tpie/pipelining/factory_helpers.h>
+#include <tpie/pipelining/push_batch.h>
 #include <tpie/memory.h>
 #include <tpie/tpie_assert.h>
 
@@ -140,6 +141,11 @@ public:
 			dest2.push(item);
 		}
 
+		void push_batch(array_view<const item_type> items) {
+			push_batch_to(dest, items);
+			push_batch_to(dest2, items);
+		}
+
 	private:
 		dest_t dest;
 		dest2_t dest2;
@@ -186,10 +186,12 @@ void merge_sorter_base::set_parameters(memory_size_type runLength, memory_size_t
 	tp_assert(m_state == stNotStarted, "Merge sorting already begun");
 	p.runLength = p.internalReportThreshold = runLength;
 	p.fanout = p.finalFanout = fanout;
+	// The caller sized the run buffer, so do not allocate a second one.
+	p.doubleBuffered = false;
 	m_parametersSet = true;
 	log_pipe_debug() << "Manually set merge sort run length and fanout\n";
 	log_pipe_debug() << "Run length =       " << p.runLength << " (uses memory " << (p.runLength*m_item_size + m_element_file_stream_memory_usage) << ")\n";
-	log_pipe_debug() << "Fanout =           " << p.fanout << " (uses memory " << m_fanout_memory_usage(p.fanout) << ")" << std::endl;
+	log_pipe_debug() << "Fanout =           " << p.fanout << " (uses memory " << merge_memory_usage(p.fanout) << ")" << std::endl;
 }
 
 
@@ -198,6 +200,8 @@ merge_sorter_base::merge_sorter_base(
 	memory_size_type item_size,
 	memory_size_type element_file_stream_memory_usage)
 	: m_fanout_memory_usage(fanout_memory_usage)
+	, m_parallelMergeCoefficient(0.0)
+	, m_parallelMergeOverhead(0.0)
 	, m_item_size(item_size)
 	, m_element_file_stream_memory_usage(element_file_stream_memory_usage)
 	, m_bucketPtr(new memory_bucket())
@@ -205,6 +209,7 @@ merge_sorter_base::merge_sorter_base(
 	, m_state(stNotStarted)
 	, p()
 	, m_parametersSet(false)
+	, m_doubleBuffering(false)
 	, m_maxItems(std::numeric_limits<stream_size_type>::max())
 	, m_evacuated(false)
 	, m_finalMergeInitialized(false)
@@ -222,6 +227,10 @@ void merge_sorter_base::set_items(stream_size_type n) {
 		// We will handle this later in calculate_parameters
 		return;
 	}
+
+	// A single run needs no second buffer to overlap with.
+	if (m_maxItems <= p.runLength)
+		p.doubleBuffered = false;
 	
 	// If the item upper bound is less than a run,
 	// then it might pay off to decrease the length of a run
@@ -295,9 +304,9 @@ void merge_sorter_base::calculate_parameters() {
 	// Fanout: determined by the size of our merge heap and the stream memory usage.
 	log_pipe_debug() << "Phase 2: " << p.memoryPhase2 << " b available memory\n";
 	p.fanout = calculate_fanout(p.memoryPhase2, p.filesPhase2);
-	if (m_fanout_memory_usage(p.fanout) > p.memoryPhase2) {
-		log_pipe_debug() << "Not enough memory for fanout " << p.fanout << "! (" << p.memoryPhase2 << " < " << m_fanout_memory_usage(p.fanout) << ")\n";
-		p.memoryPhase2 = m_fanout_memory_usage(p.fanout);
+	if (merge_memory_usage(p.fanout) > p.memoryPhase2) {
+		log_pipe_debug() << "Not enough memory for fanout " << p.fanout << "! (" << p.memoryPhase2 << " < " << merge_memory_usage(p.fanout) << ")\n";
+		p.memoryPhase2 = merge_memory_usage(p.fanout);
 	}
 	
 	// Phase 3 (final merge & report):
@@ -309,9 +318,9 @@ void merge_sorter_base::calculate_parameters() {
 	if (p.finalFanout > p.fanout)
 		p.finalFanout = p.fanout;
 	
-	if (m_fanout_memory_usage(p.finalFanout) > p.memoryPhase3) {
-		log_pipe_debug() << "Not enough memory for fanout " << p.finalFanout << "! (" << p.memoryPhase3 << " < " << m_fanout_memory_usage(p.finalFanout) << ")\n";
-		p.memoryPhase3 = m_fanout_memory_usage(p.finalFanout);
+	if (merge_memory_usage(p.finalFanout) > p.memoryPhase3) {
+		log_pipe_debug() << "Not enough memory for fanout " << p.finalFanout << "! (" << p.memoryPhase3 << " < " << merge_memory_usage(p.finalFanout) << ")\n";
+		p.memoryPhase3 = merge_memory_usage(p.finalFanout);
 	}
 	
 	// Phase 1 (run formation):
@@ -327,7 +336,18 @@ void merge_sorter_base::calculate_parameters() {
 		log_warning() << "Not enough phase 1 memory for 128 KB items and an open stream! (" << p.memoryPhase1 << " < " << min_m1 << ")\n";
 		p.memoryPhase1 = min_m1;
 	}
-	p.runLength = (p.memoryPhase1 - bits::run_positions::memory_usage() - streamMemory - tempFileMemory)/m_item_size;
+	memory_size_type runMemory = p.memoryPhase1 - bits::run_positions::memory_usage() - streamMemory - tempFileMemory;
+	p.runLength = runMemory/m_item_size;
+
+	// When double buffering, the run memory holds two runs: one that is
+	// being filled and one that is sorted and written in the background.
+	// Only the background writer has a stream open.
+	// If everything fits in a single run, keep the longer run instead.
+	p.doubleBuffered = m_doubleBuffering
+		&& m_maxItems > p.runLength
+		&& runMemory >= 2*m_item_size;
+	if (p.doubleBuffered)
+		p.runLength = runMemory/(2*m_item_size);
 	
 	p.internalReportThreshold = (std::min(p.memoryPhase1,
 										  std::min(p.memoryPhase2,
@@ -374,7 +394,7 @@ memory_size_type merge_sorter_base::calculate_fanout(
 	// binary search
 	while (fanout_lo < fanout_hi - 1) {
 		memory_size_type mid = fanout_lo + (fanout_hi-fanout_lo)/2;
-		if (m_fanout_memory_usage(mid) <= availableMemory) {
+		if (merge_memory_usage(mid) <= availableMemory) {
 			fanout_lo = mid;
 		} else {
 			fanout_hi = mid;
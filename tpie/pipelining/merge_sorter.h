@@ -28,6 +28,10 @@
 #include <tpie/dummy_progress.h>
 #include <tpie/array_view.h>
 #include <tpie/parallel_sort.h>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 namespace tpie {
 
@@ -236,6 +240,22 @@ public:
 		check_not_started();
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Enable or disable double buffering in phase 1.
+	///
+	/// When enabled, the run formation memory is split between two run
+	/// buffers. Once a run is full, it is sorted and written to disk by a
+	/// background thread while push() fills the other buffer.
+	/// Runs are half as long as without double buffering, so fewer inputs
+	/// are reported internally and more runs must be merged.
+	/// Disabled by default, and ignored when the run length is set manually
+	/// with set_parameters().
+	///////////////////////////////////////////////////////////////////////////
+	void set_double_buffering(bool enabled) {
+		m_doubleBuffering = enabled;
+		check_not_started();
+	}
+
 	void set_phase_1_memory(memory_size_type m1) {
 		p.memoryPhase1 = m1;
 		check_not_started();
@@ -272,11 +292,11 @@ public:
 	}
 
 	memory_size_type minimum_memory_phase_2() noexcept {
-		return m_fanout_memory_usage(calculate_fanout(0, 0));
+		return merge_memory_usage(calculate_fanout(0, 0));
 	}
 
 	memory_size_type minimum_memory_phase_3() noexcept {
-		return m_fanout_memory_usage(calculate_fanout(0, 0));
+		return merge_memory_usage(calculate_fanout(0, 0));
 	}
 
 	memory_size_type maximum_memory_phase_3() noexcept {
@@ -284,18 +304,27 @@ public:
 	}
 
 	memory_size_type phase_1_memory(const sort_parameters & params) noexcept {
-		return params.runLength * m_item_size
+		return (params.doubleBuffered ? 2 : 1) * params.runLength * m_item_size
 			+ bits::run_positions::memory_usage()
 			+ m_element_file_stream_memory_usage
 			+ 2*params.fanout*sizeof(temp_file);
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Memory used by a merge of the given number of runs.
+	///////////////////////////////////////////////////////////////////////////
+	memory_size_type merge_memory_usage(memory_size_type fanout) const noexcept {
+		return m_fanout_memory_usage(fanout)
+			+ static_cast<memory_size_type>(static_cast<double>(fanout) * m_parallelMergeCoefficient
+											+ m_parallelMergeOverhead);
+	}
+
 	memory_size_type phase_2_memory(const sort_parameters & params) noexcept {
-		return m_fanout_memory_usage(params.fanout);
+		return merge_memory_usage(params.fanout);
 	}
 
 	memory_size_type phase_3_memory(const sort_parameters & params) noexcept {
-		return m_fanout_memory_usage(params.finalFanout);
+		return merge_memory_usage(params.finalFanout);
 	}
 	
 	///////////////////////////////////////////////////////////////////////////
@@ -310,6 +339,16 @@ protected:
 	///////////////////////////////////////////////////////////////////////////
 	void calculate_parameters();
 	
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Account for the memory used by merging on several threads.
+	/// \param extra  Additional memory usage as a function of the fanout.
+	///////////////////////////////////////////////////////////////////////////
+	void set_parallel_merge_memory(bool parallel, linear_memory_usage extra) {
+		check_not_started();
+		m_parallelMergeCoefficient = parallel ? extra.coefficient : 0.0;
+		m_parallelMergeOverhead = parallel ? extra.overhead : 0.0;
+	}
+
 	// Checks if we should still be able to change parameters
 	void check_not_started() {
 		if (m_state != stNotStarted) {
@@ -336,6 +375,9 @@ protected:
 	};
 
 	const linear_memory_usage m_fanout_memory_usage;
+	// Additional fanout memory usage when merging in parallel.
+	double m_parallelMergeCoefficient;
+	double m_parallelMergeOverhead;
     const memory_size_type m_item_size, m_element_file_stream_memory_usage;
 	
 	std::unique_ptr<memory_bucket> m_bucketPtr;
@@ -347,6 +389,7 @@ protected:
 
 	sort_parameters p;
 	bool m_parametersSet;
+	bool m_doubleBuffering;
 
 	bits::run_positions m_runPositions;
 
@@ -411,8 +454,33 @@ public:
 		, m_store(store.template get_specific<element_type>())
 		, m_merger(pred, m_store, m_bucket)
 		, m_currentRunItems(m_bucket)
+		, m_spareRunItems(m_bucket)
+		, m_runPending(false)
+		, m_runWriterStop(false)
 		, pred(pred)
 		{}
+
+	~merge_sorter() {
+		try {
+			stop_run_writer();
+		} catch (...) {
+			// The sort was abandoned; the error of its last run is moot.
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Merge runs on the given number of threads.
+	///
+	/// Every merge, including the final merge, is split into key ranges by
+	/// splitters sampled from the runs, and the ranges are merged
+	/// concurrently on the job pool and reported in order. Each run being
+	/// merged then needs an additional buffer, so the fanout may decrease.
+	/// 1 (the default) merges sequentially.
+	///////////////////////////////////////////////////////////////////////////
+	void set_parallel_merge(memory_size_type threads) {
+		set_parallel_merge_memory(threads > 1, merger<specific_store_t, pred_t>::parallel_memory_usage(threads));
+		m_merger.set_threads(threads);
+	}
 	
 
 public:
@@ -425,6 +493,13 @@ public:
 		log_pipe_debug() << "Start forming input runs" << std::endl;
 		m_currentRunItems = array<store_type>(0, allocator<store_type>(m_bucket));
 		m_currentRunItems.resize((size_t)p.runLength);
+		if (p.doubleBuffered) {
+			m_spareRunItems = array<store_type>(0, allocator<store_type>(m_bucket));
+			m_spareRunItems.resize((size_t)p.runLength);
+			m_runPending = false;
+			m_runWriterStop = false;
+			m_runWriter = std::thread(&merge_sorter::run_writer, this);
+		}
 		m_runFiles.resize(p.fanout*2);
 		m_currentRunItemCount = 0;
 		m_finishedRuns = 0;
@@ -437,10 +512,7 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	void push(item_type && item) {
 		tp_assert(m_state == stRunFormation, "Wrong phase");
-		if (m_currentRunItemCount >= p.runLength) {
-			sort_current_run();
-			empty_current_run();
-		}
+		if (m_currentRunItemCount >= p.runLength) flush_current_run();
 		m_currentRunItems[m_currentRunItemCount] = m_store.outer_to_store(std::move(item));
 		++m_currentRunItemCount;
 		++m_itemCount;
@@ -448,20 +520,37 @@ public:
 	
 	void push(const item_type & item) {
 		tp_assert(m_state == stRunFormation, "Wrong phase");
-		if (m_currentRunItemCount >= p.runLength) {
-			sort_current_run();
-			empty_current_run();
-		}
+		if (m_currentRunItemCount >= p.runLength) flush_current_run();
 		m_currentRunItems[m_currentRunItemCount] = m_store.outer_to_store(item);
 		++m_currentRunItemCount;
 		++m_itemCount;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Push a batch of items to merge sorter during phase 1.
+	///////////////////////////////////////////////////////////////////////////
+	void push_batch(array_view<const item_type> items) {
+		tp_assert(m_state == stRunFormation, "Wrong phase");
+		size_t i = 0;
+		while (i < items.size()) {
+			if (m_currentRunItemCount >= p.runLength) flush_current_run();
+			const size_t n = std::min(items.size() - i,
+									  static_cast<size_t>(p.runLength - m_currentRunItemCount));
+			for (size_t j = 0; j < n; ++j)
+				m_currentRunItems[m_currentRunItemCount + j] = m_store.outer_to_store(items[i + j]);
+			m_currentRunItemCount += n;
+			m_itemCount += n;
+			i += n;
+		}
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief End phase 1.
 	///////////////////////////////////////////////////////////////////////////
 	void end() {
 		tp_assert(m_state == stRunFormation, "Wrong phase");
+		stop_run_writer();
+		m_spareRunItems.resize(0);
 		sort_current_run();
 
 		if (m_itemCount == 0) {
@@ -559,16 +648,105 @@ private:
 
 	// postcondition: m_currentRunItemCount = 0
 	void empty_current_run() {
+		log_run_write();
+		write_run(m_currentRunItems, m_currentRunItemCount, m_finishedRuns);
+		m_currentRunItemCount = 0;
+		++m_finishedRuns;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Sort and write the full current run. When double buffering, the run is
+	/// handed to the run writer thread and the spare buffer becomes the
+	/// current run buffer.
+	/// postcondition: m_currentRunItemCount = 0
+	///////////////////////////////////////////////////////////////////////////
+	void flush_current_run() {
+		if (!p.doubleBuffered) {
+			sort_current_run();
+			empty_current_run();
+			return;
+		}
+		wait_for_run_writer();
+		m_currentRunItems.swap(m_spareRunItems);
+		log_run_write();
+		{
+			// While a run is pending, the writer alone touches
+			// m_spareRunItems, m_runFiles and m_runPositions.
+			std::lock_guard<std::mutex> lock(m_runWriterMutex);
+			m_pendingItems = m_currentRunItemCount;
+			m_pendingRunNumber = static_cast<memory_size_type>(m_finishedRuns);
+			m_runPending = true;
+		}
+		m_runWriterCond.notify_all();
+		m_currentRunItemCount = 0;
+		++m_finishedRuns;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Body of the run writer thread, which lives from begin() to end() when
+	/// double buffering.
+	///////////////////////////////////////////////////////////////////////////
+	void run_writer() {
+		std::unique_lock<std::mutex> lock(m_runWriterMutex);
+		while (true) {
+			while (!m_runPending && !m_runWriterStop) m_runWriterCond.wait(lock);
+			if (!m_runPending) return;
+			lock.unlock();
+			try {
+				parallel_sort(m_spareRunItems.begin(), m_spareRunItems.begin()+m_pendingItems,
+							  bits::store_pred<pred_t, specific_store_t>(pred));
+				write_run(m_spareRunItems, m_pendingItems, m_pendingRunNumber);
+			} catch (...) {
+				m_runWriterError = std::current_exception();
+			}
+			lock.lock();
+			m_runPending = false;
+			m_runWriterCond.notify_all();
+		}
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Wait until the run writer is idle, and rethrow its error if any.
+	///////////////////////////////////////////////////////////////////////////
+	void wait_for_run_writer() {
+		if (!m_runWriter.joinable()) return;
+		std::exception_ptr e;
+		{
+			std::unique_lock<std::mutex> lock(m_runWriterMutex);
+			while (m_runPending) m_runWriterCond.wait(lock);
+			std::swap(e, m_runWriterError);
+		}
+		if (e) std::rethrow_exception(e);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Let the run writer finish its pending run and exit.
+	///////////////////////////////////////////////////////////////////////////
+	void stop_run_writer() {
+		if (!m_runWriter.joinable()) return;
+		{
+			std::lock_guard<std::mutex> lock(m_runWriterMutex);
+			m_runWriterStop = true;
+		}
+		m_runWriterCond.notify_all();
+		m_runWriter.join();
+		std::exception_ptr e;
+		std::swap(e, m_runWriterError);
+		if (e) std::rethrow_exception(e);
+	}
+
+	void write_run(array<store_type> & items, memory_size_type count, memory_size_type runNumber) {
+		file_stream<element_type> fs;
+		open_run_file_write(fs, 0, runNumber);
+		for (memory_size_type i = 0; i < count; ++i)
+			fs.write(m_store.store_to_element(std::move(items[i])));
+	}
+
+	void log_run_write() {
 		if (m_finishedRuns < 10)
 			log_pipe_debug() << "Write " << m_currentRunItemCount << " items to run file " << m_finishedRuns << std::endl;
 		else if (m_finishedRuns == 10)
 			log_pipe_debug() << "..." << std::endl;
-		file_stream<element_type> fs;
-		open_run_file_write(fs, 0, m_finishedRuns);
-		for (memory_size_type i = 0; i < m_currentRunItemCount; ++i)
-			fs.write(m_store.store_to_element(std::move(m_currentRunItems[i])));
-		m_currentRunItemCount = 0;
-		++m_finishedRuns;
 	}
 
 	///////////////////////////////////////////////////////////////////////////
@@ -733,7 +911,7 @@ public:
 			return m_runFiles.memory_usage(m_runFiles.size())
 				+ m_currentRunItems.memory_usage(m_currentRunItems.size());
 		else
-			return fanout_memory_usage(m_finalRunCount);
+			return merge_memory_usage(m_finalRunCount);
 	}
 	
 private:
@@ -795,6 +973,18 @@ private:
 	// current run buffer. size 0 before begin(), size runLength after begin().
 	array<store_type> m_currentRunItems;
 
+	// When double buffering in phase 1: the run being sorted and written by
+	// m_runWriter. size runLength between begin() and end().
+	array<store_type> m_spareRunItems;
+	std::thread m_runWriter;
+	std::mutex m_runWriterMutex;
+	std::condition_variable m_runWriterCond;
+	bool m_runPending;
+	bool m_runWriterStop;
+	memory_size_type m_pendingItems;
+	memory_size_type m_pendingRunNumber;
+	std::exception_ptr m_runWriterError;
+
 	pred_t pred;
 };
 
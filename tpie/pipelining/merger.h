@@ -20,7 +20,8 @@
 #ifndef __TPIE_PIPELINING_MERGER_H__
 #define __TPIE_PIPELINING_MERGER_H__
 
-#include <tpie/internal_priority_queue.h>
+#include <tpie/loser_tree.h>
+#include <tpie/parallel_merge.h>
 #include <tpie/compressed/stream.h>
 #include <tpie/file_stream.h>
 #include <tpie/tpie_assert.h>
@@ -37,26 +38,41 @@ private:
 public:
 	inline merger(pred_t pred, specific_store_t store,
 				  memory_bucket_ref bucket = memory_bucket_ref())
-		: pq(0, predwrap(store_pred_t(pred)), bucket)
+		: lt(store_pred_t(pred), bucket)
+		, m_parallel(store_pred_t(pred), bucket)
 		, in(bucket)
 		, itemsRead(bucket)
-		, m_store(store) {
+		, m_store(store)
+		, m_threads(1) {
+	}
+
+	// Merge disjoint key ranges of the runs on the given number of threads.
+	// 1 (the default) merges sequentially using a loser tree.
+	// Precondition: !can_pull()
+	void set_threads(memory_size_type threads) {
+		tp_assert(!can_pull(), "set_threads() while merging");
+		m_threads = std::max<memory_size_type>(threads, 1);
+	}
+
+	memory_size_type get_threads() const {
+		return m_threads;
 	}
 
 	inline bool can_pull() {
-		return !pq.empty();
+		if (m_threads > 1) return !m_parallel.empty();
+		return !lt.empty();
 	}
 
  	inline store_type pull() {
 		tp_assert(can_pull(), "pull() while !can_pull()");
-		store_type el = std::move(pq.top().first);
-		size_t i = pq.top().second;
+		if (m_threads > 1) return parallel_pull();
+		store_type el = std::move(lt.top());
+		size_t i = lt.top_index();
 		if (in[i].can_read() && itemsRead[i] < runLength) {
-			pq.pop_and_push(
-				std::make_pair(m_store.element_to_store(in[i].read()), i));
+			lt.replace_top(m_store.element_to_store(in[i].read()));
 			++itemsRead[i];
 		} else {
-			pq.pop();
+			lt.pop();
 		}
 		if (!can_pull()) {
 			reset();
@@ -66,7 +82,8 @@ public:
 
 	inline void reset() {
 		in.resize(0);
-		pq.resize(0);
+		lt.resize(0);
+		m_parallel.reset();
 		itemsRead.resize(0);
 	}
 
@@ -77,15 +94,20 @@ public:
 	// Precondition: !can_pull()
 	void reset(array<file_stream<element_type> > & inputs, stream_size_type runLength) {
 		this->runLength = runLength;
-		tp_assert(pq.empty(), "Reset before we are done");
+		tp_assert(!can_pull(), "Reset before we are done");
 		in.swap(inputs);
-		pq.resize(in.size());
+		if (m_threads > 1) {
+			m_parallel.resize(in.size(), m_threads);
+			itemsRead.resize(in.size(), 0);
+			run_source src(*this);
+			m_parallel.fill(src);
+			return;
+		}
+		lt.resize(in.size());
 		for (size_t i = 0; i < in.size(); ++i) {
-			pq.unsafe_push(
-				std::make_pair(
-					m_store.element_to_store(in[i].read()), i));
+			lt.unsafe_set(i, m_store.element_to_store(in[i].read()));
 		}
-		pq.make_safe();
+		lt.make_safe();
 		itemsRead.resize(in.size(), 1);
 	}
 
@@ -95,11 +117,11 @@ public:
 			linear_memory_usage(-sizeof(file_stream<element_type>) //in filestreams,
 								+ file_stream<element_type>::memory_usage(), //in filestreams
 								sizeof(merger) 
-								- sizeof(internal_priority_queue<std::pair<store_type, size_t>, predwrap>) //pq
+								- sizeof(loser_tree<store_type, store_pred_t>) //lt
 								- sizeof(array<file_stream<element_type> >) //in
 								- sizeof(array<size_t>)) // itemsRead
 			+ array<size_t>::memory_usage() //itemsRead
-			+ internal_priority_queue<std::pair<store_type, size_t>, predwrap>::memory_usage() //pq
+			+ loser_tree<store_type, store_pred_t>::memory_usage() //lt
 			+ array<file_stream<element_type> >::memory_usage(); //in
 	}
 	
@@ -108,32 +130,49 @@ public:
 		return memory_usage()(fanout);
 	}
 
-	class predwrap {
+	// Compute the additional memory usage of merging on the given number of
+	// threads as a function of the fanout
+	static constexpr linear_memory_usage parallel_memory_usage(memory_size_type threads) noexcept {
+		return parallel_merge_buffer<store_type, store_pred_t>::memory_usage(threads);
+	}
+
+private:
+	// Reads the runs on behalf of m_parallel.
+	class run_source {
 	public:
-		typedef std::pair<store_type, size_t> item_type;
-		typedef item_type first_argument_type;
-		typedef item_type second_argument_type;
-		typedef bool result_type;
-
-		predwrap(store_pred_t pred)
-			: pred(pred)
-		{
+		run_source(merger & m): m(m) {}
+
+		bool can_read(size_t i) {
+			return m.in[i].can_read() && m.itemsRead[i] < m.runLength;
 		}
 
-		inline bool operator()(const item_type & lhs, const item_type & rhs) {
-			return pred(lhs.first, rhs.first);
+		store_type read(size_t i) {
+			++m.itemsRead[i];
+			return m.m_store.element_to_store(m.in[i].read());
 		}
 
 	private:
-		store_pred_t pred;
+		merger & m;
 	};
 
-private:
-	internal_priority_queue<std::pair<store_type, size_t>, predwrap> pq;
+	store_type parallel_pull() {
+		store_type el = std::move(m_parallel.top());
+		m_parallel.pop();
+		run_source src(*this);
+		m_parallel.fill(src);
+		if (!can_pull()) {
+			reset();
+		}
+		return el;
+	}
+
+	loser_tree<store_type, store_pred_t> lt;
+	parallel_merge_buffer<store_type, store_pred_t> m_parallel;
 	array<file_stream<element_type> > in;
 	array<stream_size_type> itemsRead;
 	stream_size_type runLength;
 	specific_store_t m_store;
+	memory_size_type m_threads;
 };
 
 } // namespace tpie
@@ -793,6 +793,8 @@ public:
 
 	friend class bits::datastructure_runtime;
 
+	friend class bits::runtime;
+
 	friend class factory_base;
 
 	friend class bits::pipeline_base;
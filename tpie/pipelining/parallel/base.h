@@ -22,6 +22,7 @@
 
 #include <tpie/pipelining/node.h>
 #include <tpie/pipelining/factory_base.h>
+#include <tpie/pipelining/push_batch.h>
 #include <tpie/array_view.h>
 #include <memory>
 #include <tpie/pipelining/maintain_order_type.h>
@@ -729,9 +730,7 @@ public:
 	/// input, then the flush at the end is not needed.
 	///////////////////////////////////////////////////////////////////////////
 	virtual void push_all(array_view<item_type> items) {
-		for (size_t i = 0; i < items.size(); ++i) {
-			dest.push(items[i]);
-		}
+		push_batch_to(dest, items);
 
 		// virtual invocation
 		this->st.output(this->parId).flush_buffer();
@@ -766,9 +765,7 @@ public:
 	/// \brief Push all items from output buffer to the rest of the pipeline.
 	///////////////////////////////////////////////////////////////////////////
 	virtual void consume(array_view<item_type> a) override {
-		for (size_t i = 0; i < a.size(); ++i) {
-			dest.push(a[i]);
-		}
+		push_batch_to(dest, a);
 	}
 };
 
@@ -1062,6 +1059,26 @@ public:
 		empty_input_buffer(lock);
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Copy a batch of items into input buffers and send them off to
+	/// workers as they fill up.
+	///////////////////////////////////////////////////////////////////////////
+	void push_batch(array_view<const item_type> items) {
+		size_t i = 0;
+		while (i < items.size()) {
+			const size_t n = std::min(items.size() - i, st->opts.bufSize - written);
+			std::copy(items.begin() + i, items.begin() + (i + n), inputBuffer.begin() + written);
+			written += n;
+			i += n;
+			if (written < st->opts.bufSize) return;
+
+			state_base::lock_t lock(st->mutex);
+			handle_exceptions(lock);
+			flush_steps();
+			empty_input_buffer(lock);
+		}
+	}
+
 private:
 	void empty_input_buffer(state_base::lock_t & lock) {
 		while (written > 0) {
@@ -0,0 +1,218 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_PIPELINING_PARALLEL_INPUT_H__
+#define __TPIE_PIPELINING_PARALLEL_INPUT_H__
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file parallel_input.h  File stream source that reads block-aligned
+/// ranges of the file concurrently.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/file_stream.h>
+#include <tpie/compressed/thread.h>
+#include <tpie/job.h>
+#include <tpie/memory.h>
+#include <tpie/pipelining/node.h>
+#include <tpie/pipelining/pipe_base.h>
+#include <tpie/pipelining/factory_helpers.h>
+#include <tpie/pipelining/maintain_order_type.h>
+#include <tpie/pipelining/push_batch.h>
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <vector>
+
+namespace tpie {
+namespace pipelining {
+namespace bits {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \class parallel_input_t
+///
+/// Named file_stream input generator that reads several blocks at a time.
+///
+/// The file is split at its block boundaries, and each block is read by a
+/// job on the TPIE job pool into a buffer of its own. The reads go through
+/// separate streams, so compressed blocks are decompressed concurrently by
+/// the compressor workers. The node pushes the buffers from its own thread,
+/// either in file order or in the order the reads complete.
+///////////////////////////////////////////////////////////////////////////////
+template <typename dest_t>
+class parallel_input_t : public node {
+public:
+	typedef typename push_type<dest_t>::type item_type;
+
+	parallel_input_t(dest_t dest, std::string path, maintain_order_type order,
+					 memory_size_type rangesInFlight)
+		: dest(std::move(dest))
+		, path(std::move(path))
+		, order(order)
+		, slots(rangesInFlight)
+		, blockItems(file_stream<item_type>::block_size(1.0) / sizeof(item_type))
+		, size(0)
+	{
+		if (slots == 0)
+			slots = 2 * std::max(default_worker_count(), get_compressor_thread_count());
+		add_push_destination(this->dest);
+		set_name("Parallel read", PRIORITY_INSIGNIFICANT);
+		set_minimum_memory(slots * (file_stream<item_type>::memory_usage()
+									+ array<item_type>::memory_usage(blockItems)));
+	}
+
+	virtual void propagate() override {
+		file_stream<item_type> fs;
+		fs.open(path, access_read);
+		size = fs.size();
+		positions = fs.block_positions();
+		fs.close();
+		forward("items", size);
+		set_steps(size);
+	}
+
+	virtual void go() override {
+		const memory_size_type ranges = positions.size();
+		jobs.resize(std::min(slots, ranges));
+		for (memory_size_type i = 0; i < jobs.size(); ++i) {
+			jobs[i].reset(tpie_new<range_job>());
+			jobs[i]->fs.open(path, access_read);
+			jobs[i]->items.resize(blockItems);
+		}
+		nextRange = 0;
+
+		try {
+			for (memory_size_type i = 0; i < jobs.size(); ++i)
+				start(*jobs[i]);
+
+			if (order == maintain_order) {
+				for (memory_size_type r = 0; r < ranges; ++r) {
+					range_job & j = *jobs[r % jobs.size()];
+					j.join();
+					emit(j);
+					if (nextRange < ranges) start(j);
+				}
+			} else {
+				std::deque<range_job *> active;
+				for (memory_size_type i = 0; i < jobs.size(); ++i)
+					active.push_back(jobs[i].get());
+				while (!active.empty()) {
+					// Take any finished read; if none is, wait for the oldest.
+					typename std::deque<range_job *>::iterator i = active.begin();
+					while (i != active.end() && !(*i)->is_done()) ++i;
+					if (i == active.end()) i = active.begin();
+					range_job * j = *i;
+					active.erase(i);
+					j->join();
+					emit(*j);
+					if (nextRange < ranges) {
+						start(*j);
+						active.push_back(j);
+					}
+				}
+			}
+		} catch (...) {
+			// The jobs read into our buffers, so they must finish first.
+			for (memory_size_type i = 0; i < jobs.size(); ++i) jobs[i]->join();
+			jobs.clear();
+			throw;
+		}
+		jobs.clear();
+	}
+
+private:
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Reads one block-aligned range of the file into its buffer.
+	///////////////////////////////////////////////////////////////////////////
+	class range_job : public job {
+	public:
+		file_stream<item_type> fs;
+		array<item_type> items;
+		stream_position position;
+		memory_size_type count;
+		std::exception_ptr error;
+
+		virtual void operator()() override {
+			try {
+				fs.set_position(position);
+				fs.read(items.begin(), items.begin() + count);
+			} catch (...) {
+				error = std::current_exception();
+			}
+		}
+	};
+
+	void start(range_job & j) {
+		const stream_size_type begin = positions[nextRange].offset();
+		const stream_size_type end = (nextRange + 1 < positions.size())
+			? positions[nextRange + 1].offset()
+			: size;
+		j.position = positions[nextRange];
+		j.count = static_cast<memory_size_type>(end - begin);
+		++nextRange;
+		j.enqueue();
+	}
+
+	void emit(range_job & j) {
+		if (j.error) std::rethrow_exception(j.error);
+		push_batch_to(dest, array_view<const item_type>(j.items.get(), j.count));
+		step(j.count);
+	}
+
+	dest_t dest;
+	std::string path;
+	maintain_order_type order;
+	memory_size_type slots;
+	memory_size_type blockItems;
+	stream_size_type size;
+	std::vector<stream_position> positions;
+	std::vector<tpie::unique_ptr<range_job> > jobs;
+	memory_size_type nextRange;
+};
+
+} // namespace bits
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A pipelining node that pushes the contents of the named file stream
+/// to the next node, reading several blocks of the file concurrently.
+///
+/// Use this in place of named_input when reading, and in particular
+/// decompressing, the input is the bottleneck; it is commonly followed by a
+/// parallel() section. Each block is read by a job on the job pool, and the
+/// decompression of compressed blocks happens on the compressor workers
+/// (see set_compressor_thread_count).
+///
+/// The file must have been closed by its writer.
+/// \param path The path of the file stream
+/// \param order Whether to push the items in file order, or in the order
+/// the blocks are read.
+/// \param rangesInFlight Number of blocks read ahead; zero for twice the
+/// number of job or compressor workers, whichever is larger. Each costs
+/// a stream and a block of items.
+///////////////////////////////////////////////////////////////////////////////
+inline pipe_begin<factory<bits::parallel_input_t, std::string, maintain_order_type, memory_size_type> >
+parallel_input(std::string path,
+			   maintain_order_type order=maintain_order,
+			   memory_size_type rangesInFlight=0) {
+	return {std::move(path), order, rangesInFlight};
+}
+
+} // namespace pipelining
+} // namespace tpie
+
+#endif // __TPIE_PIPELINING_PARALLEL_INPUT_H__
@@ -132,6 +132,11 @@ void pipeline_base::operator()(stream_size_type items, progress_indicator_base &
 							   const char * file, const char * function) {
 	node_map::ptr map = m_nodeMap->find_authority();
 	runtime rt(map);
+	rt.set_concurrent_phases(m_concurrentPhases);
+	if (m_profiling) {
+		m_profile = pipeline_profile();
+		rt.set_profile(&m_profile);
+	}
 
 	CurrentPipeSetter cpc(this);
 	rt.go(items, pi, initialFiles, initialMemory, file, function);
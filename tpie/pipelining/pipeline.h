@@ -23,6 +23,8 @@
 #include <tpie/types.h>
 #include <iostream>
 #include <tpie/pipelining/tokens.h>
+#include <tpie/pipelining/profile.h>
+#include <tpie/jsonprint.h>
 #include <tpie/progress_indicator_null.h>
 #include <tpie/file_manager.h>
 #include <unordered_set>
@@ -130,9 +132,34 @@ public:
 		return m_memory;
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Run phases that do not depend on each other concurrently.
+	/// See runtime::set_concurrent_phases.
+	///////////////////////////////////////////////////////////////////////////
+	void set_concurrent_phases(bool enabled) {
+		m_concurrentPhases = enabled;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Record a profile of each following run. See profile.h.
+	///////////////////////////////////////////////////////////////////////////
+	void set_profiling(bool enabled) {
+		m_profiling = enabled;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief The profile of the last run with profiling enabled.
+	///////////////////////////////////////////////////////////////////////////
+	const pipeline_profile & get_profile() const {
+		return m_profile;
+	}
+
 	void order_before(pipeline_base & other);
 protected:
 	double m_memory;
+	bool m_concurrentPhases = false;
+	bool m_profiling = false;
+	pipeline_profile m_profile;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -234,6 +261,44 @@ public:
 		return p->memory();
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Run phases that do not depend on each other, such as two
+	/// sorts fed by the same fork, concurrently on separate threads.
+	///
+	/// Files and memory are divided between the phases run together.
+	/// Disabled by default.
+	///////////////////////////////////////////////////////////////////////////
+	void set_concurrent_phases(bool enabled = true) {
+		p->set_concurrent_phases(enabled);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Profile the following runs of the pipeline.
+	///
+	/// Per node, the runtime records the wall and CPU time of its calls on
+	/// the node, the items counted by step(), the bytes read and written,
+	/// and the memory assigned and used; per phase, the same totals. See
+	/// profile.h for how to read the numbers.
+	///////////////////////////////////////////////////////////////////////////
+	void set_profiling(bool enabled = true) {
+		p->set_profiling(enabled);
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief The profile of the last run with profiling enabled.
+	///////////////////////////////////////////////////////////////////////////
+	const pipeline_profile & get_profile() const {
+		return p->get_profile();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Print the profile of the last run with profiling enabled as
+	/// JSON.
+	///////////////////////////////////////////////////////////////////////////
+	void print_profile(std::ostream & out = std::cout, bool pretty = true) {
+		out << json_printer(p->get_profile(), pretty) << std::endl;
+	}
+
 	bits::node_map::ptr get_node_map() const {
 		return p->get_node_map();
 	}
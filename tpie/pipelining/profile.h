@@ -0,0 +1,131 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_PIPELINING_PROFILE_H__
+#define __TPIE_PIPELINING_PROFILE_H__
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file profile.h  Profiling report of a pipeline run.
+///
+/// When profiling is enabled with pipeline::set_profiling, the runtime
+/// measures each call it makes on a node (prepare, propagate, begin, go and
+/// end) and records the totals in a pipeline_profile, which can be printed
+/// as JSON with json_printer or pipeline::print_profile.
+///
+/// Nodes push to and pull from each other directly, so the time a node
+/// spends in push or pull is accounted to the node whose callback made the
+/// call; for a push pipeline that is the initiator's go(). Bytes read and
+/// written are the process-wide counters of tpie/stats.h, and CPU time is
+/// the processor time of the process as given by std::clock, so both
+/// include work done on behalf of the node by other threads, and by other
+/// nodes running concurrently.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/types.h>
+#include <tpie/reflect.h>
+#include <string>
+#include <vector>
+
+namespace tpie {
+namespace pipelining {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Measurements for a single node.
+///////////////////////////////////////////////////////////////////////////////
+struct node_profile {
+	std::string name;
+	uint64_t id = 0;
+	/// Seconds spent in the runtime's calls on the node.
+	double wallTime = 0;
+	double cpuTime = 0;
+	/// Items reported by the node through step().
+	uint64_t items = 0;
+	uint64_t bytesRead = 0;
+	uint64_t bytesWritten = 0;
+	uint64_t memoryAssigned = 0;
+	/// Largest amount of memory seen in the node's memory buckets.
+	uint64_t memoryUsed = 0;
+};
+
+REFLECT_BEGIN(node_profile)
+REFLECT_VISIT(name)
+REFLECT_VISIT(id)
+REFLECT_VISIT(wallTime)
+REFLECT_VISIT(cpuTime)
+REFLECT_VISIT(items)
+REFLECT_VISIT(bytesRead)
+REFLECT_VISIT(bytesWritten)
+REFLECT_VISIT(memoryAssigned)
+REFLECT_VISIT(memoryUsed)
+REFLECT_END()
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Measurements for a phase, from propagate to end.
+///////////////////////////////////////////////////////////////////////////////
+struct phase_profile {
+	std::string name;
+	double wallTime = 0;
+	double cpuTime = 0;
+	uint64_t bytesRead = 0;
+	uint64_t bytesWritten = 0;
+	/// Memory assigned to the nodes of the phase.
+	uint64_t memoryAssigned = 0;
+	/// Largest increase in memory usage over the start of the phase, sampled
+	/// after begin, after go and before end.
+	uint64_t memoryUsed = 0;
+	std::vector<node_profile> nodes;
+};
+
+REFLECT_BEGIN(phase_profile)
+REFLECT_VISIT(name)
+REFLECT_VISIT(wallTime)
+REFLECT_VISIT(cpuTime)
+REFLECT_VISIT(bytesRead)
+REFLECT_VISIT(bytesWritten)
+REFLECT_VISIT(memoryAssigned)
+REFLECT_VISIT(memoryUsed)
+REFLECT_VISIT(nodes)
+REFLECT_END()
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Measurements for a pipeline run; the phases in the order they ran.
+///////////////////////////////////////////////////////////////////////////////
+struct pipeline_profile {
+	double wallTime = 0;
+	double cpuTime = 0;
+	uint64_t bytesRead = 0;
+	uint64_t bytesWritten = 0;
+	/// Memory the pipeline was run with.
+	uint64_t memory = 0;
+	std::vector<phase_profile> phases;
+};
+
+REFLECT_BEGIN(pipeline_profile)
+REFLECT_VISIT(wallTime)
+REFLECT_VISIT(cpuTime)
+REFLECT_VISIT(bytesRead)
+REFLECT_VISIT(bytesWritten)
+REFLECT_VISIT(memory)
+REFLECT_VISIT(phases)
+REFLECT_END()
+
+} // namespace pipelining
+} // namespace tpie
+
+#endif // __TPIE_PIPELINING_PROFILE_H__
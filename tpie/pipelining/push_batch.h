@@ -0,0 +1,94 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; eval: (progn (c-set-style "stroustrup") (c-set-offset 'innamespace 0)); -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#ifndef __TPIE_PIPELINING_PUSH_BATCH_H__
+#define __TPIE_PIPELINING_PUSH_BATCH_H__
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file push_batch.h  Pushing contiguous batches of items between nodes.
+///
+/// A node may accept a batch of items in a single call by implementing
+/// \code
+/// void push_batch(array_view<const item_type> items);
+/// \endcode
+/// next to its ordinary push method. A node that pushes items it already
+/// holds in contiguous memory hands them on with push_batch_to, which calls
+/// push_batch on the destination if it has one, and push once per item
+/// otherwise. Batches are only worth forming where the destination takes
+/// them; see accepts_push_batch.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <tpie/array_view.h>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+namespace tpie {
+namespace pipelining {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Whether nodes of type dest_t implement push_batch for batches of
+/// items of type T.
+///////////////////////////////////////////////////////////////////////////////
+template <typename dest_t, typename T, typename Enable = void>
+struct accepts_push_batch : public std::false_type {};
+
+template <typename dest_t, typename T>
+struct accepts_push_batch<dest_t, T,
+	decltype(std::declval<dest_t &>().push_batch(std::declval<array_view<const T> >()), void())>
+	: public std::true_type {};
+
+namespace bits {
+
+template <typename dest_t, typename T>
+void push_batch_to(dest_t & dest, array_view<const T> items, std::true_type) {
+	dest.push_batch(items);
+}
+
+template <typename dest_t, typename T>
+void push_batch_to(dest_t & dest, array_view<const T> items, std::false_type) {
+	for (size_t i = 0; i < items.size(); ++i) dest.push(items[i]);
+}
+
+} // namespace bits
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Push the given items to dest, as a single batch if dest
+/// implements push_batch and one at a time otherwise.
+///////////////////////////////////////////////////////////////////////////////
+template <typename dest_t, typename T>
+void push_batch_to(dest_t & dest, array_view<T> items) {
+	typedef typename std::remove_const<T>::type item_type;
+	bits::push_batch_to(dest, array_view<const item_type>(items),
+						accepts_push_batch<dest_t, item_type>());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Number of items a source node collects into a batch before
+/// pushing it; 64 KiB worth of items.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+constexpr memory_size_type push_batch_items() {
+	return std::max<memory_size_type>(1, 64*1024 / sizeof(T));
+}
+
+} // namespace pipelining
+} // namespace tpie
+
+#endif // __TPIE_PIPELINING_PUSH_BATCH_H__
@@ -23,7 +23,13 @@
 #include <tpie/pipelining/tokens.h>
 #include <tpie/pipelining/node.h>
 #include <tpie/pipelining/runtime.h>
+#include <tpie/memory.h>
+#include <tpie/stats.h>
 #include <boost/functional/hash.hpp>
+#include <ctime>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 namespace tpie {
 
@@ -992,17 +998,91 @@ private:
 	progress_indicator_base * m_pi;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+/// Progress indicator for one of several phases run concurrently.
+/// Progress indicators are not thread safe, so steps are counted locally
+/// and forwarded to the indicator of the merged phase under a lock.
+///////////////////////////////////////////////////////////////////////////////
+class concurrent_progress_indicator : public progress_indicator_base {
+public:
+	concurrent_progress_indicator(progress_indicator_base & target, std::mutex & mutex)
+		: progress_indicator_base(0)
+		, m_target(target)
+		, m_mutex(mutex)
+		, m_forwarded(0)
+	{
+		init();
+	}
+
+	virtual void refresh() override {
+		flush();
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// Forward the steps taken since the last call.
+	///////////////////////////////////////////////////////////////////////////
+	void flush() {
+		const stream_size_type current = get_current();
+		if (current == m_forwarded) return;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_target.step(current - m_forwarded);
+		m_forwarded = current;
+	}
+
+private:
+	progress_indicator_base & m_target;
+	std::mutex & m_mutex;
+	stream_size_type m_forwarded;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Adds the time and I/O of its lifetime to a node, phase or pipeline
+/// profile, if one is given.
+///////////////////////////////////////////////////////////////////////////////
+template <typename profile_t>
+class profile_timer {
+public:
+	profile_timer(profile_t * profile)
+		: m_profile(profile)
+	{
+		if (!m_profile) return;
+		m_start = ptime::now();
+		m_bytesRead = get_bytes_read();
+		m_bytesWritten = get_bytes_written();
+		m_cpu = std::clock();
+	}
+
+	~profile_timer() {
+		if (!m_profile) return;
+		m_profile->wallTime += ptime::seconds(m_start, ptime::now());
+		m_profile->cpuTime += static_cast<double>(std::clock() - m_cpu) / CLOCKS_PER_SEC;
+		m_profile->bytesRead += get_bytes_read() - m_bytesRead;
+		m_profile->bytesWritten += get_bytes_written() - m_bytesWritten;
+	}
+
+private:
+	profile_t * m_profile;
+	ptime m_start;
+	std::clock_t m_cpu;
+	stream_size_type m_bytesRead;
+	stream_size_type m_bytesWritten;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 /// begin/end handling on nodes.
 ///////////////////////////////////////////////////////////////////////////////
 class begin_end {
 public:
-	begin_end(graph<node *> & actorGraph) {
+	begin_end(graph<node *> & actorGraph,
+			  const std::unordered_map<node *, node_profile *> & profiles)
+		: m_profiles(profiles)
+	{
 		actorGraph.topological_order(m_topologicalOrder);
 	}
 
 	void begin() {
 		for (size_t i = m_topologicalOrder.size(); i--;) {
+			profile_timer<node_profile> t(get_profile(m_topologicalOrder[i]));
 			m_topologicalOrder[i]->set_state(node::STATE_IN_BEGIN);
 			m_topologicalOrder[i]->begin();
 			m_topologicalOrder[i]->set_state(node::STATE_AFTER_BEGIN);
@@ -1011,6 +1091,7 @@ public:
 
 	void end() {
 		for (size_t i = 0; i < m_topologicalOrder.size(); ++i) {
+			profile_timer<node_profile> t(get_profile(m_topologicalOrder[i]));
 			m_topologicalOrder[i]->set_state(node::STATE_IN_END);
 			m_topologicalOrder[i]->end();
 			m_topologicalOrder[i]->set_state(node::STATE_AFTER_END);
@@ -1018,7 +1099,13 @@ public:
 	}
 
 private:
+	node_profile * get_profile(node * n) const {
+		auto i = m_profiles.find(n);
+		return i == m_profiles.end() ? nullptr : i->second;
+	}
+
 	std::vector<node *> m_topologicalOrder;
+	const std::unordered_map<node *, node_profile *> & m_profiles;
 };
 
 datastructure_runtime::datastructure_runtime(const std::vector<std::vector<node *> > & phases, node_map & nodeMap)
@@ -1122,6 +1209,7 @@ struct gocontext {
 	std::map<node *, size_t> phaseMap;
 	graph<size_t> phaseGraph;
 	std::vector<std::vector<node *> > phases;
+	std::vector<std::vector<std::vector<node *> > > subphases;
 	std::unordered_set<node_map::id_t> evacuateWhenDone;
 	std::vector<graph<node *> > itemFlow;
 	std::vector<graph<node *> > actor;
@@ -1131,11 +1219,15 @@ struct gocontext {
 	memory_size_type files;
 	memory_size_type memory;
 	phase_progress_indicator phaseProgress;
+	std::mutex subphaseProgressMutex;
+	std::vector<std::unique_ptr<concurrent_progress_indicator> > subphaseProgress;
 };
 
 
 runtime::runtime(node_map::ptr nodeMap)
 	: m_nodeMap(*nodeMap)
+	, m_concurrentPhases(false)
+	, m_profile(nullptr)
 {
 }
 
@@ -1171,6 +1263,17 @@ gocontext_ptr runtime::go_init(stream_size_type items,
 	std::unordered_set<node_map::id_t> evacuateWhenDone;
 	get_phases(phaseMap, phaseGraph, evacuateWhenDone, phases);
 
+	// Merge phases that may run at the same time
+	std::vector<std::vector<std::vector<node *> > > subphases;
+	if (m_concurrentPhases) {
+		merge_independent_phases(phaseMap, phaseGraph, evacuateWhenDone, phases, subphases);
+	} else {
+		for (const auto & phase : phases)
+			subphases.push_back(std::vector<std::vector<node *> >(1, phase));
+	}
+
+	if (m_profile) init_profile(phases);
+
 	// Build item flow graph and actor graph for each phase
 	std::vector<graph<node *> > itemFlow;
 	get_item_flow_graphs(phases, itemFlow);
@@ -1215,6 +1318,7 @@ gocontext_ptr runtime::go_init(stream_size_type items,
 			std::move(phaseMap),
 				std::move(phaseGraph),
 				std::move(phases),
+				std::move(subphases),
 				std::move(evacuateWhenDone),
 				std::move(itemFlow),
 				std::move(actor),
@@ -1223,7 +1327,9 @@ gocontext_ptr runtime::go_init(stream_size_type items,
 				0,
 				files,
 				memory,
-				phase_progress_indicator()});
+				phase_progress_indicator(),
+				{},
+				{}});
 }
 	
 
@@ -1231,7 +1337,7 @@ void runtime::go_until(gocontext * gc, node * node) {
 	if (gc->i > gc->phases.size()) return;
 	
 	if (gc->i != 0) {
-		begin_end beginEnd(gc->actor[gc->i-1]);
+		begin_end beginEnd(gc->actor[gc->i-1], m_nodeProfiles);
 		beginEnd.end();
 	}
 
@@ -1242,6 +1348,10 @@ void runtime::go_until(gocontext * gc, node * node) {
 		log_debug() << "Running pipe phase " << get_phase_name(phase) << std::endl;
 		
 		if (gc->i > 0) evacuate_all(gc->phases[gc->i-1], gc->evacuateWhenDone);
+
+		phase_profile * phaseProfile = m_profile ? &m_profile->phases[gc->i] : nullptr;
+		profile_timer<phase_profile> phaseTimer(phaseProfile);
+		const memory_size_type memoryBaseline = get_memory_manager().used();
 			
 		// call propagate in item source to item sink order
 		propagate_all(gc->itemFlow[gc->i]);
@@ -1250,6 +1360,13 @@ void runtime::go_until(gocontext * gc, node * node) {
 		// reassign memory to all nodes in the phase
 		reassign_memory(gc->phases, gc->i, gc->memory, gc->drt);
 
+		if (phaseProfile) {
+			for (auto n : phase) {
+				get_node_profile(n)->memoryAssigned = n->get_available_memory();
+				phaseProfile->memoryAssigned += n->get_available_memory();
+			}
+		}
+
 		bool emptyFace = true;
 		for (auto n: phase)
 			if (is_initiator(n) && !n->is_go_free())
@@ -1259,10 +1376,20 @@ void runtime::go_until(gocontext * gc, node * node) {
 		gc->phaseProgress = phase_progress_indicator(gc->pi, gc->i, phase, emptyFace);
 		
 		// set progress indicators on each node
-		set_progress_indicators(phase, gc->phaseProgress.get());
+		const auto & subphases = gc->subphases[gc->i];
+		if (subphases.size() == 1) {
+			set_progress_indicators(phase, gc->phaseProgress.get());
+		} else {
+			for (const auto & subphase : subphases) {
+				gc->subphaseProgress.emplace_back(new concurrent_progress_indicator(
+					gc->phaseProgress.get(), gc->subphaseProgressMutex));
+				set_progress_indicators(subphase, *gc->subphaseProgress.back());
+			}
+		}
 		// call begin in leaf to root actor order
-		begin_end beginEnd(gc->actor[gc->i]);
+		begin_end beginEnd(gc->actor[gc->i], m_nodeProfiles);
 		beginEnd.begin();
+		if (phaseProfile) sample_memory(phase, *phaseProfile, memoryBaseline);
 		
 		// call go on initiators
 		for (auto n: phase)
@@ -1270,11 +1397,26 @@ void runtime::go_until(gocontext * gc, node * node) {
 				gc->i++;
 				return;
 			}
-		go_initiators(gc->phases[gc->i]);
+		if (subphases.size() == 1)
+			go_initiators(gc->phases[gc->i]);
+		else
+			go_initiators_concurrently(subphases);
+
+		if (phaseProfile) sample_memory(phase, *phaseProfile, memoryBaseline);
 
 		// call end in root to leaf actor order
 		beginEnd.end();
 
+		if (phaseProfile) {
+			for (auto n : phase) {
+				if (n->m_parameters.stepsTotal != std::numeric_limits<stream_size_type>::max())
+					get_node_profile(n)->items = n->m_parameters.stepsTotal - n->m_stepsLeft;
+			}
+		}
+
+		for (auto & p : gc->subphaseProgress) p->flush();
+		gc->subphaseProgress.clear();
+
 		gc->drt.free_datastructures(gc->i);
 
 		// call pi.done in ~phase_progress_indicator
@@ -1290,9 +1432,12 @@ void runtime::go(stream_size_type items,
 				 memory_size_type memory,
 				 const char * file,
 				 const char * function) {
+	profile_timer<pipeline_profile> timer(m_profile);
+	if (m_profile) m_profile->memory = memory;
 	gocontext_ptr gc = go_init(items, progress, filesAvailable, memory, file, function);
 	// Check that each phase has at least one initiator
-	ensure_initiators(gc->phases);
+	for (const auto & subphases : gc->subphases)
+		ensure_initiators(subphases);
 	go_until(gc.get(), nullptr);
 }
 
@@ -1593,6 +1738,13 @@ void runtime::get_phases(const std::map<node *, size_t> & phaseMap,
 		phases[topoOrderMap[i->second]].push_back(i->first);
 	}
 
+	get_evacuate_when_done(phases, evacuateWhenDone);
+}
+
+/*static*/
+void runtime::get_evacuate_when_done(const std::vector<std::vector<node *> > & phases,
+									 std::unordered_set<node_map::id_t> & evacuateWhenDone)
+{
 	std::unordered_set<node_map::id_t> previousNodes;
 	bits::node_map::ptr nodeMap = (phases.front().front())->get_node_map()->find_authority();
 	for (const auto & phase : phases) {
@@ -1611,6 +1763,108 @@ void runtime::get_phases(const std::map<node *, size_t> & phaseMap,
 	}
 }
 
+void runtime::merge_independent_phases(const std::map<node *, size_t> & phaseMap,
+									   const graph<size_t> & phaseGraph,
+									   std::unordered_set<node_map::id_t> & evacuateWhenDone,
+									   std::vector<std::vector<node *> > & phases,
+									   std::vector<std::vector<std::vector<node *> > > & subphases)
+{
+	const size_t N = phases.size();
+	std::unordered_map<size_t, size_t> position;
+	for (size_t i = 0; i < N; ++i)
+		position[phaseMap.find(phases[i].front())->second] = i;
+
+	// Give each phase the earliest level after the phases it depends on and
+	// after the earlier phases using one of its datastructures.
+	// The phases are in topological order, so the levels of the phases a
+	// phase depends on are final when we reach it.
+	std::vector<size_t> level(N, 0);
+	std::vector<std::set<std::string> > datastructures(N);
+	size_t levels = 0;
+	for (size_t i = 0; i < N; ++i) {
+		for (auto n : phases[i])
+			for (const auto & ds : n->get_datastructures())
+				datastructures[i].insert(ds.first);
+		for (size_t j = 0; j < i; ++j) {
+			if (level[j] < level[i]) continue;
+			for (const auto & name : datastructures[i])
+				if (datastructures[j].count(name)) level[i] = level[j] + 1;
+		}
+		for (size_t v : phaseGraph.get_edge_list(phaseMap.find(phases[i].front())->second)) {
+			size_t & l = level[position[v]];
+			l = std::max(l, level[i] + 1);
+		}
+		levels = std::max(levels, level[i] + 1);
+	}
+
+	std::vector<std::vector<node *> > merged(levels);
+	std::vector<std::vector<std::vector<node *> > > mergedSubphases(levels);
+	for (size_t i = 0; i < N; ++i) {
+		merged[level[i]].insert(merged[level[i]].end(), phases[i].begin(), phases[i].end());
+		mergedSubphases[level[i]].push_back(phases[i]);
+	}
+
+	// Memory shared between phases that no longer run back to back
+	// has to be evacuated. Keep the sequential order if that is not possible.
+	std::unordered_set<node_map::id_t> mergedEvacuate;
+	get_evacuate_when_done(merged, mergedEvacuate);
+	bool ok = true;
+	for (node_map::id_t id : mergedEvacuate)
+		if (evacuateWhenDone.count(id) == 0 && !m_nodeMap.get(id)->can_evacuate())
+			ok = false;
+
+	subphases.clear();
+	if (!ok) {
+		log_debug() << "Running pipe phases sequentially to avoid evacuation" << std::endl;
+		for (const auto & phase : phases)
+			subphases.push_back(std::vector<std::vector<node *> >(1, phase));
+		return;
+	}
+
+	for (const auto & s : mergedSubphases)
+		if (s.size() > 1)
+			log_debug() << "Running " << s.size() << " pipe phases concurrently" << std::endl;
+
+	phases.swap(merged);
+	subphases.swap(mergedSubphases);
+	evacuateWhenDone.swap(mergedEvacuate);
+}
+
+void runtime::init_profile(const std::vector<std::vector<node *> > & phases) {
+	m_profile->phases.clear();
+	m_profile->phases.resize(phases.size());
+	m_nodeProfiles.clear();
+	for (size_t i = 0; i < phases.size(); ++i) {
+		phase_profile & p = m_profile->phases[i];
+		p.name = get_phase_name(phases[i]);
+		p.nodes.resize(phases[i].size());
+		for (size_t j = 0; j < phases[i].size(); ++j) {
+			node * n = phases[i][j];
+			p.nodes[j].name = n->get_name();
+			p.nodes[j].id = n->get_id();
+			m_nodeProfiles[n] = &p.nodes[j];
+		}
+	}
+}
+
+node_profile * runtime::get_node_profile(node * n) const {
+	if (!m_profile) return nullptr;
+	auto i = m_nodeProfiles.find(n);
+	return i == m_nodeProfiles.end() ? nullptr : i->second;
+}
+
+void runtime::sample_memory(const std::vector<node *> & phase,
+							phase_profile & profile,
+							memory_size_type baseline) const {
+	const memory_size_type used = get_memory_manager().used();
+	if (used > baseline)
+		profile.memoryUsed = std::max<uint64_t>(profile.memoryUsed, used - baseline);
+	for (auto n : phase) {
+		node_profile * p = get_node_profile(n);
+		p->memoryUsed = std::max<uint64_t>(p->memoryUsed, n->get_used_memory());
+	}
+}
+
 void runtime::get_item_flow_graphs(std::vector<std::vector<node *> > & phases,
 								   std::vector<graph<node *> > & itemFlow)
 {
@@ -1671,6 +1925,7 @@ void runtime::prepare_all(const std::vector<graph<node *> > & itemFlow) {
 		std::vector<node *> topoOrder;
 		g.topological_order(topoOrder);
 		for (size_t i = 0; i < topoOrder.size(); ++i) {
+			profile_timer<node_profile> t(get_node_profile(topoOrder[i]));
 			topoOrder[i]->set_state(node::STATE_IN_PREPARE);
 			topoOrder[i]->prepare();
 			topoOrder[i]->set_state(node::STATE_AFTER_PREPARE);
@@ -1696,6 +1951,7 @@ void runtime::propagate_all(const graph<node *> & itemFlow) {
 	std::vector<node *> topoOrder;
 	itemFlow.topological_order(topoOrder);
 	for (size_t i = 0; i < topoOrder.size(); ++i) {
+		profile_timer<node_profile> t(get_node_profile(topoOrder[i]));
 		topoOrder[i]->set_state(node::STATE_IN_PROPAGATE);
 		topoOrder[i]->propagate();
 		topoOrder[i]->set_state(node::STATE_AFTER_PROPAGATE);
@@ -1713,12 +1969,35 @@ void runtime::go_initiators(const std::vector<node *> & phase) {
 	for (size_t i = 0; i < phase.size(); ++i)
 		if (is_initiator(phase[i])) initiators.push_back(phase[i]);
 	for (size_t i = 0; i < initiators.size(); ++i) {
+		profile_timer<node_profile> t(get_node_profile(initiators[i]));
 		initiators[i]->set_state(node::STATE_IN_GO);
 		initiators[i]->go();
 		initiators[i]->set_state(node::STATE_AFTER_BEGIN);
 	}
 }
 
+void runtime::go_initiators_concurrently(const std::vector<std::vector<node *> > & subphases) {
+	std::vector<std::exception_ptr> errors(subphases.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < subphases.size(); ++i) {
+		threads.emplace_back([this, &subphases, &errors, i]() {
+			try {
+				go_initiators(subphases[i]);
+			} catch (...) {
+				errors[i] = std::current_exception();
+			}
+		});
+	}
+	try {
+		go_initiators(subphases[0]);
+	} catch (...) {
+		errors[0] = std::current_exception();
+	}
+	for (auto & t : threads) t.join();
+	for (const auto & e : errors)
+		if (e) std::rethrow_exception(e);
+}
+
 /*static*/
 void runtime::set_resource_being_assigned(const std::vector<node *> & nodes,
 										  resource_type type) {
@@ -23,7 +23,9 @@
 #include <tpie/fractional_progress.h>
 #include <tpie/pipelining/tokens.h>
 #include <tpie/pipelining/node.h>
+#include <tpie/pipelining/profile.h>
 #include <set>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace tpie {
@@ -50,6 +52,9 @@ typedef std::unique_ptr<gocontext, gocontextdel> gocontext_ptr;
 ///////////////////////////////////////////////////////////////////////////////
 class runtime {
 	node_map & m_nodeMap;
+	bool m_concurrentPhases;
+	pipeline_profile * m_profile;
+	std::unordered_map<node *, node_profile *> m_nodeProfiles;
 
 public:
 	///////////////////////////////////////////////////////////////////////////
@@ -59,6 +64,28 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	runtime(node_map::ptr nodeMap);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Run independent phases concurrently.
+	///
+	/// When enabled, go() merges phases that do not depend on each other,
+	/// directly or indirectly, into a single phase. Files and
+	/// memory are then divided between the merged phases as between the
+	/// nodes of one phase, and the initiators of each of the original phases
+	/// are run on a thread of their own. Phases using a common
+	/// datastructure are never merged. Disabled by default.
+	///////////////////////////////////////////////////////////////////////////
+	void set_concurrent_phases(bool enabled) {
+		m_concurrentPhases = enabled;
+	}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Record a profile of the run in the given object, or stop
+	/// profiling if it is null. See profile.h.
+	///////////////////////////////////////////////////////////////////////////
+	void set_profile(pipeline_profile * profile) {
+		m_profile = profile;
+	}
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Number of nodes contained in node map.
 	///
@@ -153,6 +180,46 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Internal method used by go().
 	///////////////////////////////////////////////////////////////////////////
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Compute the nodes whose memory must be evacuated when their
+	/// phase is done, as described for get_phases().
+	///////////////////////////////////////////////////////////////////////////
+	static void get_evacuate_when_done(const std::vector<std::vector<node *> > & phases,
+									   std::unordered_set<node_map::id_t> & evacuateWhenDone);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Merge phases that can run at the same time.
+	///
+	/// Internal method used by go_init() when concurrent phases are enabled.
+	/// Each phase is placed at the earliest level after the phases it
+	/// depends on, and the phases of a level are merged into one. On return,
+	/// subphases[i] holds the original phases merged into phases[i]. If the
+	/// new order would require evacuating a node that cannot be evacuated,
+	/// the phases are left as they are.
+	///////////////////////////////////////////////////////////////////////////
+	void merge_independent_phases(const std::map<node *, size_t> & phaseMap,
+								  const graph<size_t> & phaseGraph,
+								  std::unordered_set<node_map::id_t> & evacuateWhenDone,
+								  std::vector<std::vector<node *> > & phases,
+								  std::vector<std::vector<std::vector<node *> > > & subphases);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Set up the profile of each phase and node.
+	///////////////////////////////////////////////////////////////////////////
+	void init_profile(const std::vector<std::vector<node *> > & phases);
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  The profile of the given node, or null when not profiling.
+	///////////////////////////////////////////////////////////////////////////
+	node_profile * get_node_profile(node * n) const;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Record the memory currently used by the nodes of a phase.
+	///////////////////////////////////////////////////////////////////////////
+	void sample_memory(const std::vector<node *> & phase,
+					   phase_profile & profile,
+					   memory_size_type baseline) const;
+
 	void get_item_flow_graphs(std::vector<std::vector<node *> > & phases,
 							  std::vector<graph<node *> > & itemFlow);
 
@@ -217,6 +284,15 @@ public:
 	///////////////////////////////////////////////////////////////////////////
 	void go_initiators(const std::vector<node *> & phase);
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief  Call go() on the initiators of each of the given phases on a
+	/// thread per phase, and wait for all of them.
+	///
+	/// If any initiator throws, the first exception is rethrown once all
+	/// threads are done.
+	///////////////////////////////////////////////////////////////////////////
+	void go_initiators_concurrently(const std::vector<std::vector<node *> > & subphases);
+
 	///////////////////////////////////////////////////////////////////////////
 	/// \brief  Internal method used by go().
 	///////////////////////////////////////////////////////////////////////////
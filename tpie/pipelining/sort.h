@@ -24,6 +24,7 @@
 #include <tpie/pipelining/pipe_base.h>
 #include <tpie/pipelining/factory_base.h>
 #include <tpie/pipelining/merge_sorter.h>
+#include <tpie/pipelining/push_batch.h>
 #include <tpie/parallel_sort.h>
 #include <tpie/file_stream.h>
 #include <tpie/tempname.h>
@@ -190,6 +191,16 @@ public:
 	}
 	
 	virtual void go() override {
+		push_sorted(std::integral_constant<bool, accepts_push_batch<dest_t, item_type>::value
+										   && std::is_copy_assignable<item_type>::value>());
+	}
+
+	void end() override {
+		this->m_sorter.reset();
+	}
+
+private:
+	void push_sorted(std::false_type) {
 		while (this->m_sorter->can_pull()) {
 			item_type && y=this->m_sorter->pull();
 			dest.push(std::move(y));
@@ -197,11 +208,17 @@ public:
 		}
 	}
 
-	void end() override {
-		this->m_sorter.reset();
+	void push_sorted(std::true_type) {
+		array<item_type> batch(push_batch_items<item_type>());
+		while (this->m_sorter->can_pull()) {
+			size_t n = 0;
+			while (n < batch.size() && this->m_sorter->can_pull())
+				batch[n++] = this->m_sorter->pull();
+			dest.push_batch(array_view<const item_type>(batch.get(), n));
+			this->step(n);
+		}
 	}
 
-private:
 	dest_t dest;
 };
 
@@ -352,6 +369,10 @@ public:
 		m_sorter->push(item);
 	}
 
+	void push_batch(array_view<const item_type> items) {
+		m_sorter->push_batch(items);
+	}
+
 	void begin() override {
 		m_sorter->begin();
 		m_sorter->set_owner(this);
@@ -414,11 +435,11 @@ public:
 		typedef typename store_t::template element_type<item_type>::type element_type;
 		typedef typename constructed<dest_t>::pred_type pred_type;
 
-		sort_output_t<pred_type, dest_t, store_t> output(
-			std::move(dest),
-			std::make_shared<merge_sorter<item_type, true, pred_type, store_t> > (
-				self().template get_pred<element_type>(), 
-				m_store));
+		auto sorter = std::make_shared<merge_sorter<item_type, true, pred_type, store_t> > (
+			self().template get_pred<element_type>(), 
+			m_store);
+		if (m_mergeThreads > 1) sorter->set_parallel_merge(m_mergeThreads);
+		sort_output_t<pred_type, dest_t, store_t> output(std::move(dest), std::move(sorter));
 		this->init_sub_node(output);
 		sort_calc_t<item_type, pred_type, store_t> calc(std::move(output));
 		this->init_sub_node(calc);
@@ -428,9 +449,18 @@ public:
 		return std::move(input);
 	}
 
-	sort_factory_base(store_t store): m_store(store) {}
+	sort_factory_base(store_t store): m_store(store), m_mergeThreads(1) {}
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Merge runs on the given number of threads.
+	/// \sa merge_sorter::set_parallel_merge
+	///////////////////////////////////////////////////////////////////////////
+	void set_parallel_merge(memory_size_type threads) {
+		m_mergeThreads = threads;
+	}
 private:
 	store_t m_store;
+	memory_size_type m_mergeThreads;
 
 };
 
@@ -537,6 +567,33 @@ sort(const pred_t & p, store_t store) {
 	return pipe_middle<fact>(fact(p, store)).name("Sort");
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Pipelining sorter using std::less that merges runs on the given
+/// number of threads.
+/// \sa merge_sorter::set_parallel_merge
+///////////////////////////////////////////////////////////////////////////////
+inline pipe_middle<bits::default_pred_sort_factory<default_store> >
+parallel_merge_sort(memory_size_type threads) {
+	typedef bits::default_pred_sort_factory<default_store> fact;
+	fact f((default_store()));
+	f.set_parallel_merge(threads);
+	return pipe_middle<fact>(std::move(f)).name("Sort");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Pipelining sorter using the given predicate that merges runs on the
+/// given number of threads.
+/// \sa merge_sorter::set_parallel_merge
+///////////////////////////////////////////////////////////////////////////////
+template <typename pred_t>
+inline pipe_middle<bits::sort_factory<pred_t, default_store> >
+parallel_merge_sort(const pred_t & p, memory_size_type threads) {
+	typedef bits::sort_factory<pred_t, default_store> fact;
+	fact f(p, default_store());
+	f.set_parallel_merge(threads);
+	return pipe_middle<fact>(std::move(f)).name("Sort");
+}
+
 template <typename T, typename pred_t=std::less<T>, typename store_t=default_store>
 class passive_sorter;
 
@@ -624,6 +681,16 @@ public:
 		, m_sorterOutput(m_sorterInput)
 		{}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Merge runs on the given number of threads.
+	/// Must be called before input().
+	/// \sa merge_sorter::set_parallel_merge
+	///////////////////////////////////////////////////////////////////////////
+	void set_parallel_merge(memory_size_type threads) {
+		tp_assert(m_sorterInput, "set_parallel_merge() called after input()");
+		m_sorterInput->set_parallel_merge(threads);
+	}
+
 	passive_sorter(const passive_sorter &) = delete;
 	passive_sorter & operator=(const passive_sorter &) = delete;
 	passive_sorter(passive_sorter && ) = default;
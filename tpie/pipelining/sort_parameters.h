@@ -51,12 +51,16 @@ struct sort_parameters {
 	memory_size_type fanout;
 	/** Fanout of merge tree during phase 3. Less or equal to fanout. */
 	memory_size_type finalFanout;
+	/** Whether phase 1 uses two run buffers, so that one run is sorted and
+	 * written in the background while the next one is filled. */
+	bool doubleBuffered;
 
 	void dump(std::ostream & out) const {
 		out << "Merge sort parameters\n"
 			<< "Phase 1 files:               " << filesPhase1 << '\n'
 			<< "Phase 1 memory:              " << memoryPhase1 << '\n'
 			<< "Run length:                  " << runLength << '\n'
+			<< "Double buffered runs:        " << (doubleBuffered ? "yes" : "no") << '\n'
 			<< "Phase 2 files:               " << filesPhase2 << '\n'
 			<< "Phase 2 memory:              " << memoryPhase2 << '\n'
 			<< "Fanout:                      " << fanout << '\n'
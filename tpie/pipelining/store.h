@@ -20,6 +20,7 @@
 #ifndef __TPIE_PIPELINING_STORE_H__
 #define __TPIE_PIPELINING_STORE_H__
 #include <tpie/memory.h>
+#include <tpie/radix_sort.h>
 namespace tpie {
 
 namespace bits {
@@ -52,6 +53,24 @@ public:
 };
 } //namespace bits
 
+/**
+ * \brief Radix sort the internal sort buffer whenever the elements behind
+ * the stored items can be radix sorted.
+ */
+template <typename pred_t, typename specific_store_t>
+struct radix_key<typename specific_store_t::store_type, bits::store_pred<pred_t, specific_store_t>,
+				 typename std::enable_if<radix_key<typename specific_store_t::element_type, pred_t>::enabled>::type> {
+private:
+	typedef radix_key<typename specific_store_t::element_type, pred_t> element_key;
+public:
+	static const bool enabled = true;
+	typedef typename element_key::key_type key_type;
+
+	static key_type key(const typename specific_store_t::store_type & e) {
+		return element_key::key(specific_store_t::store_as_element(e));
+	}
+};
+
 /**
  * \brief Plain old store
  *
@@ -29,6 +29,7 @@
 #include <tpie/pipelining/pipeline.h>
 #include <tpie/pipelining/factory_helpers.h>
 #include <tpie/pipelining/helpers.h>
+#include <tpie/pipelining/push_batch.h>
 
 namespace tpie {
 
@@ -85,8 +86,16 @@ class virtsrc : public node {
 	typedef typename maybe_add_const_ref<Input>::type input_type;
 
 public:
+	/** Type of the items in a batch. */
+	typedef typename std::decay<Input>::type batch_item_type;
+
 	virtual const node_token & get_token() = 0;
 	virtual void push(input_type v) = 0;
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Push a batch of items with a single virtual call.
+	///////////////////////////////////////////////////////////////////////////
+	virtual void push_batch(array_view<const batch_item_type> items) = 0;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -117,6 +126,10 @@ public:
 	void push(input_type v) {
 		dest.push(v);
 	}
+
+	void push_batch(array_view<const typename virtsrc<T>::batch_item_type> items) {
+		push_batch_to(dest, items);
+	}
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -159,6 +172,10 @@ public:
 		m_virtdest->push(v);
 	}
 
+	void push_batch(array_view<const typename virtsrc<Output>::batch_item_type> items) {
+		m_virtdest->push_batch(items);
+	}
+
 	void set_destination(virtsrc<Output> * dest) {
 		if (m_virtdest != 0) {
 			throw tpie::exception("Virtual destination set twice");
@@ -639,6 +656,11 @@ public:
 			if (dest2) dest2->push(v);
 		}
 
+		void push_batch(array_view<const typename virtsrc<T>::batch_item_type> items) {
+			push_batch_to(dest, items);
+			if (dest2) dest2->push_batch(items);
+		}
+
 	private:
 		// This counted reference ensures dest2 is not deleted prematurely.
 		virt_node::ptr vnode;
@@ -666,6 +688,10 @@ public:
 		if (dest) dest->push(v);
 	}
 
+	void push_batch(array_view<const typename virtsrc<T>::batch_item_type> items) {
+		if (dest) dest->push_batch(items);
+	}
+
 private:
 	// This counted reference ensures dest is not deleted prematurely.
 	virt_node::ptr vnode;
@@ -0,0 +1,309 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet cino+=(0 :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file radix_sort.h
+/// In-place parallel MSD radix sort for items with an unsigned integer key.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __TPIE_RADIX_SORT_H__
+#define __TPIE_RADIX_SORT_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/iterator/iterator_traits.hpp>
+#include <tpie/dummy_progress.h>
+#include <tpie/job.h>
+#include <tpie/config.h>
+
+namespace tpie {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Key extractor used to radix sort items of type T ordered by
+/// comp_t.
+///
+/// The primary template is disabled. A specialization sets enabled to true,
+/// defines an unsigned integral key_type and a static key() such that
+/// comp_t()(x, y) holds exactly when key(x) < key(y). Specializations are
+/// provided for integral types under std::less and std::greater; a POD
+/// struct sorted on an integer member can be enabled by specializing this
+/// trait for its comparator:
+///
+/// \code
+/// template <>
+/// struct radix_key<my_item, my_item_less> {
+///     static const bool enabled = true;
+///     typedef uint64_t key_type;
+///     static key_type key(const my_item & x) {return x.id;}
+/// };
+/// \endcode
+///////////////////////////////////////////////////////////////////////////////
+template <typename T, typename comp_t, typename Enable = void>
+struct radix_key {
+	static const bool enabled = false;
+};
+
+namespace bits {
+
+template <typename T>
+struct is_radix_integer
+	: std::integral_constant<bool, std::is_integral<T>::value
+							 && !std::is_same<T, bool>::value> {};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Map an integer to an unsigned key with the same ordering by
+/// flipping the sign bit of signed types.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+struct integer_radix_key {
+	static const bool enabled = true;
+	typedef typename std::make_unsigned<T>::type key_type;
+
+	static key_type key(const T & x) {
+		return static_cast<key_type>(static_cast<key_type>(x) ^ sign_bit());
+	}
+
+private:
+	static constexpr key_type sign_bit() {
+		return std::is_signed<T>::value
+			? static_cast<key_type>(key_type(1) << (8*sizeof(key_type)-1))
+			: key_type(0);
+	}
+};
+
+template <typename T>
+struct reverse_integer_radix_key {
+	static const bool enabled = true;
+	typedef typename integer_radix_key<T>::key_type key_type;
+
+	static key_type key(const T & x) {
+		return static_cast<key_type>(~integer_radix_key<T>::key(x));
+	}
+};
+
+} // namespace bits
+
+template <typename T>
+struct radix_key<T, std::less<T>,
+				 typename std::enable_if<bits::is_radix_integer<T>::value>::type>
+	: public bits::integer_radix_key<T> {};
+
+template <typename T>
+struct radix_key<T, std::greater<T>,
+				 typename std::enable_if<bits::is_radix_integer<T>::value>::type>
+	: public bits::reverse_integer_radix_key<T> {};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief In-place most significant digit first radix sort.
+///
+/// Each level counts the current byte of the keys, permutes the range into
+/// 256 buckets by cycle leading (American flag sort) and recurses on the
+/// next byte of each bucket. No memory beyond two small count arrays per
+/// level is used. Small buckets are finished with std::sort on the keys,
+/// and buckets of at least min_size items are handed to the TPIE job
+/// manager.
+///////////////////////////////////////////////////////////////////////////////
+template <typename iterator_type, typename comp_type,
+		  size_t min_size=1024*1024*8/sizeof(typename boost::iterator_value<iterator_type>::type)>
+class parallel_radix_sort_impl {
+private:
+	typedef typename boost::iterator_value<iterator_type>::type value_type;
+	typedef radix_key<value_type, comp_type> key_extractor;
+	typedef typename key_extractor::key_type key_type;
+
+	static_assert(key_extractor::enabled, "radix_key is not enabled for this item type and comparator");
+	static_assert(std::is_unsigned<key_type>::value, "radix_key::key_type must be unsigned");
+
+	static const size_t radix = 256;
+	static const size_t small_size = 64;
+
+	struct key_less {
+		bool operator()(const value_type & a, const value_type & b) const {
+			return key_extractor::key(a) < key_extractor::key(b);
+		}
+	};
+
+	static size_t digit(const value_type & v, unsigned shift) {
+		return static_cast<size_t>((key_extractor::key(v) >> shift) & (radix - 1));
+	}
+
+#ifdef DOXYGEN
+public:
+#endif
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Represents radix sort work on one bucket.
+	///////////////////////////////////////////////////////////////////////////
+	class radix_job : public job {
+	public:
+		radix_job(iterator_type a, iterator_type b, unsigned shift)
+			: a(a), b(b), shift(shift) {
+		}
+
+		~radix_job() {
+			for (size_t i = 0; i < children.size(); ++i) {
+				delete children[i];
+			}
+			children.resize(0);
+		}
+
+		virtual void operator()() override {
+			sort_bucket(a, b, shift, this);
+		}
+
+		void add_child(radix_job * j) {
+			j->enqueue(this);
+			children.push_back(j);
+		}
+
+	private:
+		iterator_type a;
+		iterator_type b;
+		unsigned shift;
+
+		// Children are deleted with their parent; see qsort_job::on_done.
+		std::vector<radix_job *> children;
+	};
+
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Sort [a,b) on the bytes at position shift and below. Buckets
+	/// large enough are spawned as children of parent unless parent is null.
+	///////////////////////////////////////////////////////////////////////////
+	static void sort_bucket(iterator_type a, iterator_type b, unsigned shift, radix_job * parent) {
+		while (true) {
+			const size_t n = static_cast<size_t>(b - a);
+			if (n <= small_size) {
+				std::sort(a, b, key_less());
+				return;
+			}
+
+			size_t count[radix] = {};
+			for (iterator_type i = a; i != b; ++i) ++count[digit(*i, shift)];
+
+			if (count[digit(*a, shift)] == n) {
+				// Every key shares this byte; go straight to the next one.
+				if (shift == 0) return;
+				shift -= 8;
+				continue;
+			}
+
+			size_t head[radix];
+			size_t tail[radix];
+			size_t offset = 0;
+			for (size_t d = 0; d < radix; ++d) {
+				head[d] = offset;
+				offset += count[d];
+				tail[d] = offset;
+			}
+
+			for (size_t d = 0; d < radix; ++d) {
+				while (head[d] < tail[d]) {
+					value_type v = std::move(*(a + head[d]));
+					size_t k = digit(v, shift);
+					while (k != d) {
+						std::swap(v, *(a + head[k]++));
+						k = digit(v, shift);
+					}
+					*(a + head[d]++) = std::move(v);
+				}
+			}
+
+			if (shift == 0) return;
+
+			iterator_type start = a;
+			for (size_t d = 0; d < radix; ++d) {
+				iterator_type end = start + count[d];
+				if (count[d] >= min_size && parent)
+					parent->add_child(new radix_job(start, end, shift - 8));
+				else if (count[d] > 1)
+					sort_bucket(start, end, shift - 8, parent);
+				start = end;
+			}
+			return;
+		}
+	}
+
+public:
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Sort the items in [a,b). Waits until all workers are done.
+	///////////////////////////////////////////////////////////////////////////
+	void operator()(iterator_type a, iterator_type b) {
+		const unsigned top = static_cast<unsigned>(8 * (sizeof(key_type) - 1));
+#ifdef TPIE_PARALLEL_SORT
+		if (static_cast<size_t>(b - a) >= min_size) {
+			radix_job * master = new radix_job(a, b, top);
+			master->enqueue();
+			master->join();
+			delete master;
+			return;
+		}
+#endif
+		sort_bucket(a, b, top, nullptr);
+	}
+};
+
+namespace bits {
+
+///////////////////////////////////////////////////////////////////////////////
+/// Below this many items the comparison sort wins over the radix sort.
+///////////////////////////////////////////////////////////////////////////////
+const size_t radix_sort_min_items = 2048;
+
+template <typename iterator_type, typename comp_type, typename progress_t>
+bool try_radix_sort(iterator_type, iterator_type, progress_t &, std::false_type) {
+	return false;
+}
+
+template <typename iterator_type, typename comp_type, typename progress_t>
+bool try_radix_sort(iterator_type a, iterator_type b, progress_t & pi, std::true_type) {
+	if (static_cast<size_t>(b - a) < radix_sort_min_items) return false;
+	pi.init(1);
+	parallel_radix_sort_impl<iterator_type, comp_type> s;
+	s(a, b);
+	pi.done();
+	return true;
+}
+
+} // namespace bits
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Radix sort [a,b) if radix_key is enabled for the item type and
+/// comparator and the range is large enough to benefit.
+/// \param pi Progress tracker; initialized only if the range is sorted.
+/// \returns true if the range was sorted; false if the caller has to sort it.
+///////////////////////////////////////////////////////////////////////////////
+template <typename iterator_type, typename comp_type, typename progress_t>
+bool radix_sort_if_possible(iterator_type a, iterator_type b, const comp_type &, progress_t & pi) {
+	typedef typename boost::iterator_value<iterator_type>::type value_type;
+	return bits::try_radix_sort<iterator_type, comp_type>(a, b, pi,
+		std::integral_constant<bool, radix_key<value_type, comp_type>::enabled>());
+}
+
+template <typename iterator_type, typename comp_type>
+bool radix_sort_if_possible(iterator_type a, iterator_type b, const comp_type & comp) {
+	dummy_progress_indicator pi;
+	return radix_sort_if_possible(a, b, comp, pi);
+}
+
+} // namespace tpie
+
+#endif //__TPIE_RADIX_SORT_H__
@@ -275,7 +275,7 @@ bool reflect(R & r, const std::array<T, C> & v, TT && ... vs) {
 // reflect special case for std::array
 template <typename R, typename T, std::size_t C, typename ... TT>
 bool reflect(R & r, std::array<T, C> & v, TT && ... vs) {
-	typedef std::conditional_t<is_trivially_serializable<T>::value, std::true_type, std::false_type> tag;
+	typedef std::conditional_t<is_trivially_serializable2<T>::value, std::true_type, std::false_type> tag;
 	return reflect_static_array_dispatch<C>(tag(), r, v, vs...);
 }
 } //namespace tpie
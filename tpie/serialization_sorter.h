@@ -20,11 +20,12 @@
 #ifndef TPIE_SERIALIZATION_SORTER_H
 #define TPIE_SERIALIZATION_SORTER_H
 
-#include <queue>
 #include <boost/filesystem.hpp>
 
 #include <tpie/array.h>
 #include <tpie/array_view.h>
+#include <tpie/loser_tree.h>
+#include <tpie/parallel_merge.h>
 #include <tpie/tempname.h>
 #include <tpie/tpie_log.h>
 #include <tpie/stats.h>
@@ -427,71 +428,71 @@ private:
 
 template <typename T, typename pred_t>
 class merger {
-	class mergepred_t {
-		pred_t m_pred;
-
-	public:
-		typedef std::pair<T, size_t> item_type;
-
-		mergepred_t(const pred_t & pred) : m_pred(pred) {}
-
-		// Used with std::priority_queue, so invert the original relation.
-		bool operator()(const item_type & a, const item_type & b) const {
-			return m_pred(b.first, a.first);
-		}
-	};
-
-	typedef typename mergepred_t::item_type item_type;
-
 	file_handler<T> & files;
 	pred_t pred;
-	std::vector<serialization_reader> rd;
-	typedef std::priority_queue<item_type, std::vector<item_type>, mergepred_t> priority_queue_type;
-	priority_queue_type pq;
+	loser_tree<T, pred_t> lt;
+	parallel_merge_buffer<T, pred_t> m_parallel;
+	memory_size_type m_threads;
+	memory_size_type m_bufferItems;
 
 public:
 	merger(file_handler<T> & files, const pred_t & pred)
 		: files(files)
 		, pred(pred)
-		, pq(mergepred_t(pred))
+		, lt(pred)
+		, m_parallel(pred)
+		, m_threads(1)
+		, m_bufferItems(1)
 	{
 	}
 
+	// Merge disjoint key ranges of the runs on the given number of threads,
+	// buffering bufferItems items of each run.
+	void set_threads(memory_size_type threads, memory_size_type bufferItems) {
+		m_threads = std::max<memory_size_type>(threads, 1);
+		m_bufferItems = bufferItems;
+	}
+
 	// Assume files.open_readers(fanout) has just been called
 	void init(size_t fanout) {
-		rd.resize(fanout);
+		if (m_threads > 1) {
+			m_parallel.resize(fanout, m_threads, m_bufferItems);
+			m_parallel.fill(files);
+			return;
+		}
+		lt.resize(fanout);
 		for (size_t i = 0; i < fanout; ++i)
-			push_from(i);
+			if (files.can_read(i)) lt.unsafe_set(i, files.read(i));
+		lt.make_safe();
 	}
 
 	bool empty() const {
-		return pq.empty();
+		if (m_threads > 1) return m_parallel.empty();
+		return lt.empty();
 	}
 
 	const T & top() const {
-		return pq.top().first;
+		if (m_threads > 1) return m_parallel.top();
+		return lt.top();
 	}
 
 	void pop() {
-		size_t idx = pq.top().second;
-		pq.pop();
-		push_from(idx);
+		if (m_threads > 1) {
+			m_parallel.pop();
+			m_parallel.fill(files);
+			return;
+		}
+		size_t idx = lt.top_index();
+		if (files.can_read(idx))
+			lt.replace_top(files.read(idx));
+		else
+			lt.pop();
 	}
 
 	// files.close_readers_and_delete() should be called after this
 	void free() {
-		{
-			priority_queue_type tmp(pred);
-			std::swap(pq, tmp);
-		}
-		rd.resize(0);
-	}
-
-private:
-	void push_from(size_t idx) {
-		if (files.can_read(idx)) {
-			pq.push(std::make_pair(files.read(idx), idx));
-		}
+		lt.resize(0);
+		m_parallel.reset();
 	}
 };
 
@@ -521,6 +522,7 @@ private:
 	stream_size_type m_items;
 	bool m_reportInternal;
 	const T * m_nextInternalItem;
+	memory_size_type m_mergeThreads;
 
 	static const memory_size_type defaultFiles = 253; // Default number of files available, when not using set_available_files
 	static const memory_size_type minimumFilesPhase1 = 1;
@@ -547,6 +549,7 @@ public:
 		, m_items(0)
 		, m_reportInternal(false)
 		, m_nextInternalItem(0)
+		, m_mergeThreads(1)
 	{
 		m_params.filesPhase1 = 0;
 		m_params.filesPhase2 = 0;
@@ -630,6 +633,21 @@ public:
 		set_phase_3_memory(m3);
 	}
 
+	///////////////////////////////////////////////////////////////////////////
+	/// \brief Merge runs on the given number of threads.
+	///
+	/// Every merge, including the final merge, is split into key ranges by
+	/// splitters sampled from the runs, and the ranges are merged
+	/// concurrently on the job pool. Each run being merged then buffers about
+	/// 64 KiB of items, so the fanout may decrease. 1 (the default) merges
+	/// sequentially.
+	///////////////////////////////////////////////////////////////////////////
+	void set_parallel_merge(memory_size_type threads) {
+		if (m_state != state_initial)
+			throw tpie::exception("Bad state in set_parallel_merge");
+		m_mergeThreads = std::max<memory_size_type>(threads, 1);
+	}
+
 	static memory_size_type minimum_memory_phase_1() {
 		return serialization_writer::memory_usage()*2;
 	}
@@ -649,7 +667,7 @@ public:
 		if (m_reportInternal)
 			return m_sorter.memory_usage();
 		else
-			return m_files.next_level_runs() * (m_sorter.get_largest_item_size() + serialization_reader::memory_usage());
+			return m_files.next_level_runs() * per_fanout_memory(m_sorter.get_largest_item_size());
 	}
 
 	void set_owner(pipelining::node * n) {
@@ -666,6 +684,23 @@ public:
 		m_owning_node = n;
 	}
 private:
+	// Number of items of each run buffered when merging in parallel.
+	static memory_size_type merge_buffer_items(memory_size_type itemSize) {
+		return std::max<memory_size_type>(16, 64*1024 / std::max<memory_size_type>(itemSize, 1));
+	}
+
+	// Memory used per run being merged, given the largest item size.
+	memory_size_type per_fanout_memory(memory_size_type itemSize) const {
+		memory_size_type perFanout = itemSize + serialization_reader::memory_usage();
+		if (m_mergeThreads > 1) {
+			memory_size_type bufferItems = merge_buffer_items(itemSize);
+			perFanout += 2 * bufferItems * itemSize
+				+ static_cast<memory_size_type>(
+					parallel_merge_buffer<T, pred_t>::memory_usage(m_mergeThreads, bufferItems).coefficient);
+		}
+		return perFanout;
+	}
+
 	static memory_size_type clamp(memory_size_type lo, memory_size_type val, memory_size_type hi) {
 		return std::max(lo, std::min(val, hi));
 	}
@@ -728,7 +763,7 @@ private:
 		memory_size_type fanoutMemory = memForMerge - serialization_writer::memory_usage();
 
 		// This is a lower bound on the memory used per fanout.
-		memory_size_type perFanout = m_params.minimumItemSize + serialization_reader::memory_usage();
+		memory_size_type perFanout = per_fanout_memory(m_params.minimumItemSize);
 
 		// Floored division to compute the largest possible fanout.
 		memory_size_type fanout = std::min(fanoutMemory / perFanout, m_params.filesPhase2 - 1);
@@ -866,7 +901,7 @@ public:
 
 		memory_size_type largestItem = m_sorter.get_largest_item_size();
 		memory_size_type fanoutMemory = m_params.memoryPhase2 - serialization_writer::memory_usage();
-		memory_size_type perFanout = largestItem + serialization_reader::memory_usage();
+		memory_size_type perFanout = per_fanout_memory(largestItem);
 		memory_size_type fanout = std::min(m_params.filesPhase2 - 1, fanoutMemory / perFanout);
 		
 		memory_size_type finalFanoutMemory = m_params.memoryPhase3;
@@ -899,7 +934,7 @@ public:
 		// Perform almost the same computation as in calculate_parameters.
 		// Only change the item size to largestItem rather than minimumItemSize.
 		memory_size_type fanoutMemory = m_params.memoryPhase2 - serialization_writer::memory_usage();
-		memory_size_type perFanout = largestItem + serialization_reader::memory_usage();
+		memory_size_type perFanout = per_fanout_memory(largestItem);
 		memory_size_type fanout = std::min(fanoutMemory / perFanout, m_params.filesPhase2 - 1);
 
 		if (fanout < 2) {
@@ -960,6 +995,7 @@ private:
 	void initialize_merger(size_t fanout) {
 		if (fanout == 0) throw exception("initialize_merger: fanout == 0");
 		m_files.open_readers(fanout);
+		m_merger.set_threads(m_mergeThreads, merge_buffer_items(m_sorter.get_largest_item_size()));
 		m_merger.init(fanout);
 	}
 
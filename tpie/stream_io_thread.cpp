@@ -0,0 +1,156 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+#include <tpie/stream_io_thread.h>
+#include <tpie/exception.h>
+#include <tpie/tpie_log.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+class stream_io_thread {
+public:
+	stream_io_thread()
+		: m_running(false)
+		, m_done(false)
+	{
+	}
+
+	void start() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done = false;
+		m_thread = std::thread(&stream_io_thread::run, this);
+		m_running = true;
+	}
+
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_done = true;
+			m_newRequest.notify_one();
+		}
+		m_thread.join();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+
+	bool running() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_running;
+	}
+
+	void submit(tpie::stream_io_request & request) {
+		request.done = false;
+		request.error = std::exception_ptr();
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (!m_running) {
+			lock.unlock();
+			perform(request);
+			request.done = true;
+			return;
+		}
+		m_requests.push_back(&request);
+		m_newRequest.notify_one();
+	}
+
+	void wait(tpie::stream_io_request & request) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!request.done) m_requestDone.wait(lock);
+		lock.unlock();
+		if (request.error) {
+			std::exception_ptr error = request.error;
+			request.error = std::exception_ptr();
+			std::rethrow_exception(error);
+		}
+	}
+
+private:
+	void run() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			while (!m_done && m_requests.empty()) m_newRequest.wait(lock);
+			// Finish outstanding requests before stopping, since streams
+			// may still wait for them.
+			if (m_requests.empty()) break;
+			tpie::stream_io_request & request = *m_requests.front();
+			m_requests.pop_front();
+			lock.unlock();
+			perform(request);
+			lock.lock();
+			request.done = true;
+			m_requestDone.notify_all();
+		}
+	}
+
+	static void perform(tpie::stream_io_request & request) {
+		try {
+			if (request.write) {
+				request.accessor->write_block(request.data, request.block, request.items);
+			} else if (request.accessor->read_block(request.data, request.block, request.items)
+					   != request.items) {
+				throw tpie::io_exception("Incorrect number of items read");
+			}
+		} catch (...) {
+			request.error = std::current_exception();
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_newRequest;
+	std::condition_variable m_requestDone;
+	std::deque<tpie::stream_io_request *> m_requests;
+	std::thread m_thread;
+	bool m_running;
+	bool m_done;
+};
+
+stream_io_thread the_stream_io_thread;
+
+} // unnamed namespace
+
+namespace tpie {
+
+void stream_io_submit(stream_io_request & request) {
+	the_stream_io_thread.submit(request);
+}
+
+void stream_io_wait(stream_io_request & request) {
+	the_stream_io_thread.wait(request);
+}
+
+void init_stream_io_thread() {
+	if (the_stream_io_thread.running()) {
+		log_debug() << "Attempted to initiate stream I/O thread twice" << std::endl;
+		return;
+	}
+	the_stream_io_thread.start();
+}
+
+void finish_stream_io_thread() {
+	if (!the_stream_io_thread.running()) {
+		log_debug() << "Attempted to finish stream I/O thread that was never initiated" << std::endl;
+		return;
+	}
+	the_stream_io_thread.stop();
+}
+
+} // namespace tpie
@@ -0,0 +1,83 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: t; c-file-style: "stroustrup"; -*-
+// vi:set ts=4 sts=4 sw=4 noet :
+// Copyright 2024, The TPIE development team
+//
+// This file is part of TPIE.
+//
+// TPIE is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the
+// Free Software Foundation, either version 3 of the License, or (at your
+// option) any later version.
+//
+// TPIE is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with TPIE.  If not, see <http://www.gnu.org/licenses/>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \file stream_io_thread.h  Background block I/O for uncompressed streams.
+///
+/// Uncompressed streams with read-ahead or write-behind enabled hand their
+/// block transfers to a single background thread, which performs them in
+/// the order they were submitted. Since requests are served in order, a
+/// read submitted after a write of the same block sees the written data.
+///
+/// The thread is started by tpie_init() as part of the STREAMS subsystem.
+/// If it is not running, requests are performed synchronously on submit.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TPIE_STREAM_IO_THREAD_H
+#define TPIE_STREAM_IO_THREAD_H
+
+#include <tpie/types.h>
+#include <tpie/file_accessor/file_accessor.h>
+#include <exception>
+
+namespace tpie {
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A block read or write to be performed by the stream I/O thread.
+///
+/// The request must not be moved or destroyed while it is pending, that is,
+/// between stream_io_submit() and the matching stream_io_wait().
+///////////////////////////////////////////////////////////////////////////////
+struct stream_io_request {
+	file_accessor::file_accessor * accessor;
+	bool write;
+	void * data;
+	stream_size_type block;
+	memory_size_type items;
+
+	/** Set by the I/O thread when the transfer has been performed. */
+	bool done;
+	/** Exception thrown by the transfer, rethrown by stream_io_wait(). */
+	std::exception_ptr error;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Queue a request for the stream I/O thread.
+///////////////////////////////////////////////////////////////////////////////
+void stream_io_submit(stream_io_request & request);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Wait for a submitted request to complete, and rethrow any
+/// exception raised while performing it.
+///////////////////////////////////////////////////////////////////////////////
+void stream_io_wait(stream_io_request & request);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \internal \brief Used by tpie_init to start the stream I/O thread.
+///////////////////////////////////////////////////////////////////////////////
+void init_stream_io_thread();
+
+///////////////////////////////////////////////////////////////////////////////
+/// \internal \brief Used by tpie_finish to stop the stream I/O thread.
+///////////////////////////////////////////////////////////////////////////////
+void finish_stream_io_thread();
+
+} // namespace tpie
+
+#endif // TPIE_STREAM_IO_THREAD_H
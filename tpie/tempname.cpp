@@ -53,6 +53,7 @@ namespace {
 std::string default_path;
 std::string default_base_name = "TPIE";
 std::string default_extension;
+bool default_direct_io = false;
 std::stack<std::string> subdirs;
 
 }
@@ -305,6 +306,14 @@ const std::string& tempname::get_default_extension() {
 	return default_extension;
 }
 
+void tempname::set_default_direct_io(bool directIO) {
+	default_direct_io = directIO;
+}
+
+bool tempname::get_default_direct_io() {
+	return default_direct_io;
+}
+
 namespace tpie {
 namespace bits {
 
@@ -316,9 +325,9 @@ temp_file_inner::~temp_file_inner() {
 	update_recorded_size(0);
 }
 
-temp_file_inner::temp_file_inner() : m_persist(false), m_recordedSize(0), m_count(0) {}
+temp_file_inner::temp_file_inner() : m_persist(false), m_directIO(default_direct_io), m_recordedSize(0), m_count(0) {}
 
-temp_file_inner::temp_file_inner(const std::string & path, bool persist): m_path(path), m_persist(persist), m_recordedSize(0), m_count(0) {}
+temp_file_inner::temp_file_inner(const std::string & path, bool persist): m_path(path), m_persist(persist), m_directIO(false), m_recordedSize(0), m_count(0) {}
 
 const std::string & temp_file_inner::path() {
 	if(m_path.empty())
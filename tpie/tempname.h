@@ -132,6 +132,20 @@ namespace tpie {
 		///////////////////////////////////////////////////////////////////////
 		static const std::string& get_default_extension();
 
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Set whether new anonymous temporary files are accessed
+		/// with direct I/O, bypassing the operating system page cache.
+		/// Only uncompressed streams honour it. Defaults to false.
+		/// \sa temp_file::set_direct_io
+		///////////////////////////////////////////////////////////////////////
+		static void set_default_direct_io(bool directIO);
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Get whether new anonymous temporary files use direct I/O.
+		/// \sa set_default_direct_io
+		///////////////////////////////////////////////////////////////////////
+		static bool get_default_direct_io();
+
 
 		///////////////////////////////////////////////////////////////////////
 		/// Return The actual path used for temporary files taking environment
@@ -178,12 +192,21 @@ namespace tpie {
 			m_persist = p;
 		}
 
+		bool direct_io() const {
+			return m_directIO;
+		}
+
+		void set_direct_io(bool directIO) {
+			m_directIO = directIO;
+		}
+
 		friend void intrusive_ptr_add_ref(temp_file_inner * p);
 		friend void intrusive_ptr_release(temp_file_inner * p);
 
 	private:
 		std::string m_path;
 		bool m_persist;
+		bool m_directIO;
 		stream_size_type m_recordedSize;
 		memory_size_type m_count;			
 	};
@@ -230,6 +253,31 @@ namespace tpie {
 			m_inner->set_persistent(p);
 		}
 
+		///////////////////////////////////////////////////////////////////////
+		/// \returns Whether streams opened on this file use direct I/O.
+		///////////////////////////////////////////////////////////////////////
+		bool direct_io() const {
+			return m_inner->direct_io();
+		}
+
+		///////////////////////////////////////////////////////////////////////
+		/// \brief Set whether uncompressed streams opened on this file from
+		/// now on use direct I/O, bypassing the operating system page cache.
+		/// Temporary data is usually read back only once, so caching it
+		/// mostly evicts the data of other processes. Where the platform or
+		/// file system does not support direct I/O, the file is accessed
+		/// normally.
+		///
+		/// Compressed streams (tpie::file_stream, and thus merge sorting)
+		/// write blocks of variable size and always access the file
+		/// normally; opening one on a file with direct I/O set logs a
+		/// warning. Anonymous temporary files start out with
+		/// tempname::get_default_direct_io().
+		///////////////////////////////////////////////////////////////////////
+		void set_direct_io(bool directIO) {
+			m_inner->set_direct_io(directIO);
+		}
+
 		///////////////////////////////////////////////////////////////////////
 		/// \brief Associate with a specific file.
 		///////////////////////////////////////////////////////////////////////
@@ -27,6 +27,7 @@
 #include <tpie/compressed/thread.h>
 #include <tpie/compressed/buffer.h>
 #include <tpie/hash.h>
+#include <tpie/stream_io_thread.h>
 #include <tpie/tempname.h>
 
 namespace {
@@ -62,6 +63,7 @@ void tpie_init(flags<subsystem> subsystems) {
 	if (subsystems & STREAMS) {
 		init_stream_buffer_pool();
 		init_compressor();
+		init_stream_io_thread();
 	}
 
 	if (subsystems & HASH)
@@ -70,6 +72,7 @@ void tpie_init(flags<subsystem> subsystems) {
 
 void tpie_finish(flags<subsystem> subsystems) {
 	if (subsystems & STREAMS) {
+		finish_stream_io_thread();
 		finish_compressor();
 		finish_stream_buffer_pool();
 	}
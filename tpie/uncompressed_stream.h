@@ -151,16 +151,22 @@ public:
 	/// \param blockFactor The block factor you pass to open.
 	/// \param includeDefaultFileAccessor Unless you are supplying your own
 	/// file accessor to open, leave this to be true.
+	/// \param readAhead The value passed to set_read_ahead().
+	/// \param writeBehind The value passed to set_write_behind().
 	/// \returns The amount of memory maximally used by the count file_streams.
 	///////////////////////////////////////////////////////////////////////////
 	static constexpr memory_size_type memory_usage(
 		float blockFactor=1.0,
-		bool includeDefaultFileAccessor=true) noexcept {
+		bool includeDefaultFileAccessor=true,
+		memory_size_type readAhead=0,
+		bool writeBehind=false) noexcept {
 		// TODO
 		memory_size_type x = sizeof(uncompressed_stream);
 		x += block_memory_usage(blockFactor); // allocated in constructor
+		x += io_buffers_memory_usage(blockFactor, readAhead, writeBehind);
 		if (includeDefaultFileAccessor)
-			x += default_file_accessor::memory_usage();
+			x += default_file_accessor::memory_usage()
+				+ default_raw_file_accessor::read_ahead_memory_usage(block_size(blockFactor));
 		return x;
 	}
 